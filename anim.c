@@ -0,0 +1,121 @@
+#include "anim.h"
+
+
+/*******************************************************************************
+ * Maps the linear progress between two keyframes to the eased progress
+ * @param t progress from 0 to 1
+ ******************************************************************************/
+float anim_ease(anim_easing easing, float t) {
+	switch( easing ) {
+		case ANIM_EASE_IN:
+			return t * t * t;
+		case ANIM_EASE_OUT:
+			t = 1.0f - t;
+			return 1.0f - t * t * t;
+		case ANIM_EASE_IN_OUT:
+			return ( t < 0.5f )?4.0f * t * t * t:1.0f - 4.0f * (1.0f - t) * (1.0f - t) * (1.0f - t);
+		case ANIM_STEP:
+			return ( t < 1.0f )?0.0f:1.0f;
+		case ANIM_LINEAR:
+		default:
+			return t;
+	}
+}
+
+/*******************************************************************************
+ * Interpolates a track at a point of a pass
+ * @param t progress of the pass from 0 to 1
+ * @param *value receives the interpolated components
+ ******************************************************************************/
+static void anim_sample(const anim_track *track, float t, float value[4]) {
+	const anim_key *keys = track->keys;
+	uint_fast16_t next = 0;
+	while( next < track->keys_count && keys[next].at < t ) {
+		next++;
+	}
+	if( next == 0 || next == track->keys_count ) {
+		const anim_key *key = &keys[( next == 0 )?0:track->keys_count-1];
+		memcpy(value, key->value, sizeof(key->value));
+		return;
+	}
+	const anim_key *from = &keys[next-1], *to = &keys[next];
+	float span = to->at - from->at;
+	float eased = anim_ease(to->easing, ( span > 0 )?( t - from->at ) / span:1.0f);
+	for( int i = 0; i < 4; i++ ) {
+		value[i] = from->value[i] + ( to->value[i] - from->value[i] ) * eased;
+	}
+}
+
+static void anim_set_position(screen_element *element, uint_fast16_t *dest, float value) {
+	uint_fast16_t old = *dest;
+	value = roundf(value);
+	UINT_FAST16_T(*dest, value);
+	if( *dest != old ) {
+		element->dirty |= SCREEN_DIRTY_POSITION;
+	}
+}
+
+static void anim_set_color(screen_element *element, const float value[4]) {
+	Color color = { (unsigned char)roundf(value[0]), (unsigned char)roundf(value[1]),
+		(unsigned char)roundf(value[2]), (unsigned char)roundf(value[3]) };
+	Color *dest;
+	switch( element->type ) {
+		case SCREEN_IMG:   dest = &((screen_attrs_img *)element->attrs)->background_color; break;
+		case SCREEN_TABLE: dest = &((screen_attrs_table *)element->attrs)->color; break;
+		default:           dest = &((screen_attrs_text *)element->attrs)->color;
+	}
+	if( memcmp(dest, &color, sizeof(Color)) != 0 ) {
+		*dest = color;
+		element->dirty |= SCREEN_DIRTY_STYLE;
+	}
+}
+
+/*******************************************************************************
+ * Sets the animated properties of an element, only changes mark it dirty. The
+ * animation starts the first time it's applied.
+ * @param clock seconds of the animation clock, which stands still while paused
+ ******************************************************************************/
+void anim_apply(anim *a, screen_element *element, double clock) {
+	if( a->start < 0 ) {
+		a->start = clock;
+	}
+	double elapsed = clock - a->start - a->delay;
+	float t = ( elapsed <= 0 )?0.0f:(float)( elapsed / a->duration );
+	switch( a->repeat ) {
+		case ANIM_LOOP:
+			t -= floorf(t);
+			break;
+		case ANIM_PING_PONG:
+			t = fmodf(t, 2.0f);
+			t = ( t > 1.0f )?2.0f - t:t;
+			break;
+		case ANIM_ONCE:
+		default:
+			t = ( t > 1.0f )?1.0f:t;
+	}
+
+	float value[4];
+	for( uint_fast8_t i = 0; i < a->tracks_count; i++ ) {
+		const anim_track *track = &a->tracks[i];
+		anim_sample(track, t, value);
+		switch( track->property ) {
+			case ANIM_X: anim_set_position(element, &element->position.x, value[0]); break;
+			case ANIM_Y: anim_set_position(element, &element->position.y, value[0]); break;
+			case ANIM_W: anim_set_position(element, &element->position.w, value[0]); break;
+			case ANIM_H: anim_set_position(element, &element->position.h, value[0]); break;
+			case ANIM_OPACITY: {
+				float opacity = ( value[0] < 0 )?0:( value[0] > 1 )?1:value[0];
+				if( opacity != element->opacity ) {
+					element->opacity = opacity;
+					element->dirty |= SCREEN_DIRTY_STYLE;
+				}
+				break;
+			}
+			case ANIM_COLOR:
+				anim_set_color(element, value);
+				break;
+			default:
+				break;
+		}
+	}
+}
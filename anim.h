@@ -0,0 +1,68 @@
+#ifndef __ANIM_H__
+#define __ANIM_H__
+
+
+#include <math.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <raylib.h>
+
+#include "log.h"
+#include "helpers.h"
+#include "screen.h"
+#include "profile.h"
+
+
+typedef enum {
+	ANIM_X,
+	ANIM_Y,
+	ANIM_W,
+	ANIM_H,
+	ANIM_OPACITY,
+	ANIM_COLOR,  // text color, background color of images, color of table rows
+	ANIM_PROPERTIES,
+} anim_property;
+
+typedef enum {
+	ANIM_LINEAR,
+	ANIM_EASE_IN,
+	ANIM_EASE_OUT,
+	ANIM_EASE_IN_OUT,
+	ANIM_STEP,  // jumps at the keyframe
+} anim_easing;
+
+typedef enum {
+	ANIM_ONCE,       // stops at the last keyframe
+	ANIM_LOOP,       // starts over from the first keyframe
+	ANIM_PING_PONG,  // runs backwards after reaching the last keyframe
+} anim_repeat;
+
+typedef struct anim_key {
+	float at;            // 0 to 1, fraction of the duration
+	float value[4];      // r, g, b, a for colors, only the first is used otherwise
+	anim_easing easing;  // how the value approaches this key from the one before
+} anim_key;
+
+typedef struct anim_track {
+	anim_property property;
+	anim_key *keys;      // sorted by at
+	uint_fast16_t keys_count;
+} anim_track;
+
+typedef struct anim {
+	float duration;      // seconds of one pass through all keyframes
+	float delay;         // seconds before the first pass starts
+	anim_repeat repeat;
+	double start;        // animation clock when first applied, negative if not yet
+	anim_track tracks[ANIM_PROPERTIES];
+	uint_fast8_t tracks_count;
+} anim;
+
+struct screen_element;
+
+
+float anim_ease(anim_easing easing, float t);
+void anim_apply(anim *a, struct screen_element *element, double clock);
+
+
+#endif
@@ -0,0 +1,105 @@
+#include "arena.h"
+
+static const char *TOPIC = "arena";
+
+
+#define ARENA_HEADER ((sizeof(arena_block) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+static inline char *arena_block_data(arena_block *block) {
+	return (char *)block + ARENA_HEADER;
+}
+
+static inline size_t arena_round(size_t size) {
+	return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+
+arena *arena_new() {
+	arena *a;
+	MALLOC(a, sizeof(arena));
+	memset(a, 0, sizeof(arena));
+	return a;
+}
+
+static arena_block *arena_add_block(arena *a, size_t size) {
+	if( size < ARENA_BLOCK_SIZE ) {
+		size = ARENA_BLOCK_SIZE;
+	}
+	arena_block *block;
+	MALLOC(block, ARENA_HEADER + size);
+	block->size = size;
+	block->used = 0;
+	block->next = a->blocks;
+	a->blocks = block;
+	LOG_VERBOSE("Added block of %lu bytes", size);
+	return block;
+}
+
+/*******************************************************************************
+ * Allocates memory which lives until the arena is freed, there's no way to
+ * free single allocations. Not thread safe.
+ * @param *a the arena to allocate from
+ * @param size number of bytes
+ * @return aligned memory, never NULL
+ ******************************************************************************/
+void *arena_alloc(arena *a, size_t size) {
+	size_t rounded = arena_round(size);
+	arena_block *block = a->blocks;
+	if( block == NULL || block->size - block->used < rounded ) {
+		block = arena_add_block(a, rounded);
+	}
+	void *ptr = arena_block_data(block) + block->used;
+	block->used += rounded;
+	a->last = ptr;
+	a->bytes += size;
+	a->allocations++;
+	return ptr;
+}
+
+/*******************************************************************************
+ * Grows an allocation, in place if it's the last one and fits into its block,
+ * otherwise the content is copied and the old memory is wasted until the arena
+ * is freed
+ ******************************************************************************/
+void *arena_realloc(arena *a, void *ptr, size_t old_size, size_t new_size) {
+	if( ptr == NULL ) {
+		return arena_alloc(a, new_size);
+	}
+	if( new_size <= old_size ) {
+		return ptr;
+	}
+	arena_block *block = a->blocks;
+	size_t grow = arena_round(new_size) - arena_round(old_size);
+	if( ptr == a->last && block->size - block->used >= grow ) {
+		block->used += grow;
+		a->bytes += new_size - old_size;
+		return ptr;
+	}
+	void *new_ptr = arena_alloc(a, new_size);
+	memcpy(new_ptr, ptr, old_size);
+	return new_ptr;
+}
+
+char *arena_strdup(arena *a, const char *str) {
+	size_t size = strlen(str) + 1;
+	char *copy = arena_alloc(a, size);
+	memcpy(copy, str, size);
+	return copy;
+}
+
+/*******************************************************************************
+ * Releases all memory allocated from the arena and the arena itself
+ ******************************************************************************/
+void arena_free(arena *a) {
+	if( a == NULL ) {
+		return;
+	}
+	LOG_DEBUG("Free arena with %lu allocations of %lu bytes", a->allocations, a->bytes);
+	arena_block *block = a->blocks;
+	while( block != NULL ) {
+		arena_block *next = block->next;
+		free(block);
+		block = next;
+	}
+	free(a);
+}
@@ -0,0 +1,42 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+
+#ifndef ARENA_BLOCK_SIZE
+#define ARENA_BLOCK_SIZE 16384
+#endif
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "helpers.h"
+
+
+#define ARENA_ALIGN _Alignof(max_align_t)
+
+typedef struct arena_block {
+	struct arena_block *next;
+	size_t size;  // usable bytes after the header
+	size_t used;
+} arena_block;
+
+typedef struct arena {
+	arena_block *blocks;  // newest first, allocations are served from the first
+	void *last;           // last allocation, can be grown in place
+	size_t bytes;         // requested by users
+	uint_fast32_t allocations;
+} arena;
+
+
+arena *arena_new();
+void *arena_alloc(arena *a, size_t size);
+void *arena_realloc(arena *a, void *ptr, size_t old_size, size_t new_size);
+char *arena_strdup(arena *a, const char *str);
+void arena_free(arena *a);
+
+
+#endif
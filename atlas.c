@@ -0,0 +1,351 @@
+#include "atlas.h"
+
+static const char *TOPIC = "atlas";
+
+
+static atlas_page *atlas_pages;
+static uint_fast32_t atlas_pages_count;
+static atlas_slot *atlas_slots;
+static uint_fast32_t atlas_slots_count;
+static pthread_mutex_t atlas_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static inline size_t atlas_padded_area(Rectangle rect) {
+	return (size_t)(rect.width + 2 * ATLAS_PADDING) * (size_t)(rect.height + 2 * ATLAS_PADDING);
+}
+
+/*******************************************************************************
+ * Tests if an image is small enough to be packed into an atlas page
+ ******************************************************************************/
+bool atlas_fits(Image image) {
+	return config.atlas_max_size > 0 && image.data != NULL && !texture_is_compressed(image) &&
+		image.width <= config.atlas_max_size && image.height <= config.atlas_max_size &&
+		image.width + 2 * ATLAS_PADDING <= ATLAS_PAGE_SIZE && image.height + 2 * ATLAS_PADDING <= ATLAS_PAGE_SIZE;
+}
+
+/*******************************************************************************
+ * Finds room for a padded image on the shelves of a page, shelves which are
+ * much higher than the image are skipped to keep the waste low
+ * @return true if the image was placed at x, y
+ ******************************************************************************/
+static bool atlas_pack(atlas_page *page, uint_fast16_t width, uint_fast16_t height, uint_fast16_t *x, uint_fast16_t *y) {
+	atlas_shelf *best = NULL;
+	for( uint_fast16_t i = 0; i < page->shelves_count; i++ ) {
+		atlas_shelf *shelf = &page->shelves[i];
+		if( shelf->height >= height && shelf->height <= height + height / 2 && ATLAS_PAGE_SIZE - shelf->used >= width &&
+				( best == NULL || shelf->height < best->height ) ) {
+			best = shelf;
+		}
+	}
+	if( best == NULL ) {
+		if( page->top + height > ATLAS_PAGE_SIZE ) {
+			return false;
+		}
+		page->shelves_count++;
+		REALLOC(new_shelves, page->shelves, sizeof(atlas_shelf) * page->shelves_count);
+		best = &page->shelves[page->shelves_count-1];
+		best->y = page->top;
+		best->height = height;
+		best->used = 0;
+		page->top += height;
+	}
+	*x = best->used;
+	*y = best->y;
+	best->used += width;
+	return true;
+}
+
+static uint_fast32_t atlas_new_page() {
+	uint_fast32_t index = atlas_pages_count;
+	for( uint_fast32_t i = 0; i < atlas_pages_count; i++ ) {
+		if( atlas_pages[i].texture_id == UINT_FAST32_MAX ) {
+			index = i;
+			break;
+		}
+	}
+	if( index == atlas_pages_count ) {
+		atlas_pages_count++;
+		REALLOC(new_atlas_pages, atlas_pages, sizeof(atlas_page) * atlas_pages_count);
+	}
+	memset(&atlas_pages[index], 0, sizeof(atlas_page));
+	atlas_pages[index].texture_id = vram_add_image(GenImageColor(ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE, (Color){0,0,0,0}), NULL);
+	LOG_DEBUG("Added page %lu", index);
+	return index;
+}
+
+static uint_fast32_t atlas_new_slot() {
+	for( uint_fast32_t i = 0; i < atlas_slots_count; i++ ) {
+		if( atlas_slots[i].page == UINT_FAST32_MAX ) {
+			return i;
+		}
+	}
+	atlas_slots_count++;
+	REALLOC(new_atlas_slots, atlas_slots, sizeof(atlas_slot) * atlas_slots_count);
+	return atlas_slots_count-1;
+}
+
+/*******************************************************************************
+ * Copies an RGBA8 image into a page, the edge pixels are repeated into the
+ * padding around it
+ * @param x, y position of the padded image in the page
+ ******************************************************************************/
+static void atlas_blit(Image *page_image, uint_fast16_t x, uint_fast16_t y, Image image) {
+	uint32_t *dst = (uint32_t *)page_image->data;
+	const uint32_t *src = (const uint32_t *)image.data;
+	for( int row = -ATLAS_PADDING; row < image.height + ATLAS_PADDING; row++ ) {
+		int src_row = ( row < 0 )?0:( row >= image.height )?image.height-1:row;
+		uint32_t *line = dst + (size_t)(y + row + ATLAS_PADDING) * ATLAS_PAGE_SIZE + x;
+		for( int column = -ATLAS_PADDING; column < image.width + ATLAS_PADDING; column++ ) {
+			int src_column = ( column < 0 )?0:( column >= image.width )?image.width-1:column;
+			line[column + ATLAS_PADDING] = src[(size_t)src_row * image.width + src_column];
+		}
+	}
+}
+
+static uint_fast32_t atlas_find_locked(const char *file) {
+	for( uint_fast32_t i = 0; i < atlas_slots_count; i++ ) {
+		if( atlas_slots[i].page != UINT_FAST32_MAX && atlas_slots[i].file_name != NULL &&
+				strcmp(atlas_slots[i].file_name, file) == 0 ) {
+			atlas_slots[i].ref_count++;
+			return i;
+		}
+	}
+	return UINT_FAST32_MAX;
+}
+
+/*******************************************************************************
+ * Looks up an image which is already packed, so it doesn't have to be decoded
+ * again. Takes a reference on success.
+ * @return the slot, UINT_FAST32_MAX if the file isn't packed
+ ******************************************************************************/
+uint_fast32_t atlas_find(const char *file) {
+	pthread_mutex_lock(&atlas_mutex);
+	uint_fast32_t slot = atlas_find_locked(file);
+	pthread_mutex_unlock(&atlas_mutex);
+	return slot;
+}
+
+/*******************************************************************************
+ * Returns the smallest hole left by a removed image which fits the image
+ ******************************************************************************/
+static uint_fast32_t atlas_find_hole(int width, int height) {
+	uint_fast32_t best = UINT_FAST32_MAX;
+	for( uint_fast32_t i = 0; i < atlas_slots_count; i++ ) {
+		atlas_slot *hole = &atlas_slots[i];
+		if( hole->page == UINT_FAST32_MAX || hole->file_name != NULL || hole->rect.width < width || hole->rect.height < height ) {
+			continue;
+		}
+		if( best == UINT_FAST32_MAX || hole->rect.width * hole->rect.height < atlas_slots[best].rect.width * atlas_slots[best].rect.height ) {
+			best = i;
+		}
+	}
+	return best;
+}
+
+/*******************************************************************************
+ * Packs an image into an atlas page, holes of removed images are reused first,
+ * then the shelves of all pages are tried before a new page is added. Can be
+ * called from any thread.
+ * @param *file name of the image, images are shared by name
+ * @param image the image to pack, has to pass atlas_fits(). The atlas takes
+ * ownership.
+ * @return the slot of the image
+ ******************************************************************************/
+uint_fast32_t atlas_add(const char *file, Image image) {
+	PROFILE_FUNC();
+	ImageFormat(&image, UNCOMPRESSED_R8G8B8A8);
+	uint_fast16_t width = image.width + 2 * ATLAS_PADDING;
+	uint_fast16_t height = image.height + 2 * ATLAS_PADDING;
+
+	pthread_mutex_lock(&atlas_mutex);
+	// another thread might have packed the same file while this one decoded it
+	uint_fast32_t slot = atlas_find_locked(file);
+	if( slot != UINT_FAST32_MAX ) {
+		pthread_mutex_unlock(&atlas_mutex);
+		UnloadImage(image);
+		return slot;
+	}
+
+	uint_fast16_t x = 0, y = 0;
+	uint_fast32_t page = UINT_FAST32_MAX;
+	slot = atlas_find_hole(image.width, image.height);
+	if( slot != UINT_FAST32_MAX ) {
+		page = atlas_slots[slot].page;
+		x = atlas_slots[slot].rect.x - ATLAS_PADDING;
+		y = atlas_slots[slot].rect.y - ATLAS_PADDING;
+	}
+	else {
+		for( uint_fast32_t i = 0; i < atlas_pages_count && page == UINT_FAST32_MAX; i++ ) {
+			if( atlas_pages[i].texture_id != UINT_FAST32_MAX && atlas_pack(&atlas_pages[i], width, height, &x, &y) ) {
+				page = i;
+			}
+		}
+		if( page == UINT_FAST32_MAX ) {
+			page = atlas_new_page();
+			atlas_pack(&atlas_pages[page], width, height, &x, &y);
+		}
+		slot = atlas_new_slot();
+		atlas_slots[slot].page = page;
+		atlas_pages[page].area_packed += (size_t)width * height;
+	}
+
+	atlas_blit(vram_get_image(atlas_pages[page].texture_id), x, y, image);
+	atlas_slots[slot].file_name = strdup(file);
+	FAIL_ON_NULL(atlas_slots[slot].file_name, "Failed to copy file name »%s«", file);
+	atlas_slots[slot].rect = (Rectangle){ x + ATLAS_PADDING, y + ATLAS_PADDING, image.width, image.height };
+	atlas_slots[slot].ref_count = 1;
+	atlas_pages[page].slots++;
+	atlas_pages[page].area_used += (size_t)width * height;
+	atlas_pages[page].changed = true;
+	pthread_mutex_unlock(&atlas_mutex);
+
+	LOG_VERBOSE("Packed »%s« into page %lu at %lu,%lu", file, page, x, y);
+	UnloadImage(image);
+	return slot;
+}
+
+static int atlas_cmp_height(const void *a, const void *b) {
+	float height_a = atlas_slots[*(const uint_fast32_t *)a].rect.height;
+	float height_b = atlas_slots[*(const uint_fast32_t *)b].rect.height;
+	return ( height_a < height_b ) - ( height_a > height_b );
+}
+
+/*******************************************************************************
+ * Repacks the live images of a page sorted by height, which drops the holes of
+ * removed images. The page is left untouched if the images don't fit anymore.
+ ******************************************************************************/
+static void atlas_compact(uint_fast32_t page_index) {
+	PROFILE_FUNC();
+	atlas_page *page = &atlas_pages[page_index];
+	uint_fast32_t count = 0;
+	uint_fast32_t *sorted;
+	MALLOC(sorted, sizeof(uint_fast32_t) * page->slots);
+	for( uint_fast32_t i = 0; i < atlas_slots_count; i++ ) {
+		if( atlas_slots[i].page == page_index && atlas_slots[i].file_name != NULL ) {
+			sorted[count++] = i;
+		}
+	}
+	qsort(sorted, count, sizeof(uint_fast32_t), atlas_cmp_height);
+
+	atlas_page packed = { .texture_id = page->texture_id };
+	uint_fast16_t *positions;
+	MALLOC(positions, sizeof(uint_fast16_t) * 2 * (count + 1));
+	bool fits = true;
+	for( uint_fast32_t i = 0; i < count && fits; i++ ) {
+		Rectangle rect = atlas_slots[sorted[i]].rect;
+		fits = atlas_pack(&packed, rect.width + 2 * ATLAS_PADDING, rect.height + 2 * ATLAS_PADDING, &positions[2*i], &positions[2*i+1]);
+		packed.area_used += atlas_padded_area(rect);
+	}
+	if( !fits ) {
+		LOG_DEBUG("Images of page %lu don't fit after repacking, keeping holes", page_index);
+		free(packed.shelves);
+		free(positions);
+		free(sorted);
+		return;
+	}
+
+	Image *image = vram_get_image(page->texture_id);
+	size_t size = (size_t)ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE * 4;
+	uint32_t *old;
+	MALLOC(old, size);
+	memcpy(old, image->data, size);
+	memset(image->data, 0, size);
+	uint32_t *pixels = (uint32_t *)image->data;
+	for( uint_fast32_t i = 0; i < count; i++ ) {
+		atlas_slot *slot = &atlas_slots[sorted[i]];
+		uint_fast16_t width = slot->rect.width + 2 * ATLAS_PADDING;
+		uint_fast16_t height = slot->rect.height + 2 * ATLAS_PADDING;
+		size_t from_x = slot->rect.x - ATLAS_PADDING, from_y = slot->rect.y - ATLAS_PADDING;
+		for( uint_fast16_t row = 0; row < height; row++ ) {
+			memcpy(pixels + (size_t)(positions[2*i+1] + row) * ATLAS_PAGE_SIZE + positions[2*i],
+					old + (from_y + row) * ATLAS_PAGE_SIZE + from_x, width * 4);
+		}
+		slot->rect.x = positions[2*i] + ATLAS_PADDING;
+		slot->rect.y = positions[2*i+1] + ATLAS_PADDING;
+	}
+	for( uint_fast32_t i = 0; i < atlas_slots_count; i++ ) {
+		if( atlas_slots[i].page == page_index && atlas_slots[i].file_name == NULL ) {
+			atlas_slots[i].page = UINT_FAST32_MAX;
+		}
+	}
+	free(old);
+	free(positions);
+	free(sorted);
+
+	free(page->shelves);
+	packed.slots = page->slots;
+	packed.area_packed = packed.area_used;
+	packed.changed = true;
+	*page = packed;
+	LOG_DEBUG("Repacked page %lu with %lu images", page_index, count);
+}
+
+/*******************************************************************************
+ * Drops a reference to a packed image, the space is reused by later images.
+ * Empty pages are released, sparse pages are repacked.
+ ******************************************************************************/
+void atlas_remove(uint_fast32_t slot_index) {
+	pthread_mutex_lock(&atlas_mutex);
+	atlas_slot *slot = &atlas_slots[slot_index];
+	if( --slot->ref_count > 0 ) {
+		pthread_mutex_unlock(&atlas_mutex);
+		return;
+	}
+	uint_fast32_t page_index = slot->page;
+	atlas_page *page = &atlas_pages[page_index];
+	free(slot->file_name);
+	slot->file_name = NULL;
+	page->slots--;
+	page->area_used -= atlas_padded_area(slot->rect);
+
+	if( page->slots == 0 ) {
+		for( uint_fast32_t i = 0; i < atlas_slots_count; i++ ) {
+			if( atlas_slots[i].page == page_index ) {
+				atlas_slots[i].page = UINT_FAST32_MAX;
+			}
+		}
+		vram_remove(page->texture_id);
+		free(page->shelves);
+		memset(page, 0, sizeof(atlas_page));
+		page->texture_id = UINT_FAST32_MAX;
+		LOG_DEBUG("Released empty page %lu", page_index);
+	}
+	else if( page->area_used < page->area_packed * ATLAS_COMPACT_USAGE ) {
+		atlas_compact(page_index);
+	}
+	pthread_mutex_unlock(&atlas_mutex);
+}
+
+/*******************************************************************************
+ * Returns the page texture of a packed image, uploading changed pages first
+ * @param *source is set to the area of the image in the texture
+ ******************************************************************************/
+Texture2D *atlas_get_texture(uint_fast32_t slot, Rectangle *source) {
+	pthread_mutex_lock(&atlas_mutex);
+	atlas_page *page = &atlas_pages[atlas_slots[slot].page];
+	if( page->changed ) {
+		vram_update(page->texture_id);
+		page->changed = false;
+	}
+	Texture2D *texture = vram_get_texture(page->texture_id);
+	*source = atlas_slots[slot].rect;
+	pthread_mutex_unlock(&atlas_mutex);
+	return texture;
+}
+
+void atlas_log_stats() {
+	uint_fast32_t pages = 0, slots = 0;
+	size_t area_used = 0;
+	for( uint_fast32_t i = 0; i < atlas_pages_count; i++ ) {
+		if( atlas_pages[i].texture_id != UINT_FAST32_MAX ) {
+			pages++;
+			slots += atlas_pages[i].slots;
+			area_used += atlas_pages[i].area_used;
+		}
+	}
+	if( pages == 0 ) {
+		return;
+	}
+	LOG_INFO("Atlas: %lu images on %lu pages, %.1f%% used", slots, pages,
+			100.0 * area_used / ((double)pages * ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE));
+}
@@ -0,0 +1,65 @@
+#ifndef __ATLAS_H__
+#define __ATLAS_H__
+
+
+#ifndef ATLAS_PAGE_SIZE
+#define ATLAS_PAGE_SIZE 1024
+#endif
+
+#ifndef ATLAS_PADDING
+#define ATLAS_PADDING 1  // edge pixels are repeated around each image against filter bleeding
+#endif
+
+#ifndef ATLAS_COMPACT_USAGE
+#define ATLAS_COMPACT_USAGE 0.5  // repack a page if less of its packed area is in use
+#endif
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <raylib.h>
+
+#include "log.h"
+#include "helpers.h"
+#include "config.h"
+#include "vram.h"
+#include "profile.h"
+
+
+typedef struct atlas_shelf {
+	uint_fast16_t y;
+	uint_fast16_t height;
+	uint_fast16_t used;  // width taken from the left
+} atlas_shelf;
+
+typedef struct atlas_page {
+	uint_fast32_t texture_id;  // vRAM handle, UINT_FAST32_MAX if the page is unused
+	atlas_shelf *shelves;
+	uint_fast16_t shelves_count;
+	uint_fast16_t top;         // first row no shelf is using
+	uint_fast32_t slots;       // live images
+	size_t area_used;          // padded area of live images
+	size_t area_packed;        // padded area of live images and holes
+	bool changed;              // pixels have to be uploaded again
+} atlas_page;
+
+typedef struct atlas_slot {
+	char *file_name;           // NULL for holes left by removed images
+	uint_fast32_t page;        // UINT_FAST32_MAX if the slot is unused
+	Rectangle rect;            // without padding
+	uint_fast16_t ref_count;
+} atlas_slot;
+
+
+bool atlas_fits(Image image);
+uint_fast32_t atlas_find(const char *file);
+uint_fast32_t atlas_add(const char *file, Image image);
+void atlas_remove(uint_fast32_t slot);
+Texture2D *atlas_get_texture(uint_fast32_t slot, Rectangle *source);
+void atlas_log_stats();
+
+
+#endif
@@ -0,0 +1,265 @@
+#include "bench.h"
+
+static const char *TOPIC = "bench";
+
+
+static uint_fast32_t bench_elements;
+static uint_fast32_t bench_frames;     // recorded frames so far
+static uint_fast32_t bench_warmup;     // frames left before recording starts
+static double *bench_times;            // ms per recorded frame
+static double bench_frame_start;
+static size_t bench_allocs_start;
+static size_t bench_allocs_frames;     // allocations during recorded frames
+static long bench_rss;                 // KiB, measured after the last frame
+
+#ifdef BENCH_ALLOCS
+// counted through the linker, see the bench target of the Makefile
+static atomic_size_t bench_allocs;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+	atomic_fetch_add_explicit(&bench_allocs, 1, memory_order_relaxed);
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+	atomic_fetch_add_explicit(&bench_allocs, 1, memory_order_relaxed);
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+	atomic_fetch_add_explicit(&bench_allocs, 1, memory_order_relaxed);
+	return __real_realloc(ptr, size);
+}
+
+static size_t bench_alloc_count() {
+	return atomic_load_explicit(&bench_allocs, memory_order_relaxed);
+}
+#else
+static size_t bench_alloc_count() {
+	return 0;
+}
+#endif
+
+
+static long bench_read_rss() {
+	long pages_total, pages_resident;
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if( statm == NULL ) {
+		LOG_WARNING("Failed to open /proc/self/statm: %s", strerror(errno));
+		return -1;
+	}
+	int count = fscanf(statm, "%ld %ld", &pages_total, &pages_resident);
+	fclose(statm);
+	if( count != 2 ) {
+		return -1;
+	}
+	return pages_resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static cJSON *bench_frame(bench_kind kind, uint_fast32_t i, int x, int y, int w, int h) {
+	cJSON *frame = cJSON_CreateObject();
+	cJSON *attrs = cJSON_CreateObject();
+	cJSON_AddNumberToObject(frame, "x", x);
+	cJSON_AddNumberToObject(frame, "y", y);
+	cJSON_AddNumberToObject(frame, "w", w);
+	cJSON_AddNumberToObject(frame, "h", h);
+	char text[32];
+	switch( kind ) {
+		case BENCH_TEXT:
+		case BENCH_LUA:
+		case BENCH_ANIM:
+			snprintf(text, sizeof(text), "Element %lu", i);
+			cJSON_AddStringToObject(frame, "type", "text");
+			cJSON_AddStringToObject(attrs, "text", text);
+			cJSON_AddNumberToObject(attrs, "font-size", 10);
+			break;
+		case BENCH_CLOCK:
+			cJSON_AddStringToObject(frame, "type", "clock");
+			cJSON_AddStringToObject(attrs, "format", "%H:%M:%S");
+			cJSON_AddNumberToObject(attrs, "font-size", 10);
+			break;
+		case BENCH_IMG:
+			cJSON_AddStringToObject(frame, "type", "img");
+			cJSON_AddStringToObject(attrs, "src", BENCH_IMAGE);
+			cJSON_AddStringToObject(attrs, "format", "stretch");
+			break;
+		default:
+			LOG_FATAL("Unknown bench element kind %d", kind);
+	}
+	if( kind == BENCH_LUA ) {
+		cJSON_AddStringToObject(frame, "evals", "if not x0 then x0 = element.x end; element.x = x0 + (t * 60) % 20");
+	}
+	else if( kind == BENCH_ANIM ) {
+		// the same motion as the script, without the interpreter
+		cJSON *animation = cJSON_CreateObject();
+		cJSON *keyframes = cJSON_CreateArray();
+		cJSON *from = cJSON_CreateObject();
+		cJSON *to = cJSON_CreateObject();
+		cJSON_AddNumberToObject(from, "x", x);
+		cJSON_AddNumberToObject(to, "x", x + 20);
+		cJSON_AddItemToArray(keyframes, from);
+		cJSON_AddItemToArray(keyframes, to);
+		cJSON_AddNumberToObject(animation, "duration", 20.0 / 60);
+		cJSON_AddItemToObject(animation, "keyframes", keyframes);
+		cJSON_AddItemToObject(frame, "animation", animation);
+	}
+	cJSON_AddItemToObject(frame, "attrs", attrs);
+	return frame;
+}
+
+/*******************************************************************************
+ * Writes a synthetic layout with the given number of elements in a grid, the
+ * element types are mixed evenly
+ * @return the name of the layout
+ ******************************************************************************/
+static char *bench_generate(uint_fast32_t elements) {
+	Image image = GenImageGradientV(64, 64, RED, BLUE);
+	ExportImage(image, BENCH_IMAGE);
+	UnloadImage(image);
+
+	uint_fast32_t cols = (uint_fast32_t)ceil(sqrt((double)elements));
+	uint_fast32_t rows = ( elements + cols - 1 ) / cols;
+	int cell_w = config.render_width / cols;
+	int cell_h = config.render_height / rows;
+
+	cJSON *layout = cJSON_CreateObject();
+	cJSON_AddStringToObject(layout, "background-color", "#ffffff");
+	cJSON *frames = cJSON_CreateArray();
+	for( uint_fast32_t i = 0; i < elements; i++ ) {
+		int x = (i % cols) * cell_w;
+		int y = (i / cols) * cell_h;
+		cJSON_AddItemToArray(frames, bench_frame(i % BENCH_KINDS, i, x, y, cell_w, cell_h));
+	}
+	cJSON_AddItemToObject(layout, "frames", frames);
+
+	char *name;
+	MALLOC(name, sizeof("bench_") + 20);
+	sprintf(name, "bench_%lu", elements);
+	char path[64];
+	snprintf(path, sizeof(path), "layouts/%s.json", name);
+	char *str_layout = cJSON_Print(layout);
+	cJSON_Delete(layout);
+	FILE *file = fopen(path, "w");
+	FAIL_ON_NULL(file, "Failed to write bench layout »%s«", path);
+	fputs(str_layout, file);
+	fclose(file);
+	free(str_layout);
+
+	LOG_INFO("Generated bench layout »%s« with %lu elements", path, elements);
+	return name;
+}
+
+/*******************************************************************************
+ * Generates the synthetic layout and selects it, must be called after the
+ * config was parsed
+ * @param elements number of elements of the layout
+ ******************************************************************************/
+void bench_init(uint_fast32_t elements) {
+	bench_elements = elements;
+	bench_frames = 0;
+	bench_warmup = BENCH_WARMUP_FRAMES;
+	MALLOC(bench_times, sizeof(double) * config.bench_frames);
+	config.layout = bench_generate(elements);
+	// the synthetic layout is shown the whole run
+	config.schedule_count = 0;
+}
+
+void bench_frame_begin() {
+	bench_frame_start = GetTime();
+	bench_allocs_start = bench_alloc_count();
+}
+
+/*******************************************************************************
+ * Records the time of the frame, which started with bench_frame_begin
+ * @return true if enough frames were recorded
+ ******************************************************************************/
+bool bench_frame_end() {
+	double ms = (GetTime() - bench_frame_start) * 1000.0;
+	if( bench_warmup > 0 ) {
+		bench_warmup--;
+		return false;
+	}
+	bench_times[bench_frames++] = ms;
+	bench_allocs_frames += bench_alloc_count() - bench_allocs_start;
+	if( bench_frames < (uint_fast32_t)config.bench_frames ) {
+		return false;
+	}
+	bench_rss = bench_read_rss();
+	return true;
+}
+
+static int bench_compare(const void *a, const void *b) {
+	double da = *(const double *)a;
+	double db = *(const double *)b;
+	return ( da > db ) - ( da < db );
+}
+
+static double bench_percentile(double p) {
+	return bench_times[(size_t)(p * (bench_frames - 1))];
+}
+
+/*******************************************************************************
+ * Appends the results as one JSON line to BENCH_FILE and checks them against
+ * the thresholds of the config
+ * @return false if a threshold was exceeded
+ ******************************************************************************/
+bool bench_report() {
+	if( bench_frames == 0 ) {
+		LOG_ERROR("No frames were recorded");
+		return false;
+	}
+	qsort(bench_times, bench_frames, sizeof(double), bench_compare);
+	double p50 = bench_percentile(0.5);
+	double p90 = bench_percentile(0.9);
+	double p99 = bench_percentile(0.99);
+	double allocs = (double)bench_allocs_frames / bench_frames;
+
+	bool ok = true;
+	if( p99 > config.bench_max_p99 ) {
+		LOG_WARNING("p99 frame time %.2fms exceeds %.2fms", p99, config.bench_max_p99);
+		ok = false;
+	}
+	if( config.bench_max_rss > 0 && bench_rss > config.bench_max_rss * 1024L ) {
+		LOG_WARNING("RSS %ldKiB exceeds %dMiB", bench_rss, config.bench_max_rss);
+		ok = false;
+	}
+#ifdef BENCH_ALLOCS
+	if( config.bench_max_allocs >= 0 && allocs > config.bench_max_allocs ) {
+		LOG_WARNING("%.1f allocations per frame exceed %.1f", allocs, config.bench_max_allocs);
+		ok = false;
+	}
+#endif
+
+	cJSON *result = cJSON_CreateObject();
+	cJSON_AddNumberToObject(result, "elements", bench_elements);
+	cJSON_AddNumberToObject(result, "frames", bench_frames);
+	cJSON_AddNumberToObject(result, "startup_ms", startup_total_ms());
+	cJSON_AddNumberToObject(result, "frame_p50_ms", p50);
+	cJSON_AddNumberToObject(result, "frame_p90_ms", p90);
+	cJSON_AddNumberToObject(result, "frame_p99_ms", p99);
+	cJSON_AddNumberToObject(result, "frame_max_ms", bench_times[bench_frames-1]);
+	cJSON_AddNumberToObject(result, "rss_kib", bench_rss);
+#ifdef BENCH_ALLOCS
+	cJSON_AddNumberToObject(result, "allocs_per_frame", allocs);
+#else
+	cJSON_AddNullToObject(result, "allocs_per_frame");
+#endif
+	cJSON_AddBoolToObject(result, "ok", ok);
+	char *line = cJSON_PrintUnformatted(result);
+	cJSON_Delete(result);
+
+	FILE *file = fopen(BENCH_FILE, "a");
+	FAIL_ON_NULL(file, "Failed to open bench results »%s«", BENCH_FILE);
+	fprintf(file, "%s\n", line);
+	fclose(file);
+
+	LOG_INFO("%lu elements: startup %.1fms, frame p50 %.2fms p90 %.2fms p99 %.2fms, RSS %ldKiB, %.1f allocations per frame: %s",
+			bench_elements, startup_total_ms(), p50, p90, p99, bench_rss, allocs, ok?"ok":"FAILED");
+	free(line);
+	free(bench_times);
+	return ok;
+}
@@ -0,0 +1,52 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+
+#ifndef BENCH_FILE
+#define BENCH_FILE "bench.jsonl"
+#endif
+
+#ifndef BENCH_WARMUP_FRAMES
+#define BENCH_WARMUP_FRAMES 10
+#endif
+
+#ifndef BENCH_IMAGE
+#define BENCH_IMAGE "layouts/bench.png"
+#endif
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <raylib.h>
+
+#include "log.h"
+#include "helpers.h"
+#include "config.h"
+#include "startup.h"
+#include "cJSON.h"
+
+
+typedef enum {
+	BENCH_TEXT,
+	BENCH_CLOCK,
+	BENCH_IMG,
+	BENCH_LUA,
+	BENCH_ANIM,
+	BENCH_KINDS,
+} bench_kind;
+
+
+void bench_init(uint_fast32_t elements);
+void bench_frame_begin();
+bool bench_frame_end();
+bool bench_report();
+
+
+#endif
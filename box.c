@@ -0,0 +1,213 @@
+#include "box.h"
+
+static const char *TOPIC = "box";
+
+
+/*******************************************************************************
+ * Creates a box, boxes live until the arena of their layout is freed
+ * @param *a the arena to allocate from
+ * @param type how children are placed
+ * @param *parent the box to add the new box to, NULL for a root box
+ ******************************************************************************/
+box *box_new(arena *a, box_type type, box *parent) {
+	box *b = arena_alloc(a, sizeof(box));
+	memset(b, 0, sizeof(box));
+	b->type = type;
+	b->element_id = UINT_FAST32_MAX;
+	b->align = BOX_START;
+	b->valign = BOX_START;
+	b->dirty = true;
+	b->parent = parent;
+	if( parent != NULL ) {
+		if( parent->children_count == parent->children_capacity ) {
+			uint_fast32_t capacity = ( parent->children_capacity > 0 )?parent->children_capacity*2:4;
+			parent->children = arena_realloc(a, parent->children, sizeof(box *) * parent->children_capacity, sizeof(box *) * capacity);
+			parent->children_capacity = capacity;
+		}
+		parent->children[parent->children_count++] = b;
+		parent->dirty_children = true;
+	}
+	return b;
+}
+
+static inline float box_resolve(box_length length, float parent_size) {
+	if( length.unit == BOX_PERCENT ) {
+		return length.value * parent_size / 100.0f;
+	}
+	return length.value;
+}
+
+static inline bool box_is_auto_sized(const box *b) {
+	return b->w.value <= 0 || b->h.value <= 0;
+}
+
+/*******************************************************************************
+ * Marks a box and everything depending on its size as dirty. Propagation stops
+ * at the first container with a fixed size, as its parent isn't affected.
+ ******************************************************************************/
+static void box_invalidate(box *b) {
+	b->dirty = true;
+	bool size_changed = true;
+	for( box *p = b->parent; p != NULL; p = p->parent ) {
+		p->dirty_children = true;
+		if( size_changed && ( p->type == BOX_ROW || p->type == BOX_COLUMN ) ) {
+			p->dirty = true;
+			size_changed = box_is_auto_sized(p);
+		}
+		else {
+			size_changed = false;
+		}
+	}
+}
+
+/*******************************************************************************
+ * Sets the measured content size of an element, e.g. the size of its text.
+ * Only auto sized boxes are invalidated.
+ ******************************************************************************/
+void box_set_content(box *b, float w, float h) {
+	if( b->content.x == w && b->content.y == h ) {
+		return;
+	}
+	b->content = (Vector2){ w, h };
+	if( box_is_auto_sized(b) ) {
+		LOG_VERBOSE("Content size of box with element %lu changed to %.0fx%.0f", b->element_id, w, h);
+		box_invalidate(b);
+	}
+}
+
+/*******************************************************************************
+ * Returns the size of a box, auto sized containers take the size of their
+ * children. Results are cached until the box or its parent size changes.
+ ******************************************************************************/
+static Vector2 box_measure(box *b, Vector2 parent_size) {
+	if( !b->dirty && b->measured_for.x == parent_size.x && b->measured_for.y == parent_size.y ) {
+		return b->measured;
+	}
+	Vector2 size = { box_resolve(b->w, parent_size.x), box_resolve(b->h, parent_size.y) };
+	if( b->type == BOX_FRAME ) {
+		if( size.x <= 0 ) { size.x = b->content.x; }
+		if( size.y <= 0 ) { size.y = b->content.y; }
+	}
+	else if( size.x <= 0 || size.y <= 0 ) {
+		Vector2 inner = { (size.x > 0)?size.x:parent_size.x, (size.y > 0)?size.y:parent_size.y };
+		bool row = b->type == BOX_ROW;
+		float main = 0, cross = 0;
+		for( uint_fast32_t i = 0; i < b->children_count; i++ ) {
+			Vector2 child = box_measure(b->children[i], inner);
+			main += row?child.x:child.y;
+			if( (row?child.y:child.x) > cross ) {
+				cross = row?child.y:child.x;
+			}
+		}
+		if( b->children_count > 1 ) {
+			main += box_resolve(b->gap, row?inner.x:inner.y) * (b->children_count - 1);
+		}
+		if( size.x <= 0 ) { size.x = row?main:cross; }
+		if( size.y <= 0 ) { size.y = row?cross:main; }
+	}
+	b->measured = size;
+	b->measured_for = parent_size;
+	return size;
+}
+
+static inline float box_align_offset(box_align align, float space) {
+	switch( align ) {
+		case BOX_CENTER: return space / 2;
+		case BOX_END:    return space;
+		default:         return 0;
+	}
+}
+
+/*******************************************************************************
+ * Writes the resolved box into the position of the attached element. Only the
+ * changed values are written, so evals animating the others keep their state.
+ ******************************************************************************/
+static void box_apply(box *b, Rectangle old) {
+	if( b->element_id == UINT_FAST32_MAX ) {
+		return;
+	}
+	screen_element *element = screen_get_element(b->element_id);
+	if( element == NULL ) {
+		return;
+	}
+	if( b->rect.x != old.x || b->rect.y != old.y ) {
+		UINT_FAST16_T(element->position.x, b->rect.x);
+		UINT_FAST16_T(element->position.y, b->rect.y);
+	}
+	if( b->rect.width != old.width || b->rect.height != old.height ) {
+		UINT_FAST16_T(element->position.w, b->rect.width);
+		UINT_FAST16_T(element->position.h, b->rect.height);
+	}
+}
+
+static Rectangle box_child_rect(box *b, box *child, float *cursor, float gap) {
+	Vector2 size = box_measure(child, (Vector2){ b->rect.width, b->rect.height });
+	Rectangle rect = { 0, 0, size.x, size.y };
+	if( b->type == BOX_ROW ) {
+		rect.x = b->rect.x + *cursor;
+		rect.y = b->rect.y + box_align_offset(b->valign, b->rect.height - size.y);
+		*cursor += size.x + gap;
+	}
+	else if( b->type == BOX_COLUMN ) {
+		rect.x = b->rect.x + box_align_offset(b->align, b->rect.width - size.x);
+		rect.y = b->rect.y + *cursor;
+		*cursor += size.y + gap;
+	}
+	else {
+		float x = box_resolve(child->x, b->rect.width);
+		float y = box_resolve(child->y, b->rect.height);
+		rect.x = b->rect.x + (( x < 0 )?b->rect.width + x:x);
+		rect.y = b->rect.y + (( y < 0 )?b->rect.height + y:y);
+	}
+	return rect;
+}
+
+/*******************************************************************************
+ * Resolves a box at the given rectangle, subtrees are only visited if they are
+ * dirty or their own rectangle changed
+ ******************************************************************************/
+static void box_arrange(box *b, Rectangle rect) {
+	bool moved = rect.x != b->rect.x || rect.y != b->rect.y || rect.width != b->rect.width || rect.height != b->rect.height;
+	if( !moved && !b->dirty && !b->dirty_children ) {
+		return;
+	}
+	Rectangle old = b->rect;
+	b->rect = rect;
+	bool reflow = moved || b->dirty;
+	if( moved ) {
+		box_apply(b, old);
+	}
+
+	float cursor = 0;
+	float gap = box_resolve(b->gap, (b->type == BOX_ROW)?rect.width:rect.height);
+	for( uint_fast32_t i = 0; i < b->children_count; i++ ) {
+		box *child = b->children[i];
+		if( reflow ) {
+			box_arrange(child, box_child_rect(b, child, &cursor, gap));
+		}
+		else if( child->dirty && b->type == BOX_FRAME ) {
+			// placed by its own position, siblings aren't affected
+			box_arrange(child, box_child_rect(b, child, &cursor, gap));
+		}
+		else if( child->dirty || child->dirty_children ) {
+			// sizes didn't change, otherwise this container would be dirty too
+			box_arrange(child, child->rect);
+		}
+	}
+
+	b->dirty = false;
+	b->dirty_children = false;
+}
+
+/*******************************************************************************
+ * Layout pass, called once per frame. Does nothing if no box is dirty.
+ * @param *root the box of the whole screen
+ ******************************************************************************/
+void box_update(box *root) {
+	if( root == NULL || ( !root->dirty && !root->dirty_children ) ) {
+		return;
+	}
+	PROFILE_FUNC();
+	Vector2 size = box_measure(root, (Vector2){ config.render_width, config.render_height });
+	box_arrange(root, (Rectangle){ 0, 0, size.x, size.y });
+}
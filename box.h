@@ -0,0 +1,63 @@
+#ifndef __BOX_H__
+#define __BOX_H__
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <raylib.h>
+
+#include "log.h"
+#include "helpers.h"
+#include "screen.h"
+#include "arena.h"
+#include "profile.h"
+
+
+typedef enum {
+	BOX_PX,
+	BOX_PERCENT,
+} box_unit;
+
+typedef struct box_length {
+	float value;  // negative pixel positions are offsets from the right or bottom edge
+	box_unit unit;
+} box_length;
+
+typedef enum {
+	BOX_FRAME,   // children are placed by their own x and y
+	BOX_ROW,     // children are stacked from left to right
+	BOX_COLUMN,  // children are stacked from top to bottom
+} box_type;
+
+typedef enum {
+	BOX_START,
+	BOX_CENTER,
+	BOX_END,
+} box_align;
+
+typedef struct box {
+	box_type type;
+	box_length x, y, w, h;
+	box_length gap;
+	box_align align, valign;     // alignment of children across the stacking direction
+	uint_fast32_t element_id;    // UINT_FAST32_MAX if no element is attached
+	struct box *parent;
+	struct box **children;
+	uint_fast32_t children_count;
+	uint_fast32_t children_capacity;
+	Rectangle rect;              // resolved absolute box
+	Vector2 content;             // measured size of the attached element
+	Vector2 measured;            // cached size, valid for measured_for if not dirty
+	Vector2 measured_for;
+	bool dirty;                  // box has to be resolved again
+	bool dirty_children;         // some box below has to be resolved again
+} box;
+
+
+box *box_new(arena *a, box_type type, box *parent);
+void box_set_content(box *b, float w, float h);
+void box_update(box *root);
+
+
+#endif
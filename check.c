@@ -0,0 +1,497 @@
+#include "check.h"
+
+static const char *TOPIC = "check";
+
+
+typedef struct check_font {
+	const char *name;
+	uint_fast16_t size;
+	int *codepoints;
+	uint_fast32_t codepoints_count;
+} check_font;
+
+static uint_fast32_t check_errors;
+static lua_State *check_lua;  // compiles scripts without running them
+static check_font *check_fonts;
+static uint_fast32_t check_fonts_count;
+
+
+static void check_error(const char *where, const char *format, ...) {
+	check_errors++;
+	char message[256];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(message, sizeof(message), format, args);
+	va_end(args);
+	LOG_ERROR("%s: %s", where, message);
+}
+
+static void check_color(cJSON *cjson_color, const char *where) {
+	unsigned int r, g, b;
+	if( cjson_color == NULL ) {
+		return;
+	}
+	if( !cJSON_IsString(cjson_color) || cjson_color->valuestring == NULL ) {
+		check_error(where, "color has to be a string like #rrggbb[aa]");
+	}
+	else if( sscanf(cjson_color->valuestring, "#%2x%2x%2x", &r, &g, &b) != 3 ) {
+		check_error(where, "unparsable color »%s«", cjson_color->valuestring);
+	}
+}
+
+static void check_length(cJSON *cjson_length, const char *where) {
+	if( cjson_length == NULL || cJSON_IsNumber(cjson_length) ) {
+		return;
+	}
+	if( !cJSON_IsString(cjson_length) || cjson_length->valuestring == NULL ) {
+		check_error(where, "length has to be a number or a string like \"50%%\"");
+		return;
+	}
+	char *unit;
+	strtof(cjson_length->valuestring, &unit);
+	if( unit == cjson_length->valuestring || ( *unit != '\0' && *unit != '%' && strcmp("px", unit) != 0 ) ) {
+		check_error(where, "unparsable length »%s«", cjson_length->valuestring);
+	}
+}
+
+static void check_script(cJSON *cjson_evals, const char *where) {
+	if( cjson_evals == NULL ) {
+		return;
+	}
+	if( !cJSON_IsString(cjson_evals) || cjson_evals->valuestring == NULL ) {
+		check_error(where, "evals have to be a string");
+		return;
+	}
+	if( luaL_loadstring(check_lua, cjson_evals->valuestring) != LUA_OK ) {
+		check_error(where, "%s", lua_tostring(check_lua, -1));
+	}
+	lua_settop(check_lua, 0);
+}
+
+static void check_animation(cJSON *cjson_animation, const char *where) {
+	if( cjson_animation == NULL ) {
+		return;
+	}
+	cJSON *cjson_keyframes = cJSON_GetObjectItemCaseSensitive(cjson_animation, "keyframes");
+	if( !cJSON_IsArray(cjson_keyframes) || cJSON_GetArraySize(cjson_keyframes) == 0 ) {
+		check_error(where, "animation has no keyframes");
+		return;
+	}
+	cJSON *cjson_duration = cJSON_GetObjectItemCaseSensitive(cjson_animation, "duration");
+	if( cjson_duration != NULL && ( !cJSON_IsNumber(cjson_duration) || cjson_duration->valuedouble <= 0 ) ) {
+		check_error(where, "animation duration has to be positive");
+	}
+	cJSON *cjson_keyframe;
+	cJSON_ArrayForEach(cjson_keyframe, cjson_keyframes) {
+		check_color(cJSON_GetObjectItemCaseSensitive(cjson_keyframe, "color"), where);
+	}
+}
+
+static void check_fill(cJSON *cjson_fill, const char *where) {
+	if( cjson_fill == NULL || cJSON_IsString(cjson_fill) ) {
+		check_color(cjson_fill, where);
+		return;
+	}
+	if( !cJSON_IsObject(cjson_fill) ) {
+		check_error(where, "fill has to be a color or an object");
+		return;
+	}
+	cJSON *cjson_type = cJSON_GetObjectItemCaseSensitive(cjson_fill, "type");
+	if( cjson_type != NULL && ( !cJSON_IsString(cjson_type) || cjson_type->valuestring == NULL ||
+			( strcmp("solid", cjson_type->valuestring) != 0 && strcmp("linear", cjson_type->valuestring) != 0 && strcmp("radial", cjson_type->valuestring) != 0 ) ) ) {
+		check_error(where, "fill type has to be solid, linear or radial");
+	}
+	cJSON *cjson_colors = cJSON_GetObjectItemCaseSensitive(cjson_fill, "colors");
+	if( cjson_colors != NULL && ( !cJSON_IsArray(cjson_colors) || cJSON_GetArraySize(cjson_colors) == 0 || cJSON_GetArraySize(cjson_colors) > 2 ) ) {
+		check_error(where, "fill colors have to be an array of one or two colors");
+	}
+	cJSON *cjson_color;
+	cJSON_ArrayForEach(cjson_color, cjson_colors) {
+		check_color(cjson_color, where);
+	}
+	check_color(cJSON_GetObjectItemCaseSensitive(cjson_fill, "color"), where);
+	static const char *numbers[] = { "angle", "radius" };
+	for( size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++ ) {
+		cJSON *cjson_number = cJSON_GetObjectItemCaseSensitive(cjson_fill, numbers[i]);
+		if( cjson_number != NULL && !cJSON_IsNumber(cjson_number) ) {
+			check_error(where, "fill %s has to be a number", numbers[i]);
+		}
+	}
+	cJSON *cjson_border = cJSON_GetObjectItemCaseSensitive(cjson_fill, "border");
+	if( cjson_border != NULL ) {
+		cJSON *cjson_width = cJSON_GetObjectItemCaseSensitive(cjson_border, "width");
+		if( !cJSON_IsNumber(cjson_width) || cjson_width->valuedouble < 0 ) {
+			check_error(where, "fill border needs a width of 0 or more pixels");
+		}
+		check_color(cJSON_GetObjectItemCaseSensitive(cjson_border, "color"), where);
+	}
+}
+
+static void check_attrs(const char *type, cJSON *attrs, const char *where) {
+	if( strcmp("table", type) == 0 ) {
+		cJSON *cjson_src = cJSON_GetObjectItemCaseSensitive(attrs, "src");
+		if( !cJSON_IsString(cjson_src) || cjson_src->valuestring == NULL ) {
+			check_error(where, "table has no src");
+		}
+		else if( !FileExists(cjson_src->valuestring) ) {
+			check_error(where, "missing data file »%s«", cjson_src->valuestring);
+		}
+		if( cJSON_GetArraySize(cJSON_GetObjectItemCaseSensitive(attrs, "columns")) == 0 ) {
+			check_error(where, "table has no columns");
+		}
+		check_color(cJSON_GetObjectItemCaseSensitive(attrs, "header-color"), where);
+	}
+	else if( strcmp("img", type) == 0 ) {
+		cJSON *cjson_src = cJSON_GetObjectItemCaseSensitive(attrs, "src");
+		if( !cJSON_IsString(cjson_src) || cjson_src->valuestring == NULL ) {
+			check_error(where, "image has no src");
+		}
+		else if( !FileExists(cjson_src->valuestring) ) {
+			check_error(where, "missing image »%s«", cjson_src->valuestring);
+		}
+		check_color(cJSON_GetObjectItemCaseSensitive(attrs, "background-color"), where);
+		return;
+	}
+	cJSON *cjson_font = cJSON_GetObjectItemCaseSensitive(attrs, "font-name");
+	if( cJSON_IsString(cjson_font) && cjson_font->valuestring != NULL && !FileExists(cjson_font->valuestring) ) {
+		check_error(where, "missing font »%s«", cjson_font->valuestring);
+	}
+	check_color(cJSON_GetObjectItemCaseSensitive(attrs, "color"), where);
+}
+
+/*******************************************************************************
+ * Validates a frame and its children, every problem is logged and counted
+ * @param *path where the frame is in the layout, like "frames[2].frames[0]"
+ ******************************************************************************/
+static void check_frame(cJSON *cjson_frame, const char *path) {
+	cJSON *cjson_type = cJSON_GetObjectItemCaseSensitive(cjson_frame, "type");
+	const char *type = ( cJSON_IsString(cjson_type) && cjson_type->valuestring != NULL )?cjson_type->valuestring:"dummy";
+	char where[256];
+	snprintf(where, sizeof(where), "%s (%s)", path, type);
+
+	static const char *lengths[] = { "x", "y", "w", "h", "gap" };
+	for( size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++ ) {
+		check_length(cJSON_GetObjectItemCaseSensitive(cjson_frame, lengths[i]), where);
+	}
+
+	if( strcmp("row", type) == 0 || strcmp("column", type) == 0 ) {
+		if( cJSON_GetObjectItemCaseSensitive(cjson_frame, "fill") != NULL ) {
+			check_error(where, "fill is only drawn for elements, not for containers");
+		}
+		int index = 0;
+		cJSON *cjson_child;
+		cJSON_ArrayForEach(cjson_child, cJSON_GetObjectItemCaseSensitive(cjson_frame, "frames")) {
+			char child_path[256];
+			snprintf(child_path, sizeof(child_path), "%s.frames[%d]", path, index++);
+			check_frame(cjson_child, child_path);
+		}
+		return;
+	}
+	if( strcmp("text", type) != 0 && strcmp("clock", type) != 0 && strcmp("img", type) != 0 && strcmp("table", type) != 0 ) {
+		if( strcmp("dummy", type) != 0 ) {
+			check_error(where, "unknown frame type »%s«", type);
+		}
+		return;
+	}
+	check_attrs(type, cJSON_GetObjectItemCaseSensitive(cjson_frame, "attrs"), where);
+	check_script(cJSON_GetObjectItemCaseSensitive(cjson_frame, "evals"), where);
+	check_animation(cJSON_GetObjectItemCaseSensitive(cjson_frame, "animation"), where);
+	check_fill(cJSON_GetObjectItemCaseSensitive(cjson_frame, "fill"), where);
+}
+
+/*******************************************************************************
+ * Validates the layout file without loading anything into vRAM
+ * @return false if the file can't be read or parsed, it can't be loaded then
+ ******************************************************************************/
+static bool check_file(const char *layout_name) {
+	char layout_path[256];
+	snprintf(layout_path, sizeof(layout_path), "layouts/%s.json", layout_name);
+	char *str_layout = NULL;
+	if( !read_file(&str_layout, layout_path) ) {
+		check_error(layout_path, "can't be read: %s", strerror(errno));
+		return false;
+	}
+	const char *str_error = NULL;
+	cJSON *cjson_layout = cJSON_ParseWithOpts(str_layout, &str_error, false);
+	if( cjson_layout == NULL ) {
+		int line = 1;
+		for( const char *c = str_layout; str_error != NULL && c < str_error; c++ ) {
+			line += ( *c == '\n' );
+		}
+		check_error(layout_path, "invalid JSON in line %d", line);
+		free(str_layout);
+		return false;
+	}
+	free(str_layout);
+
+	check_color(cJSON_GetObjectItemCaseSensitive(cjson_layout, "default-color"), layout_path);
+	check_color(cJSON_GetObjectItemCaseSensitive(cjson_layout, "background-color"), layout_path);
+	check_fill(cJSON_GetObjectItemCaseSensitive(cjson_layout, "background"), layout_path);
+	cJSON *cjson_frames = cJSON_GetObjectItemCaseSensitive(cjson_layout, "frames");
+	if( !cJSON_IsArray(cjson_frames) ) {
+		check_error(layout_path, "has no frames array");
+	}
+	int index = 0;
+	cJSON *cjson_frame;
+	cJSON_ArrayForEach(cjson_frame, cjson_frames) {
+		char path[32];
+		snprintf(path, sizeof(path), "frames[%d]", index++);
+		check_frame(cjson_frame, path);
+	}
+	cJSON_Delete(cjson_layout);
+	return true;
+}
+
+static check_font *check_get_font(const char *name, uint_fast16_t size) {
+	for( uint_fast32_t i = 0; i < check_fonts_count; i++ ) {
+		if( check_fonts[i].size == size && strcmp(check_fonts[i].name, name) == 0 ) {
+			return &check_fonts[i];
+		}
+	}
+	check_fonts_count++;
+	REALLOC(new_check_fonts, check_fonts, sizeof(check_font) * check_fonts_count);
+	check_fonts[check_fonts_count-1] = (check_font){ name, size, NULL, 0 };
+	return &check_fonts[check_fonts_count-1];
+}
+
+/*******************************************************************************
+ * Adds the codepoints of a text to the glyphs of a font
+ * @param *font the font, NULL for the default font which has no glyph cache
+ * @return the number of glyphs drawn for the text
+ ******************************************************************************/
+static uint_fast32_t check_add_text(check_font *font, const char *text) {
+	uint_fast32_t quads = 0;
+	int codepoint;
+	while( ( codepoint = glyph_next_codepoint(&text) ) != 0 ) {
+		quads += ( codepoint != ' ' );
+		if( font == NULL ) {
+			continue;
+		}
+		uint_fast32_t i = 0;
+		while( i < font->codepoints_count && font->codepoints[i] != codepoint ) {
+			i++;
+		}
+		if( i == font->codepoints_count ) {
+			font->codepoints_count++;
+			REALLOC(new_codepoints, font->codepoints, sizeof(int) * font->codepoints_count);
+			font->codepoints[i] = codepoint;
+		}
+	}
+	return quads;
+}
+
+/*******************************************************************************
+ * Estimates the glyph pages of a font from the glyph count, pages grow like
+ * the ones of the glyph cache do
+ ******************************************************************************/
+static size_t check_atlas_bytes(const check_font *font) {
+	double glyph_side = font->size + 2 * GLYPH_PADDING;
+	double area = font->codepoints_count * glyph_side * glyph_side / CHECK_ATLAS_FILL;
+	size_t side = GLYPH_PAGE_MIN;
+	while( side < GLYPH_PAGE_MAX && side * side < area ) {
+		side *= 2;
+	}
+	size_t pages = ( area + side * side - 1 ) / ( side * side );
+	if( pages > GLYPH_MAX_PAGES ) {
+		LOG_WARNING("Font »%s:%lu« needs %zu glyph pages, only %d are kept, glyphs will be rasterized over and over",
+				font->name, font->size, pages, GLYPH_MAX_PAGES);
+		pages = GLYPH_MAX_PAGES;
+	}
+	return pages * side * side * 2;  // gray and alpha
+}
+
+static double check_area(float x, float y, float w, float h) {
+	float right = ( x + w < config.render_width )?x + w:config.render_width;
+	float bottom = ( y + h < config.render_height )?y + h:config.render_height;
+	return ( right > x && bottom > y )?( right - x ) * ( bottom - y ):0;
+}
+
+static void check_image(screen_element *element, check_cost *cost) {
+	screen_attrs_img *attr_img = element->attrs;
+	cost->images++;
+	if( attr_img->background_color.a > 0 ) {
+		cost->overdraw += check_area(element->position.x, element->position.y, element->position.w, element->position.h);
+	}
+	cost->overdraw += check_area(element->position.x, element->position.y, element->position.w, element->position.h);
+	if( attr_img->file_name == NULL || !FileExists(attr_img->file_name) ) {
+		return;  // already reported by check_attrs
+	}
+	char *fallback;
+	Image image = texture_load(attr_img->file_name, &fallback);
+	free(fallback);
+	if( image.data == NULL ) {
+		check_error(attr_img->file_name, "image can't be loaded");
+		return;
+	}
+	cost->texture_bytes += GetPixelDataSize(image.width, image.height, image.format);
+	UnloadImage(image);
+}
+
+/*******************************************************************************
+ * Reads the data file of a table, the glyphs of all rows are counted as they
+ * are all shown eventually, the quads of the fullest page are drawn per frame
+ ******************************************************************************/
+static void check_table(screen_element *element, check_cost *cost) {
+	screen_attrs_table *attr_table = element->attrs;
+	cost->tables++;
+	screen_prepare_table(element);
+	cost->table_rows += attr_table->store.rows_count;
+	check_font *font = ( attr_table->font_name != NULL )?check_get_font(attr_table->font_name, attr_table->font_size):NULL;
+	uint_fast32_t header = 0;
+	for( uint_fast16_t column = 0; attr_table->header && column < attr_table->columns_count; column++ ) {
+		if( attr_table->columns[column].title != NULL ) {
+			header += check_add_text(font, attr_table->columns[column].title);
+		}
+	}
+	// pages as the renderer shows them, no rows fit means none are drawn
+	uint_fast32_t rows = screen_table_rows(element);
+	uint_fast32_t page = 0, page_max = 0;
+	for( uint_fast32_t row = 0; rows > 0 && row < attr_table->store.rows_count; row++ ) {
+		if( row % rows == 0 ) {
+			page = 0;
+		}
+		for( uint_fast16_t column = 0; column < attr_table->columns_count; column++ ) {
+			page += check_add_text(font, table_cell(&attr_table->store, row, column));
+		}
+		page_max = ( page > page_max )?page:page_max;
+	}
+	cost->quads += header + page_max;
+	cost->overdraw += ( header + page_max ) * attr_table->font_size * attr_table->font_size * CHECK_GLYPH_ASPECT;
+}
+
+static void check_text(screen_element *element, check_cost *cost) {
+	screen_attrs_text *attr_text = element->attrs;
+	cost->texts++;
+	check_font *font = ( attr_text->font_name != NULL )?check_get_font(attr_text->font_name, attr_text->font_size):NULL;
+	const char *text = attr_text->text;
+	char str_time[128];
+	if( element->type == SCREEN_CLOCK ) {
+		time_t now = time(NULL);
+		struct tm tm_local;
+		check_add_text(font, "0123456789");
+		if( localtime_r(&now, &tm_local) != NULL && strftime(str_time, sizeof(str_time), attr_text->text, &tm_local) > 0 ) {
+			text = str_time;
+		}
+	}
+	uint_fast32_t quads = check_add_text(font, text);
+	cost->quads += quads;
+	cost->overdraw += quads * attr_text->font_size * attr_text->font_size * CHECK_GLYPH_ASPECT;
+}
+
+/*******************************************************************************
+ * Estimates the cost of the elements of a loaded layout
+ ******************************************************************************/
+static check_cost check_elements(layout *l) {
+	check_cost cost = { 0 };
+	double render_area = (double)config.render_width * config.render_height;
+	cost.overdraw = render_area;  // clearing
+	if( l->background != NULL ) {
+		cost.overdraw += render_area;
+	}
+	uint_fast32_t count;
+	screen_element *elements = screen_get_elements(&count);
+	for( uint_fast32_t i = 0; i < count; i++ ) {
+		screen_element *element = &elements[i];
+		cost.elements++;
+		cost.scripts += ( element->evals != NULL );
+		cost.animations += ( element->anim != NULL );
+		if( element->fill != NULL ) {
+			cost.overdraw += check_area(element->position.x, element->position.y, element->position.w, element->position.h);
+		}
+		if( element->type == SCREEN_IMG ) {
+			check_image(element, &cost);
+		}
+		else if( element->type == SCREEN_TABLE ) {
+			check_table(element, &cost);
+		}
+		else {
+			check_text(element, &cost);
+		}
+	}
+	cost.overdraw /= render_area;
+	cost.script_runs = cost.scripts * (( config.script_tick_rate > 0 )?config.script_tick_rate:config.fps);
+
+	cost.fonts = check_fonts_count;
+	for( uint_fast32_t i = 0; i < check_fonts_count; i++ ) {
+		cost.glyphs += check_fonts[i].codepoints_count;
+		cost.atlas_bytes += check_atlas_bytes(&check_fonts[i]);
+		free(check_fonts[i].codepoints);
+	}
+	free(check_fonts);
+	check_fonts = NULL;
+	check_fonts_count = 0;
+	return cost;
+}
+
+static bool check_budget(const check_cost *cost) {
+	bool ok = true;
+	double mib = ( cost->texture_bytes + cost->atlas_bytes ) / ( 1024.0 * 1024.0 );
+	if( config.check_max_texture_mib > 0 && mib > config.check_max_texture_mib ) {
+		LOG_WARNING("Textures and glyph pages use %.1fMiB, more than %dMiB", mib, config.check_max_texture_mib);
+		ok = false;
+	}
+	if( config.check_max_overdraw > 0 && cost->overdraw > config.check_max_overdraw ) {
+		LOG_WARNING("Overdraw of %.2f exceeds %.2f", cost->overdraw, config.check_max_overdraw);
+		ok = false;
+	}
+	if( config.check_max_script_runs > 0 && cost->script_runs > config.check_max_script_runs ) {
+		LOG_WARNING("%.0f script runs per second exceed %.0f", cost->script_runs, config.check_max_script_runs);
+		ok = false;
+	}
+	return ok;
+}
+
+/*******************************************************************************
+ * Validates a layout and estimates what it costs per frame, without opening a
+ * window. Problems are logged, the result is printed as a JSON line.
+ * @param *layout_name name of the file in layouts/ without .json
+ * @return true if the layout is valid and within the "check" budgets
+ ******************************************************************************/
+bool check_layout(char *layout_name) {
+	LOG_INFO("Check layout »%s«", layout_name);
+	check_errors = 0;
+	check_lua = luaL_newstate();
+	FAIL_ON_NULL(check_lua, "Failed to create lua state");
+	bool parsed = check_file(layout_name);
+	lua_close(check_lua);
+
+	check_cost cost = { 0 };
+	bool ok = parsed;
+	if( parsed ) {
+		layout *l = layout_load(layout_name);
+		screen_element_list *previous = screen_build(l->elements);
+		cost = check_elements(l);
+		screen_build(previous);
+		layout_unload(l);
+		ok = check_budget(&cost);
+	}
+	ok = ok && check_errors == 0;
+
+	cJSON *result = cJSON_CreateObject();
+	cJSON_AddStringToObject(result, "layout", layout_name);
+	cJSON_AddNumberToObject(result, "errors", check_errors);
+	cJSON_AddNumberToObject(result, "elements", cost.elements);
+	cJSON_AddNumberToObject(result, "images", cost.images);
+	cJSON_AddNumberToObject(result, "texts", cost.texts);
+	cJSON_AddNumberToObject(result, "tables", cost.tables);
+	cJSON_AddNumberToObject(result, "table_rows", cost.table_rows);
+	cJSON_AddNumberToObject(result, "animations", cost.animations);
+	cJSON_AddNumberToObject(result, "scripts", cost.scripts);
+	cJSON_AddNumberToObject(result, "script_runs_per_second", cost.script_runs);
+	cJSON_AddNumberToObject(result, "texture_bytes", cost.texture_bytes);
+	cJSON_AddNumberToObject(result, "fonts", cost.fonts);
+	cJSON_AddNumberToObject(result, "glyphs", cost.glyphs);
+	cJSON_AddNumberToObject(result, "atlas_bytes", cost.atlas_bytes);
+	cJSON_AddNumberToObject(result, "quads_per_frame", cost.quads);
+	cJSON_AddNumberToObject(result, "overdraw", cost.overdraw);
+	cJSON_AddBoolToObject(result, "ok", ok);
+	char *line = cJSON_PrintUnformatted(result);
+	cJSON_Delete(result);
+	printf("%s\n", line);
+	free(line);
+
+	LOG_INFO("Layout »%s«: %lu errors, %.1fMiB textures, %.1fMiB glyph pages, %lu glyphs and %.1f overdraw per frame, %.0f script runs per second: %s",
+			layout_name, check_errors, cost.texture_bytes / ( 1024.0 * 1024.0 ), cost.atlas_bytes / ( 1024.0 * 1024.0 ),
+			cost.quads, cost.overdraw, cost.script_runs, ok?"ok":"FAILED");
+	return ok;
+}
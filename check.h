@@ -0,0 +1,59 @@
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+
+#ifndef CHECK_ATLAS_FILL
+#define CHECK_ATLAS_FILL 0.7  // share of a glyph page shelf packing is expected to fill
+#endif
+
+#ifndef CHECK_GLYPH_ASPECT
+#define CHECK_GLYPH_ASPECT 0.5  // average glyph width relative to the font size
+#endif
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <raylib.h>
+#include <lua.h>
+#include <lauxlib.h>
+
+#include "log.h"
+#include "helpers.h"
+#include "config.h"
+#include "screen.h"
+#include "layout.h"
+#include "texture.h"
+#include "glyph.h"
+#include "script.h"
+#include "cJSON.h"
+
+
+// static per frame cost of a layout
+typedef struct check_cost {
+	uint_fast32_t elements;
+	uint_fast32_t images;
+	uint_fast32_t texts;     // including clocks
+	uint_fast32_t tables;
+	uint_fast32_t table_rows;
+	uint_fast32_t scripts;
+	uint_fast32_t animations;
+	size_t texture_bytes;    // base level of all images as uploaded
+	uint_fast32_t fonts;     // glyph caches, one per font file and size
+	uint_fast32_t glyphs;    // distinct glyphs rasterized into the caches
+	size_t atlas_bytes;      // glyph pages the caches are expected to need
+	uint_fast32_t quads;     // glyphs drawn per frame
+	double script_runs;      // per second
+	double overdraw;         // pixels drawn per frame relative to the render area, clearing included
+} check_cost;
+
+
+bool check_layout(char *layout_name);
+
+
+#endif
@@ -4,9 +4,13 @@ static const char *TOPIC = "config management";
 
 
 void parse_cmd(int argc, char* argv[]) {
+	static const struct option long_options[] = {
+		{ "check", no_argument, NULL, 'k' },
+		{ NULL, 0, NULL, 0 },
+	};
 	log_level = 1;
-	char opt;
-	while( (opt = getopt(argc, argv, "vcdn")) != -1 ) {
+	int opt;
+	while( (opt = getopt_long(argc, argv, "vcdnbB:Ck", long_options, NULL)) != -1 ) {
 		switch(opt) {
 			case 'v':
 				log_level++;
@@ -20,11 +24,146 @@ void parse_cmd(int argc, char* argv[]) {
 			case 'n':
 				log_date = false;
 				break;
+			case 'b':
+				do_bench_scripts = true;
+				break;
+			case 'B': {
+				char *end;
+				do_bench = true;
+				errno = 0;
+				bench_size = strtoul(optarg, &end, 10);
+				if( end == optarg || *end != '\0' || errno != 0 || bench_size == 0 ) {
+					LOG_FATAL("Invalid number of bench elements »%s«, has to be a positive number", optarg);
+				}
+				break;
+			}
+			case 'C':
+				do_convert_textures = true;
+				break;
+			case 'k':
+				do_check = true;
+				break;
+		}
+	}
+	// layouts to check, the configured one if none are given
+	check_layouts = argv + optind;
+	check_layouts_count = argc - optind;
+}
+
+static int parse_scale_filter(cJSON *cjson_scale_filter) {
+	if( !cjson_scale_filter || !cJSON_IsString(cjson_scale_filter) ) {
+		return FILTER_BILINEAR;
+	}
+	char *filter = cjson_scale_filter->valuestring;
+	if( strcmp(filter, "point") == 0 ) {
+		return FILTER_POINT;
+	}
+	if( strcmp(filter, "bilinear") != 0 ) {
+		LOG_WARNING("Unknown scale filter »%s«, using bilinear", filter);
+	}
+	return FILTER_BILINEAR;
+}
+
+/*******************************************************************************
+ * Parses a time like "22:30", "24:00" is the end of the day
+ * @return minutes since midnight, -1 if not set or invalid
+ ******************************************************************************/
+static int parse_schedule_time(cJSON *cjson_time) {
+	unsigned int hours, minutes;
+	if( !cjson_time || !cJSON_IsString(cjson_time) ) {
+		return -1;
+	}
+	if( sscanf(cjson_time->valuestring, "%u:%u", &hours, &minutes) != 2 || minutes > 59 ||
+			hours > 24 || ( hours == 24 && minutes > 0 ) ) {
+		LOG_WARNING("Invalid schedule time »%s«, expected HH:MM", cjson_time->valuestring);
+		return -1;
+	}
+	return hours * 60 + minutes;
+}
+
+/*******************************************************************************
+ * Parses a date like "2026-12-24"
+ * @return the date as yyyymmdd, 0 if not set or invalid
+ ******************************************************************************/
+static long parse_schedule_date(cJSON *cjson_date) {
+	unsigned int year, month, day;
+	if( !cjson_date || !cJSON_IsString(cjson_date) ) {
+		return 0;
+	}
+	if( sscanf(cjson_date->valuestring, "%u-%u-%u", &year, &month, &day) != 3 || month > 12 || day > 31 ) {
+		LOG_WARNING("Invalid schedule date »%s«, expected YYYY-MM-DD", cjson_date->valuestring);
+		return 0;
+	}
+	return year * 10000L + month * 100 + day;
+}
+
+/*******************************************************************************
+ * Parses the days of a schedule entry, either "weekdays", "weekend" or an
+ * array of day names like ["sat", "sun"]
+ * @return bit per weekday, bit 0 is sunday
+ ******************************************************************************/
+static uint8_t parse_schedule_days(cJSON *cjson_days) {
+	static const char *names[] = { "sun", "mon", "tue", "wed", "thu", "fri", "sat" };
+	if( !cjson_days ) {
+		return 0x7f;
+	}
+	if( cJSON_IsString(cjson_days) ) {
+		if( strcmp(cjson_days->valuestring, "weekdays") == 0 ) {
+			return 0x3e;
+		}
+		if( strcmp(cjson_days->valuestring, "weekend") == 0 ) {
+			return 0x41;
+		}
+		LOG_WARNING("Unknown schedule days »%s«, using every day", cjson_days->valuestring);
+		return 0x7f;
+	}
+	uint8_t days = 0;
+	cJSON *cjson_day;
+	cJSON_ArrayForEach(cjson_day, cjson_days) {
+		bool known = false;
+		for( int i = 0; i < 7 && cJSON_IsString(cjson_day); i++ ) {
+			if( strncmp(cjson_day->valuestring, names[i], 3) == 0 ) {
+				days |= 1 << i;
+				known = true;
+			}
+		}
+		if( !known ) {
+			LOG_WARNING("Unknown schedule day in entry, ignoring it");
+		}
+	}
+	return days;
+}
+
+static void parse_schedule(cJSON *cjson_entries) {
+	config.schedule_count = 0;
+	config.schedule = NULL;
+	if( !cjson_entries || !cJSON_IsArray(cjson_entries) ) {
+		return;
+	}
+	MALLOC(config.schedule, sizeof(config_schedule) * (cJSON_GetArraySize(cjson_entries) + 1));
+	cJSON *cjson_entry;
+	cJSON_ArrayForEach(cjson_entry, cjson_entries) {
+		config_schedule *entry = &config.schedule[config.schedule_count];
+		cJSON *cjson_layout = cJSON_GetObjectItemCaseSensitive(cjson_entry, "layout");
+		CJSON_DEF_STR(entry->layout, cjson_layout, NULL);
+		if( entry->layout == NULL ) {
+			LOG_WARNING("Ignoring schedule entry without layout");
+			continue;
+		}
+		entry->from = parse_schedule_time(cJSON_GetObjectItemCaseSensitive(cjson_entry, "from"));
+		entry->to = parse_schedule_time(cJSON_GetObjectItemCaseSensitive(cjson_entry, "to"));
+		entry->days = parse_schedule_days(cJSON_GetObjectItemCaseSensitive(cjson_entry, "days"));
+		entry->date = parse_schedule_date(cJSON_GetObjectItemCaseSensitive(cjson_entry, "date"));
+		entry->until = parse_schedule_date(cJSON_GetObjectItemCaseSensitive(cjson_entry, "until"));
+		if( entry->until == 0 ) {
+			entry->until = entry->date;
 		}
+		config.schedule_count++;
 	}
 }
 
 void parse_config(char *path) {
+	PROFILE_FUNC();
 	LOG_INFO("parsing config file: %s", path);
 	char *str_config = NULL;
 	if( !read_file(&str_config, path) ) {
@@ -47,14 +186,67 @@ void parse_config(char *path) {
 	cJSON *cjson_resolution = cJSON_GetObjectItemCaseSensitive(cjson_config, "resolution");
 	cJSON *cjson_name = cJSON_GetObjectItemCaseSensitive(cjson_config, "name");
 	cJSON *cjson_fps = cJSON_GetObjectItemCaseSensitive(cjson_config, "fps");
+	cJSON *cjson_vram_budget = cJSON_GetObjectItemCaseSensitive(cjson_config, "vram-budget");
+	cJSON *cjson_texture_compression = cJSON_GetObjectItemCaseSensitive(cjson_config, "texture-compression");
+	cJSON *cjson_mipmaps = cJSON_GetObjectItemCaseSensitive(cjson_config, "mipmaps");
+	cJSON *cjson_atlas = cJSON_GetObjectItemCaseSensitive(cjson_config, "atlas");
+	cJSON *cjson_atlas_max_size = cJSON_GetObjectItemCaseSensitive(cjson_atlas, "max-size");
+	cJSON *cjson_glyph_cache = cJSON_GetObjectItemCaseSensitive(cjson_config, "glyph-cache");
+	cJSON *cjson_glyph_cache_path = cJSON_GetObjectItemCaseSensitive(cjson_glyph_cache, "path");
+	cJSON *cjson_schedule = cJSON_GetObjectItemCaseSensitive(cjson_config, "schedule");
+	cJSON *cjson_schedule_entries = cJSON_GetObjectItemCaseSensitive(cjson_schedule, "entries");
+	cJSON *cjson_schedule_prewarm = cJSON_GetObjectItemCaseSensitive(cjson_schedule, "prewarm");
+	cJSON *cjson_schedule_fade = cJSON_GetObjectItemCaseSensitive(cjson_schedule, "fade");
 	cJSON *cjson_width = cJSON_GetObjectItemCaseSensitive(cjson_resolution, "width");
 	cJSON *cjson_height = cJSON_GetObjectItemCaseSensitive(cjson_resolution, "height");
+	cJSON *cjson_render = cJSON_GetObjectItemCaseSensitive(cjson_config, "render-resolution");
+	cJSON *cjson_render_width = cJSON_GetObjectItemCaseSensitive(cjson_render, "width");
+	cJSON *cjson_render_height = cJSON_GetObjectItemCaseSensitive(cjson_render, "height");
+	cJSON *cjson_scale_filter = cJSON_GetObjectItemCaseSensitive(cjson_config, "scale-filter");
+	cJSON *cjson_mirror = cJSON_GetObjectItemCaseSensitive(cjson_config, "mirror");
+	cJSON *cjson_mirror_path = cJSON_GetObjectItemCaseSensitive(cjson_mirror, "path");
+	cJSON *cjson_mirror_interval = cJSON_GetObjectItemCaseSensitive(cjson_mirror, "interval");
+	cJSON *cjson_control = cJSON_GetObjectItemCaseSensitive(cjson_config, "control");
+	cJSON *cjson_control_path = cJSON_GetObjectItemCaseSensitive(cjson_control, "path");
+	cJSON *cjson_scripts = cJSON_GetObjectItemCaseSensitive(cjson_config, "scripts");
+	cJSON *cjson_scripts_tick_rate = cJSON_GetObjectItemCaseSensitive(cjson_scripts, "tick-rate");
+	cJSON *cjson_check = cJSON_GetObjectItemCaseSensitive(cjson_config, "check");
+	cJSON *cjson_check_max_texture = cJSON_GetObjectItemCaseSensitive(cjson_check, "max-texture-mib");
+	cJSON *cjson_check_max_overdraw = cJSON_GetObjectItemCaseSensitive(cjson_check, "max-overdraw");
+	cJSON *cjson_check_max_script_runs = cJSON_GetObjectItemCaseSensitive(cjson_check, "max-script-runs");
+	cJSON *cjson_bench = cJSON_GetObjectItemCaseSensitive(cjson_config, "bench");
+	cJSON *cjson_bench_frames = cJSON_GetObjectItemCaseSensitive(cjson_bench, "frames");
+	cJSON *cjson_bench_max_p99 = cJSON_GetObjectItemCaseSensitive(cjson_bench, "max-p99-ms");
+	cJSON *cjson_bench_max_rss = cJSON_GetObjectItemCaseSensitive(cjson_bench, "max-rss-mib");
+	cJSON *cjson_bench_max_allocs = cJSON_GetObjectItemCaseSensitive(cjson_bench, "max-allocs-per-frame");
 
 	CJSON_DEF_STR(config.layout, cjson_layout, "default");
 	CJSON_DEF_STR(config.name, cjson_name, "");
 	CJSON_DEF_INT(config.fps, cjson_fps, 60);
+	CJSON_DEF_INT(config.vram_budget, cjson_vram_budget, 64);
+	CJSON_DEF_BOOL(config.texture_compression, cjson_texture_compression, true);
+	CJSON_DEF_BOOL(config.mipmaps, cjson_mipmaps, true);
+	CJSON_DEF_INT(config.atlas_max_size, cjson_atlas_max_size, 128);
+	CJSON_DEF_STR(config.glyph_cache_path, cjson_glyph_cache_path, NULL);
 	CJSON_DEF_INT(config.width, cjson_width, 500);
 	CJSON_DEF_INT(config.height, cjson_height, 500);
+	CJSON_DEF_INT(config.render_width, cjson_render_width, config.width);
+	CJSON_DEF_INT(config.render_height, cjson_render_height, config.height);
+	config.scale_filter = parse_scale_filter(cjson_scale_filter);
+	parse_schedule(cjson_schedule_entries);
+	CJSON_DEF_DOUBLE(config.schedule_prewarm, cjson_schedule_prewarm, 30.0);
+	CJSON_DEF_DOUBLE(config.schedule_fade, cjson_schedule_fade, 0.0);
+	CJSON_DEF_STR(config.mirror_path, cjson_mirror_path, NULL);
+	CJSON_DEF_DOUBLE(config.mirror_interval, cjson_mirror_interval, 5.0);
+	CJSON_DEF_STR(config.control_path, cjson_control_path, NULL);
+	CJSON_DEF_DOUBLE(config.script_tick_rate, cjson_scripts_tick_rate, 15.0);
+	CJSON_DEF_INT(config.check_max_texture_mib, cjson_check_max_texture, config.vram_budget);
+	CJSON_DEF_DOUBLE(config.check_max_overdraw, cjson_check_max_overdraw, 0.0);
+	CJSON_DEF_DOUBLE(config.check_max_script_runs, cjson_check_max_script_runs, 0.0);
+	CJSON_DEF_INT(config.bench_frames, cjson_bench_frames, 600);
+	CJSON_DEF_DOUBLE(config.bench_max_p99, cjson_bench_max_p99, 1000.0 / config.fps);
+	CJSON_DEF_INT(config.bench_max_rss, cjson_bench_max_rss, 0);
+	CJSON_DEF_DOUBLE(config.bench_max_allocs, cjson_bench_max_allocs, -1.0);
 
 	cJSON_Delete(cjson_config);
 }
@@ -5,21 +5,54 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "log.h"
 #include "main.h"
 #include "helpers.h"
+#include "profile.h"
 #include "cJSON.h"
 
 
+typedef struct config_schedule {
+	char *layout;
+	int from, to;        // minutes since midnight, -1 for the whole day
+	uint8_t days;        // bit per weekday, bit 0 is sunday like tm_wday
+	long date, until;    // yyyymmdd, 0 for any date
+} config_schedule;
+
 struct config {
 	int width;
 	int height;
+	int render_width;   // internal resolution the layout is drawn at
+	int render_height;
+	int scale_filter;   // raylib texture filter used to upscale to the window
 	int fps;
+	int vram_budget;  // MiB
+	bool texture_compression;  // prefer pre-compressed .ktx/.dds siblings of images
+	bool mipmaps;              // generate mipmaps for minified images
+	int atlas_max_size;        // images up to this width and height are packed into atlas pages, 0 to disable
+	char *glyph_cache_path;    // directory rasterized glyphs are kept in across restarts, NULL if disabled
 	char *name;
 	char *layout;
+	char *mirror_path;  // NULL if mirroring is disabled, "unix:" prefix for sockets
+	double mirror_interval;  // seconds
+	char *control_path;  // UNIX socket accepting commands, NULL if disabled
+	double script_tick_rate;  // Hz scripts run at, positions are interpolated in between, 0 to run every frame
+	config_schedule *schedule;  // the last entry matching the current time wins
+	int schedule_count;
+	double schedule_prewarm; // seconds a scheduled layout is prepared before it's shown
+	double schedule_fade;    // seconds, 0 to switch hard
+	int check_max_texture_mib;     // images and glyph pages, 0 to disable
+	double check_max_overdraw;     // pixels drawn per frame relative to the render area, 0 to disable
+	double check_max_script_runs;  // per second, 0 to disable
+	int bench_frames;        // frames recorded by make bench
+	double bench_max_p99;    // ms, frame time budget
+	int bench_max_rss;       // MiB, 0 to disable
+	double bench_max_allocs; // per frame, negative to disable
 } config;
 
 
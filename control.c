@@ -0,0 +1,465 @@
+#define _GNU_SOURCE  // accept4
+
+#include "control.h"
+
+static const char *TOPIC = "control";
+
+
+#define CONTROL_EVENT_LISTEN CONTROL_MAX_CLIENTS
+#define CONTROL_EVENT_WAKE (CONTROL_MAX_CLIENTS + 1)
+
+static control_queue control_commands;  // I/O thread to screen thread
+static control_queue control_replies;   // screen thread to I/O thread
+static control_client control_clients[CONTROL_MAX_CLIENTS];
+static pthread_t control_thread;
+static atomic_bool control_stop;
+static bool control_enabled;
+static bool control_paused;
+static int control_socket = -1;
+static int control_epoll = -1;
+static int control_wake = -1;  // eventfd, signals replies or stop to the I/O thread
+
+
+static bool control_push(control_queue *queue, const control_message *message) {
+	uint_fast32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	uint_fast32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+	if( tail - head == CONTROL_QUEUE_SIZE ) {
+		return false;
+	}
+	queue->messages[tail & (CONTROL_QUEUE_SIZE - 1)] = *message;
+	atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+	return true;
+}
+
+/*******************************************************************************
+ * Tests if a push would fail, only meaningful for the producer, as the
+ * consumer can only make room meanwhile
+ ******************************************************************************/
+static bool control_full(control_queue *queue) {
+	uint_fast32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	uint_fast32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+	return tail - head == CONTROL_QUEUE_SIZE;
+}
+
+static bool control_pop(control_queue *queue, control_message *message) {
+	uint_fast32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	uint_fast32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+	if( head == tail ) {
+		return false;
+	}
+	*message = queue->messages[head & (CONTROL_QUEUE_SIZE - 1)];
+	atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+	return true;
+}
+
+static void control_drop_client(uint_fast32_t slot) {
+	control_client *client = &control_clients[slot];
+	epoll_ctl(control_epoll, EPOLL_CTL_DEL, client->fd, NULL);
+	close(client->fd);
+	client->fd = -1;
+	client->generation++;
+	LOG_VERBOSE("Client %lu disconnected", slot);
+}
+
+static void control_watch(uint_fast32_t slot, uint32_t events) {
+	struct epoll_event event = { .events = events, .data.u32 = slot };
+	epoll_ctl(control_epoll, EPOLL_CTL_MOD, control_clients[slot].fd, &event);
+}
+
+/*******************************************************************************
+ * Sends as much of the buffered replies as the socket takes, the client is
+ * watched for EPOLLOUT while some are left
+ ******************************************************************************/
+static void control_flush(uint_fast32_t slot) {
+	control_client *client = &control_clients[slot];
+	size_t done = 0;
+	while( done < client->out_length ) {
+		ssize_t sent = send(client->fd, client->out + done, client->out_length - done, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if( sent < 0 && errno == EINTR ) {
+			continue;
+		}
+		if( sent < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ) {
+			break;
+		}
+		if( sent < 0 ) {
+			control_drop_client(slot);
+			return;
+		}
+		done += sent;
+	}
+	memmove(client->out, client->out + done, client->out_length - done);
+	client->out_length -= done;
+	if( client->out_watched != ( client->out_length > 0 ) ) {
+		client->out_watched = client->out_length > 0;
+		control_watch(slot, client->out_watched?EPOLLIN | EPOLLOUT:EPOLLIN);
+	}
+}
+
+/*******************************************************************************
+ * Sends a reply line without blocking. What the socket doesn't take is
+ * buffered, so a line is never cut. It's dropped as a whole if the client
+ * doesn't read its replies fast enough.
+ ******************************************************************************/
+static void control_send(uint_fast32_t slot, const char *line) {
+	control_client *client = &control_clients[slot];
+	size_t length = strlen(line);
+	if( client->out_length + length > CONTROL_OUT_SIZE ) {
+		LOG_VERBOSE("Client %lu doesn't read its replies, dropped one", slot);
+		return;
+	}
+	bool waiting = client->out_length > 0;
+	memcpy(client->out + client->out_length, line, length);
+	client->out_length += length;
+	// a client waiting for EPOLLOUT is flushed by it, keeping the order
+	if( !waiting ) {
+		control_flush(slot);
+	}
+}
+
+/*******************************************************************************
+ * Parses a command line and queues it for the screen thread. Syntax errors are
+ * queued as well to keep the replies in order, only a full queue is answered
+ * right away.
+ ******************************************************************************/
+static void control_handle_line(uint_fast32_t slot, char *line) {
+	control_message message = { .client = slot, .generation = control_clients[slot].generation };
+	char *args = line + strcspn(line, " \t");
+	if( *args != '\0' ) {
+		*args++ = '\0';
+	}
+	args += strspn(args, " \t");
+
+	if( *line == '\0' ) {
+		return;
+	}
+	else if( strcmp(line, "reload") == 0 ) { message.type = CONTROL_RELOAD; }
+	else if( strcmp(line, "pause") == 0 ) { message.type = CONTROL_PAUSE; }
+	else if( strcmp(line, "resume") == 0 ) { message.type = CONTROL_RESUME; }
+	else if( strcmp(line, "stats") == 0 ) { message.type = CONTROL_STATS; }
+	else if( strcmp(line, "text") == 0 || strcmp(line, "visible") == 0 ) {
+		char *end;
+		message.element_id = strtoul(args, &end, 10);
+		char *value = end + strspn(end, " \t");
+		if( end == args || ( *end != ' ' && *end != '\t' && *end != '\0' ) ) {
+			message.type = CONTROL_REPLY;
+			strcpy(message.text, "error expected an element id\n");
+		}
+		else if( line[0] == 't' ) {
+			message.type = CONTROL_TEXT;
+			snprintf(message.text, sizeof(message.text), "%s", value);
+		}
+		else if( strcmp(value, "1") == 0 || strcmp(value, "true") == 0 || strcmp(value, "0") == 0 || strcmp(value, "false") == 0 ) {
+			message.type = CONTROL_VISIBLE;
+			message.visible = value[0] == '1' || value[0] == 't';
+		}
+		else {
+			message.type = CONTROL_REPLY;
+			strcpy(message.text, "error expected 1, 0, true or false\n");
+		}
+	}
+	else {
+		message.type = CONTROL_REPLY;
+		strcpy(message.text, "error unknown command\n");
+	}
+
+	if( !control_push(&control_commands, &message) ) {
+		control_send(slot, "error busy\n");
+	}
+}
+
+static void control_read(uint_fast32_t slot) {
+	control_client *client = &control_clients[slot];
+	char chunk[1024];
+	while( client->fd >= 0 ) {
+		ssize_t received = recv(client->fd, chunk, sizeof(chunk), 0);
+		if( received < 0 && errno == EINTR ) {
+			continue;
+		}
+		if( received < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ) {
+			return;
+		}
+		if( received <= 0 ) {
+			control_drop_client(slot);
+			return;
+		}
+		for( ssize_t i = 0; i < received && client->fd >= 0; i++ ) {
+			if( chunk[i] != '\n' ) {
+				if( client->length < CONTROL_LINE_MAX - 1 ) {
+					client->line[client->length++] = chunk[i];
+				}
+				else {
+					client->overlong = true;
+				}
+				continue;
+			}
+			if( client->length > 0 && client->line[client->length-1] == '\r' ) {
+				client->length--;
+			}
+			client->line[client->length] = '\0';
+			if( client->overlong ) {
+				control_send(slot, "error line too long\n");
+			}
+			else {
+				control_handle_line(slot, client->line);
+			}
+			client->length = 0;
+			client->overlong = false;
+		}
+	}
+}
+
+static void control_accept() {
+	while( true ) {
+		int fd = accept4(control_socket, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if( fd < 0 ) {
+			if( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR ) {
+				LOG_WARNING("Failed to accept control client: %s", strerror(errno));
+			}
+			return;
+		}
+		uint_fast32_t slot = 0;
+		while( slot < CONTROL_MAX_CLIENTS && control_clients[slot].fd >= 0 ) {
+			slot++;
+		}
+		if( slot == CONTROL_MAX_CLIENTS ) {
+			send(fd, "error too many clients\n", sizeof("error too many clients\n") - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+			close(fd);
+			continue;
+		}
+		control_client *client = &control_clients[slot];
+		client->fd = fd;
+		client->length = 0;
+		client->overlong = false;
+		client->out_length = 0;
+		client->out_watched = false;
+		struct epoll_event event = { .events = EPOLLIN, .data.u32 = slot };
+		if( epoll_ctl(control_epoll, EPOLL_CTL_ADD, fd, &event) != 0 ) {
+			LOG_ERROR("Failed to watch control client: %s", strerror(errno));
+			control_drop_client(slot);
+			continue;
+		}
+		LOG_VERBOSE("Client %lu connected", slot);
+	}
+}
+
+static void control_send_replies() {
+	uint64_t count;
+	if( read(control_wake, &count, sizeof(count)) < 0 && errno != EAGAIN ) {
+		LOG_WARNING("Failed to read control wakeup: %s", strerror(errno));
+	}
+	control_message reply;
+	while( control_pop(&control_replies, &reply) ) {
+		control_client *client = &control_clients[reply.client];
+		if( client->fd >= 0 && client->generation == reply.generation ) {
+			control_send(reply.client, reply.text);
+		}
+	}
+}
+
+static void *control_worker(void *_) {
+	PROFILE_THREAD_NAME("control");
+	struct epoll_event events[CONTROL_MAX_CLIENTS + 2];
+	while( !atomic_load(&control_stop) ) {
+		int count = epoll_wait(control_epoll, events, CONTROL_MAX_CLIENTS + 2, -1);
+		if( count < 0 ) {
+			if( errno != EINTR ) {
+				LOG_ERROR("Failed to wait for control events: %s", strerror(errno));
+				break;
+			}
+			continue;
+		}
+		for( int i = 0; i < count; i++ ) {
+			uint32_t slot = events[i].data.u32;
+			if( slot == CONTROL_EVENT_LISTEN ) {
+				control_accept();
+			}
+			else if( slot == CONTROL_EVENT_WAKE ) {
+				control_send_replies();
+			}
+			else {
+				if( ( events[i].events & EPOLLOUT ) && control_clients[slot].fd >= 0 ) {
+					control_flush(slot);
+				}
+				if( ( events[i].events & ( EPOLLIN | EPOLLHUP | EPOLLERR ) ) && control_clients[slot].fd >= 0 ) {
+					control_read(slot);
+				}
+			}
+		}
+	}
+	return NULL;
+}
+
+/*******************************************************************************
+ * Opens the control socket if configured and starts its I/O thread
+ ******************************************************************************/
+void control_init() {
+	if( config.control_path == NULL ) {
+		return;
+	}
+	for( uint_fast32_t i = 0; i < CONTROL_MAX_CLIENTS; i++ ) {
+		control_clients[i].fd = -1;
+	}
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	strncpy(addr.sun_path, config.control_path, sizeof(addr.sun_path) - 1);
+	unlink(addr.sun_path);
+	control_socket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if( control_socket < 0 || bind(control_socket, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(control_socket, SOMAXCONN) != 0 ) {
+		LOG_ERROR("Failed to open control socket %s: %s", addr.sun_path, strerror(errno));
+		if( control_socket >= 0 ) {
+			close(control_socket);
+			control_socket = -1;
+		}
+		return;
+	}
+	control_epoll = epoll_create1(EPOLL_CLOEXEC);
+	control_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if( control_epoll < 0 || control_wake < 0 ) {
+		LOG_FATAL("Failed to set up control events: %s", strerror(errno));
+	}
+	struct epoll_event event = { .events = EPOLLIN, .data.u32 = CONTROL_EVENT_LISTEN };
+	epoll_ctl(control_epoll, EPOLL_CTL_ADD, control_socket, &event);
+	event.data.u32 = CONTROL_EVENT_WAKE;
+	epoll_ctl(control_epoll, EPOLL_CTL_ADD, control_wake, &event);
+
+	atomic_store(&control_stop, false);
+	if( pthread_create(&control_thread, NULL, control_worker, NULL) ) {
+		LOG_FATAL("Failed to start thread control_worker");
+	}
+	control_enabled = true;
+	LOG_INFO("Listening for commands on %s", addr.sun_path);
+}
+
+/*******************************************************************************
+ * Escapes a string for a JSON string literal, it's cut before an escape
+ * sequence which doesn't fit
+ ******************************************************************************/
+static void control_escape(char *out, size_t size, const char *in) {
+	size_t length = 0;
+	for( ; in != NULL && *in != '\0'; in++ ) {
+		unsigned char c = *in;
+		char escaped[8];
+		if( c == '"' || c == '\\' ) {
+			snprintf(escaped, sizeof(escaped), "\\%c", c);
+		}
+		else if( c < 0x20 ) {
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+		}
+		else {
+			escaped[0] = c;
+			escaped[1] = '\0';
+		}
+		size_t escaped_length = strlen(escaped);
+		if( length + escaped_length >= size ) {
+			break;
+		}
+		memcpy(out + length, escaped, escaped_length);
+		length += escaped_length;
+	}
+	out[length] = '\0';
+}
+
+static void control_stats(char *line, size_t size) {
+	uint_fast32_t count;
+	screen_get_elements(&count);
+	vram_stats vram = vram_get_stats();
+	screen_cull_stats culled = screen_get_cull_stats();
+	char layout_name[CONTROL_LINE_MAX / 4];
+	control_escape(layout_name, sizeof(layout_name), layout_current_name());
+	snprintf(line, size, "{\"layout\":\"%s\",\"paused\":%s,\"fps\":%d,\"frame-ms\":%.2f,\"elements\":%lu,"
+			"\"drawn\":%lu,\"culled-offscreen\":%lu,\"culled-occluded\":%lu,"
+			"\"vram-bytes\":%lu,\"vram-budget\":%lu,\"vram-evictions\":%lu}\n",
+			layout_name, control_paused?"true":"false", GetFPS(), GetFrameTime() * 1000.0,
+			count, culled.drawn, culled.offscreen, culled.occluded, vram.bytes_resident, vram.bytes_budget, vram.evictions);
+}
+
+/*******************************************************************************
+ * Runs the queued commands, called by the screen thread once per frame before
+ * anything is drawn. Never waits for the I/O thread, commands stay queued
+ * while there's no room for their replies, so every command gets one.
+ ******************************************************************************/
+void control_poll() {
+	if( !control_enabled ) {
+		return;
+	}
+	PROFILE_FUNC();
+	control_message command;
+	uint_fast32_t replies = 0;
+	for( uint_fast32_t i = 0; i < CONTROL_COMMANDS_PER_FRAME && !control_full(&control_replies) && control_pop(&control_commands, &command); i++ ) {
+		control_message reply = { .client = command.client, .generation = command.generation, .type = CONTROL_REPLY };
+		strcpy(reply.text, "ok\n");
+		screen_element *element = NULL;
+		if( command.type == CONTROL_TEXT || command.type == CONTROL_VISIBLE ) {
+			element = screen_get_element(command.element_id);
+			if( element == NULL ) {
+				strcpy(command.text, "error unknown element\n");
+				command.type = CONTROL_REPLY;
+			}
+		}
+		switch( command.type ) {
+			case CONTROL_RELOAD:
+				if( !schedule_load(layout_current_name()) ) {
+					strcpy(reply.text, "error busy\n");
+				}
+				break;
+			case CONTROL_PAUSE:
+				control_paused = true;
+				break;
+			case CONTROL_RESUME:
+				control_paused = false;
+				break;
+			case CONTROL_TEXT:
+				if( element->type != SCREEN_TEXT && element->type != SCREEN_CLOCK ) {
+					strcpy(reply.text, "error element has no text\n");
+					break;
+				}
+				screen_set_text(element, command.text);
+				break;
+			case CONTROL_VISIBLE:
+				screen_set_visible(element, command.visible);
+				break;
+			case CONTROL_STATS:
+				control_stats(reply.text, sizeof(reply.text));
+				break;
+			case CONTROL_REPLY:
+				strcpy(reply.text, command.text);
+				break;
+		}
+		control_push(&control_replies, &reply);
+		replies++;
+	}
+	if( replies > 0 ) {
+		uint64_t one = 1;
+		if( write(control_wake, &one, sizeof(one)) < 0 && errno != EAGAIN ) {
+			LOG_WARNING("Failed to wake control thread: %s", strerror(errno));
+		}
+	}
+}
+
+/*******************************************************************************
+ * Pausing stops the scripts of the elements and scheduled layout switches
+ ******************************************************************************/
+bool control_is_paused() {
+	return control_paused;
+}
+
+void control_close() {
+	if( !control_enabled ) {
+		return;
+	}
+	atomic_store(&control_stop, true);
+	uint64_t one = 1;
+	if( write(control_wake, &one, sizeof(one)) < 0 ) {
+		LOG_WARNING("Failed to stop control thread: %s", strerror(errno));
+	}
+	pthread_join(control_thread, NULL);
+	for( uint_fast32_t i = 0; i < CONTROL_MAX_CLIENTS; i++ ) {
+		if( control_clients[i].fd >= 0 ) {
+			control_drop_client(i);
+		}
+	}
+	close(control_epoll);
+	close(control_wake);
+	close(control_socket);
+	unlink(config.control_path);
+	control_enabled = false;
+}
@@ -0,0 +1,94 @@
+#ifndef __CONTROL_H__
+#define __CONTROL_H__
+
+
+#ifndef CONTROL_QUEUE_SIZE
+#define CONTROL_QUEUE_SIZE 1024  // has to be a power of two
+#endif
+
+#ifndef CONTROL_LINE_MAX
+#define CONTROL_LINE_MAX 512
+#endif
+
+#ifndef CONTROL_OUT_SIZE
+#define CONTROL_OUT_SIZE 8192  // replies buffered per client which doesn't read fast enough
+#endif
+
+#ifndef CONTROL_MAX_CLIENTS
+#define CONTROL_MAX_CLIENTS 64
+#endif
+
+#ifndef CONTROL_COMMANDS_PER_FRAME
+#define CONTROL_COMMANDS_PER_FRAME 256  // bounds the time spent per frame, the rest waits for the next one
+#endif
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <raylib.h>
+
+#include "log.h"
+#include "helpers.h"
+#include "config.h"
+#include "screen.h"
+#include "layout.h"
+#include "schedule.h"
+#include "vram.h"
+#include "profile.h"
+
+
+typedef enum {
+	CONTROL_RELOAD,
+	CONTROL_PAUSE,
+	CONTROL_RESUME,
+	CONTROL_TEXT,
+	CONTROL_VISIBLE,
+	CONTROL_STATS,
+	CONTROL_REPLY,
+} control_type;
+
+typedef struct control_message {
+	uint_fast32_t client;      // slot of the client the command came from
+	uint_fast32_t generation;  // drops replies to a client which disconnected meanwhile
+	control_type type;
+	uint_fast32_t element_id;
+	bool visible;
+	char text[CONTROL_LINE_MAX];  // text of CONTROL_TEXT, reply line of CONTROL_REPLY
+} control_message;
+
+// lock-free ring with a single producer and a single consumer
+typedef struct control_queue {
+	_Atomic uint_fast32_t head;  // next message to read, written by the consumer
+	_Atomic uint_fast32_t tail;  // next message to write, written by the producer
+	control_message messages[CONTROL_QUEUE_SIZE];
+} control_queue;
+
+typedef struct control_client {
+	int fd;  // -1 if the slot is free
+	uint_fast32_t generation;
+	char line[CONTROL_LINE_MAX];
+	size_t length;
+	bool overlong;  // skipping the rest of a line which didn't fit
+	char out[CONTROL_OUT_SIZE];  // replies the socket didn't take yet, sent on EPOLLOUT
+	size_t out_length;
+	bool out_watched;  // watched for EPOLLOUT
+} control_client;
+
+
+void control_init();
+void control_poll();
+bool control_is_paused();
+void control_close();
+
+
+#endif
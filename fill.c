@@ -0,0 +1,143 @@
+#include "fill.h"
+
+static const char *TOPIC = "fill";
+
+
+#if defined(PLATFORM_DESKTOP)
+	#define FILL_GLSL_HEADER "#version 330\n#define IN in\nout vec4 finalColor;\n#define FRAG_COLOR finalColor\n"
+#else
+	#define FILL_GLSL_HEADER "#version 100\nprecision mediump float;\n#define IN varying\n#define FRAG_COLOR gl_FragColor\n"
+#endif
+
+// raylib's default vertex shader passes the texture coordinates and vertex color
+static const char *fill_fragment_shader = FILL_GLSL_HEADER
+	"IN vec2 fragTexCoord;\n"
+	"IN vec4 fragColor;\n"
+	"uniform vec2 size;\n"
+	"uniform float mode;\n"  // fill_type
+	"uniform vec2 direction;\n"
+	"uniform vec4 colorFrom;\n"
+	"uniform vec4 colorTo;\n"
+	"uniform float radius;\n"
+	"uniform float border;\n"
+	"uniform vec4 borderColor;\n"
+	"void main() {\n"
+	"	vec2 halfSize = size * 0.5;\n"
+	"	vec2 p = fragTexCoord * size - halfSize;\n"
+	"	float t = 0.0;\n"
+	"	if( mode > 1.5 ) { t = length(p / halfSize); }\n"
+	"	else if( mode > 0.5 ) { t = dot(p, direction) / dot(halfSize, abs(direction)) * 0.5 + 0.5; }\n"
+	"	vec4 color = mix(colorFrom, colorTo, clamp(t, 0.0, 1.0));\n"
+	// signed distance to the rounded rectangle, negative inside
+	"	vec2 q = abs(p) - halfSize + radius;\n"
+	"	float d = length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - radius;\n"
+	"	if( border > 0.0 ) { color = mix(color, borderColor, clamp(d + border + 0.5, 0.0, 1.0)); }\n"
+	"	color.a *= clamp(0.5 - d, 0.0, 1.0) * fragColor.a;\n"
+	"	FRAG_COLOR = color;\n"
+	"}\n";
+
+static Shader fill_shader;
+static bool fill_shader_loaded;
+static int fill_loc_size, fill_loc_mode, fill_loc_direction, fill_loc_from, fill_loc_to;
+static int fill_loc_radius, fill_loc_border, fill_loc_border_color;
+
+
+/*******************************************************************************
+ * Compiles the fill shader, must be called from the screen thread after the
+ * window was opened. Without it only plain rectangles are drawn.
+ ******************************************************************************/
+void fill_init() {
+	fill_shader = LoadShaderCode(NULL, fill_fragment_shader);
+	fill_shader_loaded = fill_shader.id != 0 && fill_shader.id != GetShaderDefault().id;
+	if( !fill_shader_loaded ) {
+		LOG_ERROR("Failed to compile the fill shader, gradients, rounded corners and borders are drawn flat");
+		return;
+	}
+	fill_loc_size = GetShaderLocation(fill_shader, "size");
+	fill_loc_mode = GetShaderLocation(fill_shader, "mode");
+	fill_loc_direction = GetShaderLocation(fill_shader, "direction");
+	fill_loc_from = GetShaderLocation(fill_shader, "colorFrom");
+	fill_loc_to = GetShaderLocation(fill_shader, "colorTo");
+	fill_loc_radius = GetShaderLocation(fill_shader, "radius");
+	fill_loc_border = GetShaderLocation(fill_shader, "border");
+	fill_loc_border_color = GetShaderLocation(fill_shader, "borderColor");
+	LOG_DEBUG("Compiled fill shader %u", fill_shader.id);
+}
+
+void fill_close() {
+	if( fill_shader_loaded ) {
+		UnloadShader(fill_shader);
+		fill_shader_loaded = false;
+	}
+}
+
+static void fill_set_color(int location, Color color) {
+	float value[4] = { color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f };
+	SetShaderValue(fill_shader, location, value, UNIFORM_VEC4);
+}
+
+static inline Color fill_fade(Color color, float opacity) {
+	color.a = (unsigned char)(color.a * opacity);
+	return color;
+}
+
+/*******************************************************************************
+ * Draws a fill as a single quad. Solid fills and horizontal or vertical
+ * gradients without corners and border stay in the current batch, the others
+ * are drawn by the fill shader in a batch of their own.
+ * @param *f the fill
+ * @param rect area to fill
+ * @param opacity of the element, 0 to 1
+ ******************************************************************************/
+void fill_draw(const fill *f, Rectangle rect, float opacity) {
+	PROFILE_FUNC();
+	bool shaped = f->radius > 0 || f->border_width > 0;
+	if( !shaped && f->type == FILL_SOLID ) {
+		DrawRectangleRec(rect, fill_fade(f->from, opacity));
+		return;
+	}
+	if( !shaped && f->type == FILL_LINEAR && ( f->angle == 0 || f->angle == 90 ) ) {
+		if( f->angle == 0 ) {
+			DrawRectangleGradientH(rect.x, rect.y, rect.width, rect.height, fill_fade(f->from, opacity), fill_fade(f->to, opacity));
+		}
+		else {
+			DrawRectangleGradientV(rect.x, rect.y, rect.width, rect.height, fill_fade(f->from, opacity), fill_fade(f->to, opacity));
+		}
+		return;
+	}
+	if( !fill_shader_loaded ) {
+		DrawRectangleRec(rect, fill_fade(f->from, opacity));
+		return;
+	}
+
+	float size[2] = { rect.width, rect.height };
+	float mode = f->type;
+	float direction[2] = { cosf(f->angle * DEG2RAD), sinf(f->angle * DEG2RAD) };
+	float radius = fminf(f->radius, fminf(rect.width, rect.height) / 2.0f);
+	float border = f->border_width;
+	// switching the shader draws the batch before, the uniforms apply to this quad only
+	BeginShaderMode(fill_shader);
+		SetShaderValue(fill_shader, fill_loc_size, size, UNIFORM_VEC2);
+		SetShaderValue(fill_shader, fill_loc_mode, &mode, UNIFORM_FLOAT);
+		SetShaderValue(fill_shader, fill_loc_direction, direction, UNIFORM_VEC2);
+		fill_set_color(fill_loc_from, f->from);
+		fill_set_color(fill_loc_to, ( f->type == FILL_SOLID )?f->from:f->to);
+		SetShaderValue(fill_shader, fill_loc_radius, &radius, UNIFORM_FLOAT);
+		SetShaderValue(fill_shader, fill_loc_border, &border, UNIFORM_FLOAT);
+		fill_set_color(fill_loc_border_color, f->border_color);
+		rlEnableTexture(GetTextureDefault().id);
+		rlBegin(RL_QUADS);
+			rlColor4ub(255, 255, 255, (unsigned char)(255 * opacity));
+			rlNormal3f(0.0f, 0.0f, 1.0f);
+			rlTexCoord2f(0.0f, 0.0f);
+			rlVertex2f(rect.x, rect.y);
+			rlTexCoord2f(0.0f, 1.0f);
+			rlVertex2f(rect.x, rect.y + rect.height);
+			rlTexCoord2f(1.0f, 1.0f);
+			rlVertex2f(rect.x + rect.width, rect.y + rect.height);
+			rlTexCoord2f(1.0f, 0.0f);
+			rlVertex2f(rect.x + rect.width, rect.y);
+		rlEnd();
+		rlDisableTexture();
+	EndShaderMode();
+}
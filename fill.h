@@ -0,0 +1,39 @@
+#ifndef __FILL_H__
+#define __FILL_H__
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <raylib.h>
+#include <rlgl.h>
+
+#include "log.h"
+#include "helpers.h"
+#include "profile.h"
+
+
+typedef enum {
+	FILL_SOLID,
+	FILL_LINEAR,  // from one edge to the opposite one, in the direction of the angle
+	FILL_RADIAL,  // from the center to the edges
+} fill_type;
+
+typedef struct fill {
+	fill_type type;
+	Color from;           // solid fills only use this one
+	Color to;
+	float angle;          // degrees of linear gradients, 0 runs left to right, 90 top to bottom
+	float radius;         // pixels, radius of rounded corners
+	float border_width;   // pixels, 0 for none
+	Color border_color;
+} fill;
+
+
+void fill_init();
+void fill_close();
+void fill_draw(const fill *f, Rectangle rect, float opacity);
+
+
+#endif
@@ -0,0 +1,1081 @@
+#include "glyph.h"
+
+static const char *TOPIC = "glyph";
+
+
+static glyph_font **glyph_fonts;  // fonts are allocated one by one to keep them at a fixed address
+static uint_fast32_t glyph_fonts_count;
+static pthread_mutex_t glyph_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t glyph_cache_mutex = PTHREAD_MUTEX_INITIALIZER;  // serializes writing cache files, the screen thread never waits for it
+static glyph_font **glyph_retired;  // removed fonts waiting for their cache files to be written
+static uint_fast32_t glyph_retired_count;
+static bool glyph_retired_writing;  // a thread is writing the cache files of removed fonts
+static uint_fast64_t glyph_rasterized;
+static uint_fast64_t glyph_evictions;
+static uint_fast64_t glyph_cache_hits;
+static bool glyph_over_pages_logged;
+
+
+/*******************************************************************************
+ * Decodes the next UTF-8 sequence, invalid bytes are returned as U+FFFD one by
+ * one so broken text is still drawn
+ * @param **text advanced behind the sequence
+ * @return the codepoint, 0 at the end of the string
+ ******************************************************************************/
+int glyph_next_codepoint(const char **text) {
+	const unsigned char *s = (const unsigned char *)*text;
+	if( s[0] == 0 ) {
+		return 0;
+	}
+	int length, codepoint;
+	if( s[0] < 0x80 ) { length = 1; codepoint = s[0]; }
+	else if( ( s[0] & 0xe0 ) == 0xc0 ) { length = 2; codepoint = s[0] & 0x1f; }
+	else if( ( s[0] & 0xf0 ) == 0xe0 ) { length = 3; codepoint = s[0] & 0x0f; }
+	else if( ( s[0] & 0xf8 ) == 0xf0 ) { length = 4; codepoint = s[0] & 0x07; }
+	else {
+		(*text)++;
+		return 0xfffd;
+	}
+	for( int i = 1; i < length; i++ ) {
+		if( ( s[i] & 0xc0 ) != 0x80 ) {
+			// also stops at the terminating zero
+			(*text)++;
+			return 0xfffd;
+		}
+		codepoint = ( codepoint << 6 ) | ( s[i] & 0x3f );
+	}
+	static const int min_codepoint[] = { 0, 0, 0x80, 0x800, 0x10000 };
+	if( codepoint < min_codepoint[length] || codepoint > 0x10ffff || ( codepoint >= 0xd800 && codepoint <= 0xdfff ) ) {
+		(*text)++;
+		return 0xfffd;
+	}
+	*text += length;
+	return codepoint;
+}
+
+static inline uint_fast32_t glyph_hash(int codepoint, uint_fast32_t table_size) {
+	return ( (uint32_t)codepoint * 2654435761u ) & ( table_size - 1 );
+}
+
+static void glyph_table_insert(glyph_font *font, uint_fast32_t index) {
+	uint_fast32_t slot = glyph_hash(font->glyphs[index].codepoint, font->table_size);
+	while( font->table[slot] != UINT_FAST32_MAX ) {
+		slot = ( slot + 1 ) & ( font->table_size - 1 );
+	}
+	font->table[slot] = index;
+}
+
+static void glyph_rebuild_table(glyph_font *font, uint_fast32_t table_size) {
+	font->table_size = table_size;
+	REALLOC(new_table, font->table, sizeof(uint_fast32_t) * table_size);
+	for( uint_fast32_t i = 0; i < table_size; i++ ) {
+		font->table[i] = UINT_FAST32_MAX;
+	}
+	for( uint_fast32_t i = 0; i < font->glyphs_count; i++ ) {
+		glyph_table_insert(font, i);
+	}
+}
+
+/*******************************************************************************
+ * @return the index of the glyph, UINT_FAST32_MAX if it isn't cached
+ ******************************************************************************/
+static uint_fast32_t glyph_find(glyph_font *font, int codepoint) {
+	uint_fast32_t slot = glyph_hash(codepoint, font->table_size);
+	while( font->table[slot] != UINT_FAST32_MAX ) {
+		if( font->glyphs[font->table[slot]].codepoint == codepoint ) {
+			return font->table[slot];
+		}
+		slot = ( slot + 1 ) & ( font->table_size - 1 );
+	}
+	return UINT_FAST32_MAX;
+}
+
+/*******************************************************************************
+ * Finds room on the shelves of a page, shelves which are much higher than the
+ * glyph are skipped to keep the waste low
+ * @return true if the glyph was placed at x, y
+ ******************************************************************************/
+static bool glyph_pack(glyph_font *font, glyph_page *page, uint_fast16_t width, uint_fast16_t height, uint_fast16_t *x, uint_fast16_t *y) {
+	atlas_shelf *best = NULL;
+	for( uint_fast16_t i = 0; i < page->shelves_count; i++ ) {
+		atlas_shelf *shelf = &page->shelves[i];
+		if( shelf->height >= height && shelf->height <= height + height / 2 && font->page_size - shelf->used >= width &&
+				( best == NULL || shelf->height < best->height ) ) {
+			best = shelf;
+		}
+	}
+	if( best == NULL ) {
+		if( page->top + height > font->page_size ) {
+			return false;
+		}
+		page->shelves_count++;
+		REALLOC(new_shelves, page->shelves, sizeof(atlas_shelf) * page->shelves_count);
+		best = &page->shelves[page->shelves_count-1];
+		best->y = page->top;
+		best->height = height;
+		best->used = 0;
+		page->top += height;
+	}
+	*x = best->used;
+	*y = best->y;
+	best->used += width;
+	return true;
+}
+
+/*******************************************************************************
+ * Sets a page to white and fully transparent, so filtering at the glyph edges
+ * doesn't blend in a dark color
+ ******************************************************************************/
+static void glyph_clear_page(glyph_font *font, glyph_page *page) {
+	Image *image = vram_get_image(page->texture_id);
+	uint8_t *pixels = (uint8_t *)image->data;
+	for( size_t i = 0; i < (size_t)font->page_size * font->page_size; i++ ) {
+		pixels[i*2] = 0xff;
+		pixels[i*2+1] = 0;
+	}
+	page->shelves_count = 0;
+	page->top = 0;
+}
+
+static uint_fast16_t glyph_add_page(glyph_font *font) {
+	font->pages_count++;
+	REALLOC(new_pages, font->pages, sizeof(glyph_page) * font->pages_count);
+	glyph_page *page = &font->pages[font->pages_count-1];
+	memset(page, 0, sizeof(glyph_page));
+	Image image = { NULL, font->page_size, font->page_size, 1, UNCOMPRESSED_GRAY_ALPHA };
+	MALLOC(image.data, (size_t)font->page_size * font->page_size * 2);
+	page->texture_id = vram_add_image(image, NULL);
+	glyph_clear_page(font, page);
+	LOG_DEBUG("Added page %lu of %lux%lu pixels to font »%s:%lu«", font->pages_count-1, font->page_size, font->page_size, font->name, font->size);
+	return font->pages_count-1;
+}
+
+/*******************************************************************************
+ * Drops all glyphs of the least recently drawn page to reuse it. Pages drawn in
+ * the current frame are kept, the pending render batch may still use them.
+ * @return the emptied page, GLYPH_NO_PAGE if all pages are in use
+ ******************************************************************************/
+static uint_fast16_t glyph_evict_page(glyph_font *font) {
+	uint_fast32_t frame = vram_get_frame();
+	uint_fast16_t lru = GLYPH_NO_PAGE;
+	for( uint_fast16_t p = 0; p < font->pages_count; p++ ) {
+		if( font->pages[p].last_used < frame && ( lru == GLYPH_NO_PAGE || font->pages[p].last_used < font->pages[lru].last_used ) ) {
+			lru = p;
+		}
+	}
+	if( lru == GLYPH_NO_PAGE ) {
+		return GLYPH_NO_PAGE;
+	}
+	uint_fast32_t kept = 0;
+	for( uint_fast32_t i = 0; i < font->glyphs_count; i++ ) {
+		if( font->glyphs[i].page != lru ) {
+			font->glyphs[kept++] = font->glyphs[i];
+		}
+	}
+	LOG_DEBUG("Evicted page %lu with %lu glyphs of font »%s:%lu«", lru, font->glyphs_count - kept, font->name, font->size);
+	font->glyphs_count = kept;
+	glyph_rebuild_table(font, font->table_size);
+	glyph_clear_page(font, &font->pages[lru]);
+	vram_update(font->pages[lru].texture_id);
+	font->generation++;
+	glyph_evictions++;
+	return lru;
+}
+
+/*******************************************************************************
+ * Copies the coverage of a rasterized glyph into a page
+ ******************************************************************************/
+static void glyph_place(glyph_font *font, glyph *g, const CharInfo *info) {
+	g->page = GLYPH_NO_PAGE;
+	if( info->data == NULL || info->rec.width <= 0 || info->rec.height <= 0 ) {
+		return;
+	}
+	uint_fast16_t width = (uint_fast16_t)info->rec.width + 2 * GLYPH_PADDING;
+	uint_fast16_t height = (uint_fast16_t)info->rec.height + 2 * GLYPH_PADDING;
+	if( width > font->page_size || height > font->page_size ) {
+		LOG_WARNING("Glyph U+%04X of font »%s:%lu« doesn't fit into a page", g->codepoint, font->name, font->size);
+		return;
+	}
+	uint_fast16_t x, y, p;
+	for( p = 0; p < font->pages_count; p++ ) {
+		if( glyph_pack(font, &font->pages[p], width, height, &x, &y) ) {
+			break;
+		}
+	}
+	if( p == font->pages_count ) {
+		p = ( font->pages_count < GLYPH_MAX_PAGES )?GLYPH_NO_PAGE:glyph_evict_page(font);
+		if( p == GLYPH_NO_PAGE ) {
+			if( font->pages_count >= GLYPH_MAX_PAGES && !glyph_over_pages_logged ) {
+				LOG_WARNING("Glyphs of a single frame need more than %d pages, font »%s:%lu«", GLYPH_MAX_PAGES, font->name, font->size);
+				glyph_over_pages_logged = true;
+			}
+			p = glyph_add_page(font);
+		}
+		glyph_pack(font, &font->pages[p], width, height, &x, &y);
+	}
+
+	glyph_page *page = &font->pages[p];
+	uint8_t *pixels = (uint8_t *)vram_get_image(page->texture_id)->data;
+	int glyph_width = (int)info->rec.width;
+	for( int row = 0; row < (int)info->rec.height; row++ ) {
+		uint8_t *line = pixels + ( (size_t)(y + GLYPH_PADDING + row) * font->page_size + x + GLYPH_PADDING ) * 2;
+		for( int column = 0; column < glyph_width; column++ ) {
+			line[column*2+1] = info->data[row * glyph_width + column];
+		}
+	}
+	vram_update(page->texture_id);
+	page->last_used = vram_get_frame();
+	g->page = p;
+	g->rec = (Rectangle){ x + GLYPH_PADDING, y + GLYPH_PADDING, info->rec.width, info->rec.height };
+}
+
+/*******************************************************************************
+ * FNV-1a of a whole file
+ * @return the hash, 0 if the file can't be read
+ ******************************************************************************/
+static uint64_t glyph_hash_file(const char *file) {
+	int fd = open(file, O_RDONLY);
+	if( fd < 0 ) {
+		return 0;
+	}
+	struct stat st;
+	uint64_t hash = 0;
+	if( fstat(fd, &st) == 0 && st.st_size > 0 ) {
+		const uint8_t *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if( data != MAP_FAILED ) {
+			hash = 14695981039346656037ull;
+			for( off_t i = 0; i < st.st_size; i++ ) {
+				hash = ( hash ^ data[i] ) * 1099511628211ull;
+			}
+			munmap((void *)data, st.st_size);
+		}
+	}
+	close(fd);
+	return hash;
+}
+
+static char *glyph_cache_file(glyph_font *font, const char *suffix) {
+	char *file;
+	MALLOC(file, strlen(config.glyph_cache_path) + 64);
+	sprintf(file, "%s/%016llx-%lu.glyphs%s", config.glyph_cache_path, (unsigned long long)font->hash, (unsigned long)font->size, suffix);
+	return file;
+}
+
+/*******************************************************************************
+ * Maps the cache file of a font, if it has one which matches its contents and
+ * size. Only reads fields which don't change after the hash is known.
+ * @param *size is set to the size of the mapping
+ * @param *count is set to the number of glyphs
+ * @return the mapping, NULL if there's no valid cache file
+ ******************************************************************************/
+static void *glyph_cache_map(glyph_font *font, size_t *size, uint_fast32_t *count) {
+	char *file = glyph_cache_file(font, "");
+	int fd = open(file, O_RDONLY);
+	if( fd < 0 ) {
+		LOG_VERBOSE("No glyph cache »%s« for font »%s:%lu« yet", file, font->name, font->size);
+		free(file);
+		return NULL;
+	}
+	struct stat st;
+	void *cache = MAP_FAILED;
+	if( fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(glyph_cache_header) ) {
+		cache = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if( cache == MAP_FAILED ) {
+		LOG_WARNING("Failed to map glyph cache »%s«, ignoring it", file);
+		free(file);
+		return NULL;
+	}
+
+	const glyph_cache_header *header = cache;
+	const glyph_cache_entry *entries = (const glyph_cache_entry *)( header + 1 );
+	*size = st.st_size;
+	bool valid = memcmp(header->magic, "GLYC", 4) == 0 && header->version == GLYPH_CACHE_VERSION &&
+		header->font_hash == font->hash && header->size == font->size &&
+		header->count <= ( *size - sizeof(glyph_cache_header) ) / sizeof(glyph_cache_entry);
+	for( uint_fast32_t i = 0; valid && i < header->count; i++ ) {
+		valid = entries[i].data <= *size && (size_t)entries[i].width * entries[i].height <= *size - entries[i].data &&
+			( i == 0 || entries[i-1].codepoint < entries[i].codepoint );
+	}
+	if( !valid ) {
+		LOG_WARNING("Ignoring invalid glyph cache »%s«, it's written again", file);
+		munmap(cache, *size);
+		free(file);
+		return NULL;
+	}
+	*count = header->count;
+	LOG_DEBUG("Mapped glyph cache »%s« with %lu glyphs of font »%s:%lu«", file, *count, font->name, font->size);
+	free(file);
+	return cache;
+}
+
+/*******************************************************************************
+ * Hashes the font file and maps its cache file, needs the font mutex
+ ******************************************************************************/
+static void glyph_cache_open(glyph_font *font) {
+	PROFILE_FUNC();
+	font->cache_opened = true;
+	font->hash = glyph_hash_file(font->name);
+	if( font->hash != 0 ) {
+		font->cache = glyph_cache_map(font, &font->cache_size, &font->cache_count);
+	}
+}
+
+/*******************************************************************************
+ * @return the index of the first entry with at least the codepoint
+ ******************************************************************************/
+static uint_fast32_t glyph_cache_bound(const glyph_cache_entry *entries, uint_fast32_t count, int codepoint) {
+	uint_fast32_t low = 0, high = count;
+	while( low < high ) {
+		uint_fast32_t middle = low + ( high - low ) / 2;
+		if( entries[middle].codepoint < codepoint ) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+/*******************************************************************************
+ * Looks up a glyph rasterized by this or an earlier run, needs the font mutex
+ * @param *info is set to the glyph, its data points into the cache
+ * @return false if the glyph isn't cached
+ ******************************************************************************/
+static bool glyph_cache_find(glyph_font *font, int codepoint, CharInfo *info) {
+	const glyph_cache_entry *entry = NULL;
+	const uint8_t *data = NULL;
+	if( font->cache != NULL ) {
+		const glyph_cache_entry *entries = (const glyph_cache_entry *)( (const glyph_cache_header *)font->cache + 1 );
+		uint_fast32_t i = glyph_cache_bound(entries, font->cache_count, codepoint);
+		if( i < font->cache_count && entries[i].codepoint == codepoint ) {
+			entry = &entries[i];
+			data = (const uint8_t *)font->cache;
+		}
+	}
+	if( entry == NULL ) {
+		uint_fast32_t i = glyph_cache_bound(font->added, font->added_count, codepoint);
+		if( i < font->added_count && font->added[i].codepoint == codepoint ) {
+			entry = &font->added[i];
+			data = font->added_data;
+		}
+	}
+	if( entry == NULL ) {
+		return false;
+	}
+	*info = (CharInfo){ .value = codepoint, .rec = { 0, 0, entry->width, entry->height },
+		.offsetX = entry->offset_x, .offsetY = entry->offset_y, .advanceX = entry->advance_x,
+		.data = ( entry->width > 0 && entry->height > 0 )?(unsigned char *)data + entry->data:NULL };
+	return true;
+}
+
+/*******************************************************************************
+ * Keeps a rasterized glyph, so it's written into the cache file. Needs the
+ * font mutex.
+ ******************************************************************************/
+static void glyph_cache_add(glyph_font *font, int codepoint, const CharInfo *info) {
+	glyph_cache_entry entry = { .codepoint = codepoint, .offset_x = info->offsetX, .offset_y = info->offsetY, .advance_x = info->advanceX };
+	if( info->data != NULL && info->rec.width > 0 && info->rec.height > 0 ) {
+		entry.width = (uint16_t)info->rec.width;
+		entry.height = (uint16_t)info->rec.height;
+		entry.data = font->added_size;
+		size_t bytes = (size_t)entry.width * entry.height;
+		font->added_size += bytes;
+		REALLOC(new_added_data, font->added_data, font->added_size);
+		memcpy(font->added_data + entry.data, info->data, bytes);
+	}
+	uint_fast32_t i = glyph_cache_bound(font->added, font->added_count, codepoint);
+	font->added_count++;
+	REALLOC(new_added, font->added, sizeof(glyph_cache_entry) * font->added_count);
+	memmove(&font->added[i+1], &font->added[i], sizeof(glyph_cache_entry) * ( font->added_count - 1 - i ));
+	font->added[i] = entry;
+}
+
+static bool glyph_cache_mkdir(const char *path) {
+	char *dir = strdup(path);
+	FAIL_ON_NULL(dir, "Failed to copy glyph cache path »%s«", path);
+	bool ok = true;
+	// creates the parents first, the root of absolute paths is skipped
+	for( char *slash = dir; ok; slash++ ) {
+		char c = *slash;
+		if( ( c == '/' || c == '\0' ) && slash > dir ) {
+			*slash = '\0';
+			ok = mkdir(dir, 0755) == 0 || errno == EEXIST;
+			*slash = c;
+		}
+		if( c == '\0' ) {
+			break;
+		}
+	}
+	free(dir);
+	return ok;
+}
+
+static void glyph_cache_close(glyph_font *font) {
+	if( font->cache != NULL ) {
+		munmap(font->cache, font->cache_size);
+	}
+	free(font->added);
+	free(font->added_data);
+}
+
+/*******************************************************************************
+ * Replaces the mapping of a font with the file just written. Added glyphs
+ * which are in it are dropped, glyphs added while it was written are kept.
+ ******************************************************************************/
+static void glyph_cache_remap(glyph_font *font) {
+	size_t size = 0;
+	uint_fast32_t count = 0;
+	void *cache = glyph_cache_map(font, &size, &count);
+	if( cache == NULL ) {
+		return;
+	}
+	const glyph_cache_entry *entries = (const glyph_cache_entry *)( (const glyph_cache_header *)cache + 1 );
+
+	pthread_mutex_lock(&font->mutex);
+	void *old_cache = font->cache;
+	size_t old_size = font->cache_size;
+	font->cache = cache;
+	font->cache_size = size;
+	font->cache_count = count;
+	uint8_t *data = NULL;
+	size_t data_size = 0;
+	uint_fast32_t kept = 0;
+	for( uint_fast32_t i = 0; i < font->added_count; i++ ) {
+		glyph_cache_entry entry = font->added[i];
+		uint_fast32_t found = glyph_cache_bound(entries, count, entry.codepoint);
+		if( found < count && entries[found].codepoint == entry.codepoint ) {
+			continue;
+		}
+		size_t bytes = (size_t)entry.width * entry.height;
+		if( bytes > 0 ) {
+			REALLOC(new_data, data, data_size + bytes);
+			memcpy(data + data_size, font->added_data + entry.data, bytes);
+			entry.data = data_size;
+			data_size += bytes;
+		}
+		font->added[kept++] = entry;
+	}
+	free(font->added_data);
+	font->added_data = data;
+	font->added_size = data_size;
+	font->added_count = kept;
+	pthread_mutex_unlock(&font->mutex);
+
+	// only this thread writes cache files, nobody else could still use the old mapping
+	if( old_cache != NULL ) {
+		munmap(old_cache, old_size);
+	}
+}
+
+/*******************************************************************************
+ * Writes the mapped and the added glyphs of a font into a new cache file,
+ * which replaces the old one. The added glyphs are copied with the font mutex
+ * locked, the file is written without it, so drawing never waits for the disk.
+ * Needs glyph_cache_mutex, which keeps the mapping from changing meanwhile.
+ ******************************************************************************/
+static void glyph_cache_write(glyph_font *font) {
+	PROFILE_FUNC();
+	pthread_mutex_lock(&font->mutex);
+	uint_fast32_t added_count = font->added_count;
+	glyph_cache_entry *added = NULL;
+	uint8_t *added_data = NULL;
+	if( added_count > 0 && font->hash != 0 ) {
+		MALLOC(added, sizeof(glyph_cache_entry) * added_count);
+		memcpy(added, font->added, sizeof(glyph_cache_entry) * added_count);
+		MALLOC(added_data, font->added_size + 1);
+		memcpy(added_data, font->added_data, font->added_size);
+	}
+	const uint8_t *cache = font->cache;
+	uint_fast32_t cache_count = font->cache_count;
+	pthread_mutex_unlock(&font->mutex);
+	if( added == NULL ) {
+		return;
+	}
+	if( !glyph_cache_mkdir(config.glyph_cache_path) ) {
+		LOG_ERROR("Failed to create glyph cache directory »%s«: %s", config.glyph_cache_path, strerror(errno));
+		free(added);
+		free(added_data);
+		return;
+	}
+	const glyph_cache_entry *cached = ( cache != NULL )?(const glyph_cache_entry *)( (const glyph_cache_header *)cache + 1 ):NULL;
+	glyph_cache_header header = { .magic = { 'G', 'L', 'Y', 'C' }, .version = GLYPH_CACHE_VERSION,
+		.font_hash = font->hash, .size = font->size, .count = cache_count + added_count };
+	glyph_cache_entry *entries;
+	MALLOC(entries, sizeof(glyph_cache_entry) * header.count);
+	const uint8_t **sources;
+	MALLOC(sources, sizeof(uint8_t *) * header.count);
+
+	// merge both sorted lists, the coverage follows the entries in the same order
+	uint32_t data = sizeof(glyph_cache_header) + sizeof(glyph_cache_entry) * header.count;
+	uint_fast32_t c = 0, a = 0;
+	for( uint_fast32_t i = 0; i < header.count; i++ ) {
+		if( a == added_count || ( c < cache_count && cached[c].codepoint < added[a].codepoint ) ) {
+			entries[i] = cached[c++];
+			sources[i] = cache + entries[i].data;
+		}
+		else {
+			entries[i] = added[a++];
+			sources[i] = added_data + entries[i].data;
+		}
+		entries[i].data = data;
+		data += (uint32_t)entries[i].width * entries[i].height;
+	}
+
+	char *temp = glyph_cache_file(font, ".tmp");
+	FILE *file = fopen(temp, "wb");
+	bool ok = file != NULL && fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(entries, sizeof(glyph_cache_entry), header.count, file) == header.count;
+	for( uint_fast32_t i = 0; ok && i < header.count; i++ ) {
+		size_t bytes = (size_t)entries[i].width * entries[i].height;
+		ok = fwrite(sources[i], 1, bytes, file) == bytes;
+	}
+	ok = ( file != NULL && fclose(file) == 0 ) && ok;
+	char *final = glyph_cache_file(font, "");
+	if( ok && rename(temp, final) == 0 ) {
+		LOG_DEBUG("Wrote %lu glyphs of font »%s:%lu« into »%s«", (unsigned long)header.count, font->name, font->size, final);
+		glyph_cache_remap(font);
+	}
+	else {
+		LOG_ERROR("Failed to write glyph cache »%s«: %s", final, strerror(errno));
+		unlink(temp);
+	}
+	free(final);
+	free(temp);
+	free(sources);
+	free(entries);
+	free(added);
+	free(added_data);
+}
+
+/*******************************************************************************
+ * Adds a rasterized glyph to the font, needs the font mutex
+ ******************************************************************************/
+static void glyph_add(glyph_font *font, int codepoint, const CharInfo *info) {
+	glyph g = { .codepoint = codepoint, .offset_x = info->offsetX, .offset_y = info->offsetY };
+	g.advance_x = ( info->advanceX != 0 )?info->advanceX:(int)info->rec.width;
+	// placed before it's added, placing could evict a page and compact the glyphs
+	glyph_place(font, &g, info);
+	font->glyphs_count++;
+	REALLOC(new_glyphs, font->glyphs, sizeof(glyph) * font->glyphs_count);
+	font->glyphs[font->glyphs_count-1] = g;
+	if( font->glyphs_count * 2 > font->table_size ) {
+		glyph_rebuild_table(font, font->table_size * 2);
+	}
+	else {
+		glyph_table_insert(font, font->glyphs_count-1);
+	}
+}
+
+/*******************************************************************************
+ * Rasterizes codepoints which aren't cached yet, has to be called with the
+ * mutex of the font locked. Glyphs of the cache file are copied instead, so
+ * the font file is only read if one is missing.
+ * @param count at most GLYPH_BATCH
+ ******************************************************************************/
+static void glyph_rasterize(glyph_font *font, int *codepoints, int count) {
+	PROFILE_FUNC();
+	int missing[GLYPH_BATCH];
+	int missing_count = 0;
+	if( config.glyph_cache_path != NULL && !font->cache_opened ) {
+		glyph_cache_open(font);
+	}
+	for( int i = 0; i < count; i++ ) {
+		CharInfo info;
+		if( font->hash != 0 && glyph_cache_find(font, codepoints[i], &info) ) {
+			glyph_add(font, codepoints[i], &info);
+			glyph_cache_hits++;
+		}
+		else {
+			missing[missing_count++] = codepoints[i];
+		}
+	}
+	if( missing_count == 0 ) {
+		return;
+	}
+
+	CharInfo *chars = LoadFontData(font->name, font->size, missing, missing_count, FONT_DEFAULT);
+	if( chars == NULL ) {
+		LOG_ERROR("Failed to load font »%s:%lu« using default font", font->name, font->size);
+		font->failed = true;
+		return;
+	}
+	for( int i = 0; i < missing_count; i++ ) {
+		glyph_add(font, missing[i], &chars[i]);
+		if( font->hash != 0 ) {
+			glyph_cache_add(font, missing[i], &chars[i]);
+		}
+		free(chars[i].data);
+	}
+	free(chars);
+	glyph_rasterized += missing_count;
+}
+
+/*******************************************************************************
+ * Rasterizes all glyphs of a text which aren't cached yet, in batches so the
+ * font file is only read once for most texts. Needs the font mutex.
+ ******************************************************************************/
+static void glyph_ensure(glyph_font *font, const char *text) {
+	int batch[GLYPH_BATCH];
+	int count = 0;
+	int codepoint;
+	while( !font->failed && ( codepoint = glyph_next_codepoint(&text) ) != 0 ) {
+		if( codepoint == '\n' || glyph_find(font, codepoint) != UINT_FAST32_MAX ) {
+			continue;
+		}
+		bool queued = false;
+		for( int i = 0; i < count && !queued; i++ ) {
+			queued = batch[i] == codepoint;
+		}
+		if( queued ) {
+			continue;
+		}
+		batch[count++] = codepoint;
+		if( count == GLYPH_BATCH ) {
+			glyph_rasterize(font, batch, count);
+			count = 0;
+		}
+	}
+	if( count > 0 && !font->failed ) {
+		glyph_rasterize(font, batch, count);
+	}
+}
+
+static glyph_font *glyph_get_font(uint_fast32_t handle) {
+	pthread_mutex_lock(&glyph_mutex);
+	if( handle >= glyph_fonts_count || glyph_fonts[handle]->name == NULL ) {
+		LOG_FATAL("Requested unknown font handle %lu", handle);
+	}
+	glyph_font *font = glyph_fonts[handle];
+	pthread_mutex_unlock(&glyph_mutex);
+	return font;
+}
+
+/*******************************************************************************
+ * Registers a font, fonts with the same name and size share one glyph cache.
+ * Nothing is rasterized until glyphs are requested.
+ * @param *name Name of the font file
+ * @param size pixel size the glyphs are rasterized at
+ * @return the handle of the font
+ ******************************************************************************/
+uint_fast32_t glyph_add_font(const char *name, uint_fast16_t size) {
+	pthread_mutex_lock(&glyph_mutex);
+	uint_fast32_t handle = glyph_fonts_count;
+	for( uint_fast32_t i = 0; i < glyph_fonts_count; i++ ) {
+		if( glyph_fonts[i]->name == NULL ) {
+			handle = ( handle == glyph_fonts_count )?i:handle;
+		}
+		else if( glyph_fonts[i]->size == size && strcmp(name, glyph_fonts[i]->name) == 0 ) {
+			glyph_fonts[i]->ref_count++;
+			LOG_VERBOSE("Font »%s:%lu« already registered", name, size);
+			pthread_mutex_unlock(&glyph_mutex);
+			return i;
+		}
+	}
+	if( handle == glyph_fonts_count ) {
+		glyph_fonts_count++;
+		REALLOC(new_glyph_fonts, glyph_fonts, sizeof(glyph_font *) * glyph_fonts_count);
+		MALLOC(glyph_fonts[handle], sizeof(glyph_font));
+	}
+	glyph_font *font = glyph_fonts[handle];
+	memset(font, 0, sizeof(glyph_font));
+	font->name = strdup(name);
+	FAIL_ON_NULL(font->name, "Failed to copy font name »%s« while registering font", name);
+	font->size = size;
+	font->ref_count = 1;
+	pthread_mutex_init(&font->mutex, NULL);
+	// a page holds a few dozen glyphs, huge fonts get pages which fit at least one
+	font->page_size = GLYPH_PAGE_MIN;
+	while( font->page_size < GLYPH_PAGE_MAX && font->page_size < size * 4 ) {
+		font->page_size *= 2;
+	}
+	while( font->page_size < size * 2 ) {
+		font->page_size *= 2;
+	}
+	glyph_rebuild_table(font, 64);
+	LOG_DEBUG("Registered font »%s:%lu« with handle %lu", name, size, handle);
+	pthread_mutex_unlock(&glyph_mutex);
+	return handle;
+}
+
+static void glyph_free_font(glyph_font *font) {
+	glyph_cache_close(font);
+	free(font->name);
+	pthread_mutex_destroy(&font->mutex);
+	free(font);
+}
+
+/*******************************************************************************
+ * Writes the cache files of removed fonts and frees them. Needs
+ * glyph_cache_mutex, the list must have been taken from glyph_retired.
+ ******************************************************************************/
+static void glyph_cache_write_retired(glyph_font **retired, uint_fast32_t count) {
+	for( uint_fast32_t i = 0; i < count; i++ ) {
+		glyph_cache_write(retired[i]);
+		glyph_free_font(retired[i]);
+	}
+	free(retired);
+}
+
+/*******************************************************************************
+ * Thread writing the cache files of removed fonts, it runs until no removed
+ * fonts are left, so fonts removed meanwhile don't need a thread of their own
+ ******************************************************************************/
+static void *glyph_retired_worker(void *_) {
+	PROFILE_THREAD_NAME("glyph cache");
+	while( true ) {
+		pthread_mutex_lock(&glyph_cache_mutex);
+		pthread_mutex_lock(&glyph_mutex);
+		glyph_font **retired = glyph_retired;
+		uint_fast32_t count = glyph_retired_count;
+		glyph_retired = NULL;
+		glyph_retired_count = 0;
+		glyph_retired_writing = count > 0;
+		pthread_mutex_unlock(&glyph_mutex);
+		glyph_cache_write_retired(retired, count);
+		pthread_mutex_unlock(&glyph_cache_mutex);
+		if( count == 0 ) {
+			return NULL;
+		}
+	}
+}
+
+/*******************************************************************************
+ * Drops a reference to a font and frees its glyphs and pages if it isn't used
+ * anymore. The font is taken out of its slot, its cache file is written by a
+ * thread of its own, so this never waits for the disk. Must be called from the
+ * screen thread.
+ ******************************************************************************/
+void glyph_remove_font(uint_fast32_t handle) {
+	pthread_mutex_lock(&glyph_mutex);
+	glyph_font *font = glyph_fonts[handle];
+	if( --font->ref_count > 0 ) {
+		pthread_mutex_unlock(&glyph_mutex);
+		return;
+	}
+	MALLOC(glyph_fonts[handle], sizeof(glyph_font));
+	memset(glyph_fonts[handle], 0, sizeof(glyph_font));
+	pthread_mutex_unlock(&glyph_mutex);
+
+	pthread_mutex_lock(&font->mutex);
+	for( uint_fast16_t p = 0; p < font->pages_count; p++ ) {
+		vram_remove(font->pages[p].texture_id);
+		free(font->pages[p].shelves);
+	}
+	free(font->pages);
+	free(font->glyphs);
+	free(font->table);
+	font->pages = NULL;
+	font->glyphs = NULL;
+	font->table = NULL;
+	pthread_mutex_unlock(&font->mutex);
+	if( config.glyph_cache_path == NULL ) {
+		glyph_free_font(font);
+		return;
+	}
+	// a save running meanwhile may still write the font, the writer waits for it
+	pthread_mutex_lock(&glyph_mutex);
+	glyph_retired_count++;
+	REALLOC(new_retired, glyph_retired, sizeof(glyph_font *) * glyph_retired_count);
+	glyph_retired[glyph_retired_count-1] = font;
+	bool start = !glyph_retired_writing;
+	glyph_retired_writing = true;
+	pthread_mutex_unlock(&glyph_mutex);
+	if( !start ) {
+		return;
+	}
+	pthread_t thread;
+	if( pthread_create(&thread, NULL, glyph_retired_worker, NULL) ) {
+		LOG_WARNING("Failed to start thread glyph_retired_worker, removed fonts are written by the next save");
+		pthread_mutex_lock(&glyph_mutex);
+		glyph_retired_writing = false;
+		pthread_mutex_unlock(&glyph_mutex);
+		return;
+	}
+	pthread_detach(thread);
+}
+
+/*******************************************************************************
+ * Rasterizes the glyphs of a text ahead of time, e.g. the static texts of a
+ * layout while it's loaded. Could be called from any thread.
+ ******************************************************************************/
+void glyph_prepare(uint_fast32_t handle, const char *text) {
+	PROFILE_FUNC();
+	glyph_font *font = glyph_get_font(handle);
+	pthread_mutex_lock(&font->mutex);
+	glyph_ensure(font, text);
+	pthread_mutex_unlock(&font->mutex);
+}
+
+/*******************************************************************************
+ * Uploads all pages of a font, must be called from the screen thread
+ ******************************************************************************/
+void glyph_upload(uint_fast32_t handle) {
+	glyph_font *font = glyph_get_font(handle);
+	pthread_mutex_lock(&font->mutex);
+	for( uint_fast16_t p = 0; p < font->pages_count; p++ ) {
+		vram_get_texture(font->pages[p].texture_id);
+	}
+	pthread_mutex_unlock(&font->mutex);
+}
+
+/*******************************************************************************
+ * Returns a cached glyph, it's rasterized again if it was evicted meanwhile.
+ * Needs the font mutex.
+ * @return the index of the glyph, UINT_FAST32_MAX if the font failed
+ ******************************************************************************/
+static uint_fast32_t glyph_get(glyph_font *font, int codepoint) {
+	uint_fast32_t index = glyph_find(font, codepoint);
+	if( index == UINT_FAST32_MAX && !font->failed ) {
+		glyph_rasterize(font, &codepoint, 1);
+		index = glyph_find(font, codepoint);
+	}
+	return index;
+}
+
+/*******************************************************************************
+ * Lays out a text into quads grouped by page, so drawing it doesn't have to
+ * decode or look up anything. Missing glyphs are rasterized.
+ * @param *run the run to rebuild, its old arrays are reused
+ * @param handle the font to use
+ * @param *text the UTF-8 text
+ * @return width of the widest line and height of all lines, like
+ * MeasureTextEx()
+ ******************************************************************************/
+Vector2 glyph_run_build(glyph_run *run, uint_fast32_t handle, const char *text) {
+	PROFILE_FUNC();
+	glyph_font *font = glyph_get_font(handle);
+	pthread_mutex_lock(&font->mutex);
+	run->font_id = handle;
+	run->quads_count = 0;
+	run->parts_count = 0;
+	glyph_ensure(font, text);
+	if( font->failed ) {
+		pthread_mutex_unlock(&font->mutex);
+		return MeasureTextEx(GetFontDefault(), text, (float)font->size, 0.0f);
+	}
+
+	uint_fast32_t frame = vram_get_frame();
+	Vector2 size = { 0, font->size };
+	Vector2 pen = { 0, 0 };
+	uint_fast32_t length = 0;
+	for( const char *c = text; glyph_next_codepoint(&c) != 0; ) {
+		length++;
+	}
+	REALLOC(new_quads, run->quads, sizeof(glyph_quad) * ( length + 1 ));
+	int codepoint;
+	while( ( codepoint = glyph_next_codepoint(&text) ) != 0 ) {
+		if( codepoint == '\n' ) {
+			pen.x = 0;
+			pen.y += font->size * 1.5f;
+			size.y += font->size * 1.5f;
+			continue;
+		}
+		uint_fast32_t index = glyph_get(font, codepoint);
+		if( index == UINT_FAST32_MAX ) {
+			continue;
+		}
+		glyph g = font->glyphs[index];
+		if( g.page != GLYPH_NO_PAGE ) {
+			// pages used by the run mustn't be evicted while it's being built
+			font->pages[g.page].last_used = frame;
+			glyph_quad *quad = &run->quads[run->quads_count++];
+			quad->page = g.page;
+			quad->x = pen.x + g.offset_x;
+			quad->y = pen.y + g.offset_y;
+			quad->width = g.rec.width;
+			quad->height = g.rec.height;
+			quad->u = g.rec.x / font->page_size;
+			quad->v = g.rec.y / font->page_size;
+			quad->u2 = ( g.rec.x + g.rec.width ) / font->page_size;
+			quad->v2 = ( g.rec.y + g.rec.height ) / font->page_size;
+		}
+		pen.x += g.advance_x;
+		if( pen.x > size.x ) {
+			size.x = pen.x;
+		}
+	}
+
+	// group the quads by page, most texts use a single one
+	for( uint_fast32_t i = 0; i < run->quads_count; i++ ) {
+		uint_fast16_t part = 0;
+		while( part < run->parts_count && run->parts[part].page != run->quads[i].page ) {
+			part++;
+		}
+		if( part == run->parts_count ) {
+			run->parts_count++;
+			REALLOC(new_parts, run->parts, sizeof(glyph_run_part) * run->parts_count);
+			run->parts[part] = (glyph_run_part){ run->quads[i].page, 0, 0 };
+		}
+		run->parts[part].count++;
+	}
+	if( run->parts_count > 1 ) {
+		glyph_quad *sorted;
+		MALLOC(sorted, sizeof(glyph_quad) * ( run->quads_count + 1 ));
+		uint_fast32_t first = 0;
+		for( uint_fast16_t part = 0; part < run->parts_count; part++ ) {
+			run->parts[part].first = first;
+			for( uint_fast32_t i = 0; i < run->quads_count; i++ ) {
+				if( run->quads[i].page == run->parts[part].page ) {
+					sorted[first++] = run->quads[i];
+				}
+			}
+		}
+		free(run->quads);
+		run->quads = sorted;
+	}
+	run->generation = font->generation;
+	run->built = true;
+	pthread_mutex_unlock(&font->mutex);
+	return size;
+}
+
+/*******************************************************************************
+ * Submits a run with one batch per page, it's rebuilt first if pages it uses
+ * were evicted meanwhile. Must be called from the screen thread.
+ * @param *run the run built by glyph_run_build()
+ * @param *text the text the run was built from, to rebuild it if required
+ * @param position top left corner of the text
+ * @param width glyphs reaching further are left out, 0 draws all of them
+ * @param color the color applied to all glyphs
+ ******************************************************************************/
+void glyph_run_draw(glyph_run *run, const char *text, Vector2 position, float width, Color color) {
+	PROFILE_FUNC();
+	glyph_font *font = glyph_get_font(run->font_id);
+	pthread_mutex_lock(&font->mutex);
+	if( font->failed ) {
+		pthread_mutex_unlock(&font->mutex);
+		glyph_draw_default(text, position, (float)font->size, 0.0f, width, color);
+		return;
+	}
+	if( !run->built || run->generation != font->generation ) {
+		pthread_mutex_unlock(&font->mutex);
+		glyph_run_build(run, run->font_id, text);
+		pthread_mutex_lock(&font->mutex);
+	}
+	uint_fast32_t frame = vram_get_frame();
+	for( uint_fast16_t part = 0; part < run->parts_count; part++ ) {
+		glyph_page *page = &font->pages[run->parts[part].page];
+		page->last_used = frame;
+		Texture2D *texture = vram_get_texture(page->texture_id);
+		const glyph_quad *quad = &run->quads[run->parts[part].first];
+		const glyph_quad *end = quad + run->parts[part].count;
+		if( rlCheckBufferLimit(run->parts[part].count * 4) ) {
+			rlglDraw();
+		}
+		rlEnableTexture(texture->id);
+		rlBegin(RL_QUADS);
+			rlColor4ub(color.r, color.g, color.b, color.a);
+			rlNormal3f(0.0f, 0.0f, 1.0f);
+			for( ; quad < end; quad++ ) {
+				if( width > 0 && quad->x + quad->width > width ) {
+					continue;
+				}
+				float x = position.x + quad->x, y = position.y + quad->y;
+				rlTexCoord2f(quad->u, quad->v);
+				rlVertex2f(x, y);
+				rlTexCoord2f(quad->u, quad->v2);
+				rlVertex2f(x, y + quad->height);
+				rlTexCoord2f(quad->u2, quad->v2);
+				rlVertex2f(x + quad->width, y + quad->height);
+				rlTexCoord2f(quad->u2, quad->v);
+				rlVertex2f(x + quad->width, y);
+			}
+		rlEnd();
+		rlDisableTexture();
+	}
+	pthread_mutex_unlock(&font->mutex);
+}
+
+/*******************************************************************************
+ * Draws text with raylib's default font, cut after the last character which
+ * fits into the width. Only for fallbacks, the text is measured again for each
+ * character removed.
+ * @param width the text is cut to, 0 draws all of it
+ ******************************************************************************/
+void glyph_draw_default(const char *text, Vector2 position, float size, float spacing, float width, Color color) {
+	Font font = GetFontDefault();
+	if( width <= 0 || MeasureTextEx(font, text, size, spacing).x <= width ) {
+		DrawTextEx(font, text, position, size, spacing, color);
+		return;
+	}
+	char cut[256];
+	size_t length = strlen(text);
+	length = ( length < sizeof(cut) - 1 )?length:sizeof(cut) - 1;
+	memcpy(cut, text, length);
+	cut[length] = '\0';
+	while( length > 0 && MeasureTextEx(font, cut, size, spacing).x > width ) {
+		// drop a whole UTF-8 sequence, its continuation bytes first
+		do {
+			length--;
+		} while( length > 0 && ( cut[length] & 0xC0 ) == 0x80 );
+		cut[length] = '\0';
+	}
+	if( length > 0 ) {
+		DrawTextEx(font, cut, position, size, spacing, color);
+	}
+}
+
+void glyph_run_free(glyph_run *run) {
+	free(run->quads);
+	free(run->parts);
+	memset(run, 0, sizeof(glyph_run));
+}
+
+/*******************************************************************************
+ * Writes the glyphs rasterized since the start into the cache files, so the
+ * next start doesn't have to rasterize them again. The font list is only
+ * locked to copy it, fonts aren't freed while the files are written as
+ * removed fonts are only freed while holding glyph_cache_mutex. Removed fonts
+ * the writer thread hasn't taken yet are written too. Shouldn't be called from
+ * the screen thread while it draws.
+ ******************************************************************************/
+void glyph_cache_save() {
+	PROFILE_FUNC();
+	if( config.glyph_cache_path == NULL ) {
+		return;
+	}
+	pthread_mutex_lock(&glyph_cache_mutex);
+	pthread_mutex_lock(&glyph_mutex);
+	glyph_font **fonts;
+	MALLOC(fonts, sizeof(glyph_font *) * ( glyph_fonts_count + 1 ));
+	uint_fast32_t count = 0;
+	for( uint_fast32_t i = 0; i < glyph_fonts_count; i++ ) {
+		if( glyph_fonts[i]->name != NULL ) {
+			fonts[count++] = glyph_fonts[i];
+		}
+	}
+	glyph_font **retired = glyph_retired;
+	uint_fast32_t retired_count = glyph_retired_count;
+	glyph_retired = NULL;
+	glyph_retired_count = 0;
+	pthread_mutex_unlock(&glyph_mutex);
+
+	for( uint_fast32_t i = 0; i < count; i++ ) {
+		glyph_cache_write(fonts[i]);
+	}
+	glyph_cache_write_retired(retired, retired_count);
+	pthread_mutex_unlock(&glyph_cache_mutex);
+	free(fonts);
+}
+
+void glyph_log_stats() {
+	uint_fast32_t fonts = 0, glyphs = 0, pages = 0;
+	size_t bytes = 0;
+	pthread_mutex_lock(&glyph_mutex);
+	for( uint_fast32_t i = 0; i < glyph_fonts_count; i++ ) {
+		glyph_font *font = glyph_fonts[i];
+		if( font->name == NULL ) {
+			continue;
+		}
+		fonts++;
+		glyphs += font->glyphs_count;
+		pages += font->pages_count;
+		bytes += (size_t)font->pages_count * font->page_size * font->page_size * 2;
+	}
+	pthread_mutex_unlock(&glyph_mutex);
+	LOG_INFO("Glyphs: %lu cached in %lu pages with %lu bytes for %lu fonts, %lu rasterized, %lu from the glyph cache, %lu page evictions",
+			glyphs, pages, bytes, fonts, glyph_rasterized, glyph_cache_hits, glyph_evictions);
+}
@@ -0,0 +1,153 @@
+#ifndef __GLYPH_H__
+#define __GLYPH_H__
+
+
+#ifndef GLYPH_PAGE_MIN
+#define GLYPH_PAGE_MIN 128
+#endif
+
+#ifndef GLYPH_PAGE_MAX
+#define GLYPH_PAGE_MAX 1024
+#endif
+
+#ifndef GLYPH_MAX_PAGES
+#define GLYPH_MAX_PAGES 4  // per font, the least recently drawn page is evicted if another one is required
+#endif
+
+#ifndef GLYPH_PADDING
+#define GLYPH_PADDING 1
+#endif
+
+#ifndef GLYPH_BATCH
+#define GLYPH_BATCH 64  // missing codepoints rasterized with one call
+#endif
+
+#ifndef GLYPH_CACHE_VERSION
+#define GLYPH_CACHE_VERSION 1  // increment if the file layout or the rasterization changes
+#endif
+
+#define GLYPH_NO_PAGE UINT_FAST16_MAX  // glyph without pixels, e.g. space
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <raylib.h>
+#include <rlgl.h>
+
+#include "log.h"
+#include "helpers.h"
+#include "config.h"
+#include "vram.h"
+#include "atlas.h"
+#include "profile.h"
+
+
+typedef struct glyph {
+	int codepoint;
+	uint_fast16_t page;  // GLYPH_NO_PAGE if the glyph has no pixels
+	Rectangle rec;       // in the page, without padding
+	int offset_x;
+	int offset_y;
+	int advance_x;
+} glyph;
+
+// cache files start with the header, followed by the entries sorted by
+// codepoint and the coverage of the glyphs. They are only read by the machine
+// which wrote them, so the layout is the native one.
+typedef struct glyph_cache_header {
+	char magic[4];       // "GLYC"
+	uint32_t version;    // GLYPH_CACHE_VERSION
+	uint64_t font_hash;  // of the contents of the font file
+	uint32_t size;
+	uint32_t count;
+} glyph_cache_header;
+
+typedef struct glyph_cache_entry {
+	int32_t codepoint;
+	int16_t offset_x;
+	int16_t offset_y;
+	int16_t advance_x;
+	uint16_t width;
+	uint16_t height;
+	uint32_t data;  // offset of the coverage, one byte per pixel
+} glyph_cache_entry;
+
+typedef struct glyph_page {
+	uint_fast32_t texture_id;  // vRAM handle
+	struct atlas_shelf *shelves;
+	uint_fast16_t shelves_count;
+	uint_fast16_t top;         // first row no shelf is using
+	uint_fast32_t last_used;   // vRAM frame the page was last drawn in
+} glyph_page;
+
+typedef struct glyph_font {
+	char *name;                // NULL if the slot is unused
+	uint_fast16_t size;
+	uint_fast16_t ref_count;
+	bool failed;               // font file couldn't be loaded, the default font is used
+	pthread_mutex_t mutex;     // glyphs are added by preload threads while the screen thread draws
+	glyph *glyphs;
+	uint_fast32_t glyphs_count;
+	uint_fast32_t *table;      // open addressing, codepoint to glyph index
+	uint_fast32_t table_size;  // power of two, at least twice the glyph count
+	glyph_page *pages;
+	uint_fast16_t pages_count;
+	uint_fast16_t page_size;
+	uint_fast32_t generation;  // incremented when glyphs are evicted, runs have to be built again
+	bool cache_opened;         // the cache file was looked for
+	uint64_t hash;             // of the font file, 0 if it has no cache
+	void *cache;               // mapped cache file, NULL if none
+	size_t cache_size;
+	uint_fast32_t cache_count;
+	glyph_cache_entry *added;  // glyphs rasterized since the cache was mapped, sorted by codepoint
+	uint_fast32_t added_count;
+	uint8_t *added_data;       // coverage of the added glyphs
+	size_t added_size;
+} glyph_font;
+
+typedef struct glyph_quad {
+	uint_fast16_t page;
+	float x, y, width, height;  // relative to the top left corner of the text
+	float u, v, u2, v2;         // normalized texture coordinates
+} glyph_quad;
+
+typedef struct glyph_run_part {
+	uint_fast16_t page;
+	uint_fast32_t first;  // first quad using the page
+	uint_fast32_t count;
+} glyph_run_part;
+
+// laid out text, so static text costs no decoding and lookups per frame
+typedef struct glyph_run {
+	uint_fast32_t font_id;
+	uint_fast32_t generation;  // generation of the font the run was built for
+	bool built;
+	glyph_quad *quads;         // sorted by page
+	uint_fast32_t quads_count;
+	glyph_run_part *parts;
+	uint_fast16_t parts_count;
+} glyph_run;
+
+
+int glyph_next_codepoint(const char **text);
+uint_fast32_t glyph_add_font(const char *name, uint_fast16_t size);
+void glyph_remove_font(uint_fast32_t handle);
+void glyph_prepare(uint_fast32_t handle, const char *text);
+void glyph_upload(uint_fast32_t handle);
+Vector2 glyph_run_build(glyph_run *run, uint_fast32_t handle, const char *text);
+void glyph_run_draw(glyph_run *run, const char *text, Vector2 position, float width, Color color);
+void glyph_draw_default(const char *text, Vector2 position, float size, float spacing, float width, Color color);
+void glyph_run_free(glyph_run *run);
+void glyph_cache_save();
+void glyph_log_stats();
+
+
+#endif
@@ -54,6 +54,26 @@
 		LOG_VERBOSE("Default value »%d« for %s from %s", _dest_, #_dest_, #_cjson_); \
 	}
 
+#define CJSON_DEF_DOUBLE(_dest_, _cjson_, _default_) \
+	if( _cjson_ && cJSON_IsNumber(_cjson_) ) { \
+		_dest_ = _cjson_->valuedouble; \
+		LOG_VERBOSE("Parsed value »%f« for %s from %s", _dest_, #_dest_, #_cjson_); \
+	} \
+	else { \
+		_dest_ = _default_; \
+		LOG_VERBOSE("Default value »%f« for %s from %s", _dest_, #_dest_, #_cjson_); \
+	}
+
+#define CJSON_DEF_BOOL(_dest_, _cjson_, _default_) \
+	if( _cjson_ && cJSON_IsBool(_cjson_) ) { \
+		_dest_ = cJSON_IsTrue(_cjson_); \
+		LOG_VERBOSE("Parsed value »%d« for %s from %s", _dest_, #_dest_, #_cjson_); \
+	} \
+	else { \
+		_dest_ = _default_; \
+		LOG_VERBOSE("Default value »%d« for %s from %s", _dest_, #_dest_, #_cjson_); \
+	}
+
 #define CJSON_DEF_STR(_dest_, _cjson_, _default_) \
 	if( _cjson_ && cJSON_IsString(_cjson_) && _cjson_->valuestring ) { \
 		_dest_ = strdup(_cjson_->valuestring); \
@@ -64,6 +84,16 @@
 		LOG_VERBOSE("Default value »%s« for %s from %s", _dest_, #_dest_, #_cjson_); \
 	}
 
+#define CJSON_DEF_STR_ARENA(_dest_, _cjson_, _default_, _arena_) \
+	if( _cjson_ && cJSON_IsString(_cjson_) && _cjson_->valuestring ) { \
+		_dest_ = arena_strdup(_arena_, _cjson_->valuestring); \
+		LOG_VERBOSE("Parsed value »%s« for %s from %s", _dest_, #_dest_, #_cjson_); \
+	} \
+	else { \
+		_dest_ = _default_; \
+		LOG_VERBOSE("Default value »%s« for %s from %s", _dest_, #_dest_, #_cjson_); \
+	}
+
 #define UINT_FAST16_T(_dest_, _val_) \
 	if( _val_ < 0 ) _dest_ = 0; \
 	else if( _val_ > UINT_FAST16_MAX ) _dest_ = UINT_FAST16_MAX; \
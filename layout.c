@@ -5,7 +5,7 @@ static const char *TOPIC = "layout";
 
 static type_frame *layout_frames;
 static uint_fast16_t layout_frames_count;
-static char *str_default_color;
+static layout *layout_current;
 
 
 static void layout_frame_init() {
@@ -28,19 +28,87 @@ static void layout_default_init() {
 //	screen_add_text((screen_position){20,20}, "test2", 101, NULL, (Color){0,0,255,255});
 }
 
-static void layout_parse_main_attrs(cJSON *layout) {
+/*******************************************************************************
+ * Parses a fill, either a color string or an object like
+ * {"type": "linear", "colors": ["#000000", "#ffffff"], "angle": 90, "radius": 8,
+ * "border": {"width": 2, "color": "#ffffff"}}
+ * @return the fill, NULL if there's none
+ ******************************************************************************/
+static fill *layout_parse_fill(layout *l, cJSON *cjson_fill) {
+	if( cjson_fill == NULL ) {
+		return NULL;
+	}
+	fill *f = arena_alloc(l->arena, sizeof(fill));
+	memset(f, 0, sizeof(fill));
+	if( cJSON_IsString(cjson_fill) && cjson_fill->valuestring ) {
+		f->from = f->to = parse_color_str(cjson_fill->valuestring);
+		return f;
+	}
+	if( !cJSON_IsObject(cjson_fill) ) {
+		LOG_ERROR("Ignoring fill, it has to be a color or an object");
+		return NULL;
+	}
+
+	char *type;
+	cJSON *cjson_type = cJSON_GetObjectItemCaseSensitive(cjson_fill, "type");
+	CJSON_DEF_STR_ARENA(type, cjson_type, "solid", l->arena);
+	if( strcmp("linear", type) == 0 )      { f->type = FILL_LINEAR; }
+	else if( strcmp("radial", type) == 0 ) { f->type = FILL_RADIAL; }
+	else if( strcmp("solid", type) == 0 )  { f->type = FILL_SOLID; }
+	else {
+		LOG_ERROR("Unknown fill type »%s«, using solid", type);
+		f->type = FILL_SOLID;
+	}
+
+	char *str_color;
+	cJSON *cjson_colors = cJSON_GetObjectItemCaseSensitive(cjson_fill, "colors");
+	cJSON *cjson_color = cJSON_GetObjectItemCaseSensitive(cjson_fill, "color");
+	CJSON_DEF_STR_ARENA(str_color, cjson_color, "#ffffff", l->arena);
+	f->from = f->to = parse_color_str(str_color);
+	if( cJSON_IsArray(cjson_colors) ) {
+		cJSON *cjson_from = cJSON_GetArrayItem(cjson_colors, 0);
+		cJSON *cjson_to = cJSON_GetArrayItem(cjson_colors, 1);
+		CJSON_DEF_STR_ARENA(str_color, cjson_from, "#ffffff", l->arena);
+		f->from = f->to = parse_color_str(str_color);
+		if( cjson_to != NULL ) {
+			CJSON_DEF_STR_ARENA(str_color, cjson_to, "#ffffff", l->arena);
+			f->to = parse_color_str(str_color);
+		}
+	}
+
+	double angle, radius, border_width;
+	cJSON *cjson_angle = cJSON_GetObjectItemCaseSensitive(cjson_fill, "angle");
+	cJSON *cjson_radius = cJSON_GetObjectItemCaseSensitive(cjson_fill, "radius");
+	cJSON *cjson_border = cJSON_GetObjectItemCaseSensitive(cjson_fill, "border");
+	cJSON *cjson_border_width = cJSON_GetObjectItemCaseSensitive(cjson_border, "width");
+	CJSON_DEF_DOUBLE(angle, cjson_angle, 90.0);
+	CJSON_DEF_DOUBLE(radius, cjson_radius, 0.0);
+	CJSON_DEF_DOUBLE(border_width, cjson_border_width, 0.0);
+	f->angle = fmod(fmod(angle, 360.0) + 360.0, 360.0);
+	f->radius = ( radius > 0 )?radius:0;
+	f->border_width = ( border_width > 0 )?border_width:0;
+	cJSON *cjson_border_color = cJSON_GetObjectItemCaseSensitive(cjson_border, "color");
+	CJSON_DEF_STR_ARENA(str_color, cjson_border_color, "#000000", l->arena);
+	f->border_color = parse_color_str(str_color);
+	return f;
+}
+
+static void layout_parse_main_attrs(layout *l, cJSON *cjson_layout) {
 	char *str_color;
 
-	cJSON *cjson_default_color = cJSON_GetObjectItemCaseSensitive(layout, "default-color");
-	CJSON_DEF_STR(str_default_color, cjson_default_color, "#000000ff");
-	screen_background_color = parse_color_str(str_default_color);
+	cJSON *cjson_default_color = cJSON_GetObjectItemCaseSensitive(cjson_layout, "default-color");
+	CJSON_DEF_STR_ARENA(str_color, cjson_default_color, "#000000ff", l->arena);
+	l->default_color = parse_color_str(str_color);
+
+	cJSON *cjson_background_color = cJSON_GetObjectItemCaseSensitive(cjson_layout, "background-color");
+	CJSON_DEF_STR_ARENA(str_color, cjson_background_color, "#ffffff", l->arena);
+	l->background_color = parse_color_str(str_color);
 
-	cJSON *cjson_background_color = cJSON_GetObjectItemCaseSensitive(layout, "background-color");
-	CJSON_DEF_STR(str_color, cjson_background_color, "#ffffff");
-	screen_background_color = parse_color_str(str_color);
+	// drawn over the background color, which still shows through transparent parts
+	l->background = layout_parse_fill(l, cJSON_GetObjectItemCaseSensitive(cjson_layout, "background"));
 }
 
-static screen_attrs_text layout_parse_attrs_text(cJSON *attrs) {
+static screen_attrs_text layout_parse_attrs_text(layout *l, cJSON *attrs) {
 	screen_attrs_text attrs_text;
 
 	cJSON *cjson_font_size = cJSON_GetObjectItemCaseSensitive(attrs, "font-size");
@@ -50,39 +118,35 @@ static screen_attrs_text layout_parse_attrs_text(cJSON *attrs) {
 
 	cJSON *cjson_color = cJSON_GetObjectItemCaseSensitive(attrs, "color");
 	char *str_color;
-	CJSON_DEF_STR(str_color, cjson_color, str_default_color);
-	attrs_text.color = parse_color_str(str_color);
+	CJSON_DEF_STR_ARENA(str_color, cjson_color, NULL, l->arena);
+	attrs_text.color = ( str_color != NULL )?parse_color_str(str_color):l->default_color;
 
 	cJSON *cjson_font = cJSON_GetObjectItemCaseSensitive(attrs, "font-name");
-	CJSON_DEF_STR(attrs_text.font_name, cjson_font, NULL);
+	CJSON_DEF_STR_ARENA(attrs_text.font_name, cjson_font, NULL, l->arena);
 
 	return attrs_text;
 }
 
-static void layout_add_img(screen_position *position, cJSON *attrs, char *str_evals) {
+static uint_fast16_t layout_add_img(layout *l, screen_position *position, cJSON *attrs, char *str_evals) {
 	char *str_src;
 	cJSON *cjson_src = cJSON_GetObjectItemCaseSensitive(attrs, "src");
-	CJSON_DEF_STR(str_src, cjson_src, NULL);
+	CJSON_DEF_STR_ARENA(str_src, cjson_src, NULL, l->arena);
 
 	char *str_background_color;
-	Color *background_color;
-	MALLOC(background_color, sizeof(Color));
+	Color background_color;
 	cJSON *cjson_background_color = cJSON_GetObjectItemCaseSensitive(attrs, "background-color");
-	CJSON_DEF_STR(str_background_color, cjson_background_color, NULL);
+	CJSON_DEF_STR_ARENA(str_background_color, cjson_background_color, NULL, l->arena);
 	if( str_background_color != NULL ) {
-		*background_color = parse_color_str(str_background_color);
+		background_color = parse_color_str(str_background_color);
 		LOG_DEBUG("Set background color for image »%s« to %s", str_src, str_background_color);
 	}
-	else {
-		background_color = NULL;
-	}
 
 	LOG_DEBUG("Add image to layout: %s", str_src);
 	
 	screen_resize resize_type;
 	char *str_resize_type;
 	cJSON *cjson_resize_type = cJSON_GetObjectItemCaseSensitive(attrs, "format");
-	CJSON_DEF_STR(str_resize_type, cjson_resize_type, "proper");
+	CJSON_DEF_STR_ARENA(str_resize_type, cjson_resize_type, "proper", l->arena);
 	switch( str_resize_type[0] ) {
 		case 'p':  resize_type = RESIZE_PROPER; break;
 		case 'c':  resize_type = RESIZE_CROP; break;
@@ -90,101 +154,308 @@ static void layout_add_img(screen_position *position, cJSON *attrs, char *str_ev
 		default:   resize_type = RESIZE_PROPER;
 	}
 
-	screen_attrs_img *attr_img = screen_prepare_image(position, resize_type, str_src, background_color);
-	if( attr_img != NULL ) {
-		screen_add_img(*position, *attr_img, str_evals);
-	}
-	else {
-		LOG_ERROR("Failed to add image in layout!!!");
-	}
+	return screen_add_img(l->arena, *position, resize_type, str_src, ( str_background_color != NULL )?&background_color:NULL, str_evals);
 }
 
-static void layout_add_text(screen_position *position, cJSON *attrs, char *str_evals) {
+static uint_fast16_t layout_add_text(layout *l, screen_position *position, cJSON *attrs, char *str_evals) {
 	cJSON *cjson_text = cJSON_GetObjectItemCaseSensitive(attrs, "text");
 	char *text;
-	CJSON_DEF_STR(text, cjson_text, "");
+	CJSON_DEF_STR_ARENA(text, cjson_text, "", l->arena);
 	LOG_DEBUG("Add text to layout: %s", text);
 
-	screen_attrs_text attrs_text = layout_parse_attrs_text(attrs);
+	screen_attrs_text attrs_text = layout_parse_attrs_text(l, attrs);
 
-	screen_add_text(*position, text, attrs_text.font_size, attrs_text.font_name, attrs_text.color, str_evals);
+	return screen_add_text(l->arena, *position, text, attrs_text.font_size, attrs_text.font_name, attrs_text.color, str_evals);
 }
 
-static void layout_add_clock(screen_position *position, cJSON *attrs, char *str_evals) {
+static uint_fast16_t layout_add_clock(layout *l, screen_position *position, cJSON *attrs, char *str_evals) {
 	cJSON *cjson_format = cJSON_GetObjectItemCaseSensitive(attrs, "format");
 	char *format;
-	CJSON_DEF_STR(format, cjson_format, "%H:%M");
+	CJSON_DEF_STR_ARENA(format, cjson_format, "%H:%M", l->arena);
 	LOG_DEBUG("Add clock with format to layout: %s", format);
 
-	screen_attrs_text attrs_text = layout_parse_attrs_text(attrs);
+	screen_attrs_text attrs_text = layout_parse_attrs_text(l, attrs);
+
+	return screen_add_clock(l->arena, *position, format, attrs_text.font_size, attrs_text.font_name, attrs_text.color, str_evals);
+}
 
-	screen_add_clock(*position, format, attrs_text.font_size, attrs_text.font_name, attrs_text.color, str_evals);
+/*******************************************************************************
+ * Parses a length, either a number of pixels or a string like "50%" relative
+ * to the parent box
+ ******************************************************************************/
+static box_length layout_parse_length(cJSON *cjson_length, const char *name) {
+	box_length length = { 0, BOX_PX };
+	if( cjson_length && cJSON_IsNumber(cjson_length) ) {
+		length.value = cjson_length->valuedouble;
+	}
+	else if( cjson_length && cJSON_IsString(cjson_length) && cjson_length->valuestring ) {
+		char *unit;
+		length.value = strtof(cjson_length->valuestring, &unit);
+		if( *unit == '%' ) {
+			length.unit = BOX_PERCENT;
+		}
+		else if( *unit != '\0' && strcmp("px", unit) != 0 ) {
+			LOG_ERROR("Failed to parse length »%s« for %s, using %.0f pixels", cjson_length->valuestring, name, length.value);
+		}
+	}
+	LOG_VERBOSE("Parsed length »%.1f%s« for %s", length.value, (length.unit == BOX_PERCENT)?"%":"px", name);
+	return length;
 }
 
-static inline screen_position layout_parse_position(cJSON *cjson_position) {
-	screen_position position;
+static screen_position layout_parse_position(layout *l, cJSON *cjson_position, box *b) {
+	screen_position position = { 0 };
 
-	cJSON *cjson_x = cJSON_GetObjectItemCaseSensitive(cjson_position, "x");
-	cJSON *cjson_y = cJSON_GetObjectItemCaseSensitive(cjson_position, "y");
-	cJSON *cjson_w = cJSON_GetObjectItemCaseSensitive(cjson_position, "w");
-	cJSON *cjson_h = cJSON_GetObjectItemCaseSensitive(cjson_position, "h");
-	int ix, iy, iw, ih;
-	CJSON_DEF_INT(ix, cjson_x, 0);
-	CJSON_DEF_INT(iy, cjson_y, 0);
-	CJSON_DEF_INT(iw, cjson_w, 0);
-	CJSON_DEF_INT(ih, cjson_h, 0);
-	if( ix < 0 ) { ix = config.width + ix; }
-	if( iy < 0 ) { iy = config.height + iy; }
+	b->x = layout_parse_length(cJSON_GetObjectItemCaseSensitive(cjson_position, "x"), "x");
+	b->y = layout_parse_length(cJSON_GetObjectItemCaseSensitive(cjson_position, "y"), "y");
+	b->w = layout_parse_length(cJSON_GetObjectItemCaseSensitive(cjson_position, "w"), "w");
+	b->h = layout_parse_length(cJSON_GetObjectItemCaseSensitive(cjson_position, "h"), "h");
+	b->gap = layout_parse_length(cJSON_GetObjectItemCaseSensitive(cjson_position, "gap"), "gap");
 
 	cJSON *cjson_align_h = cJSON_GetObjectItemCaseSensitive(cjson_position, "align");
 	cJSON *cjson_align_v = cJSON_GetObjectItemCaseSensitive(cjson_position, "valign");
 	char *align_h, *align_v;
-	CJSON_DEF_STR(align_h, cjson_align_h, "left");
-	CJSON_DEF_STR(align_v, cjson_align_v, "top");
+	CJSON_DEF_STR_ARENA(align_h, cjson_align_h, "left", l->arena);
+	CJSON_DEF_STR_ARENA(align_v, cjson_align_v, "top", l->arena);
 
-	UINT_FAST16_T(position.x, ix);
-	UINT_FAST16_T(position.y, iy);
-	UINT_FAST16_T(position.w, iw);
-	UINT_FAST16_T(position.h, ih);
-
-	if( strcmp("center", align_h) == 0 )     { position.horizontal = ALIGN_CENTER; }
-	else if( strcmp("right", align_h) == 0 ) { position.horizontal = ALIGN_RIGHT; }
-	else                                     { position.horizontal = ALIGN_LEFT; }
-	if( strcmp("middle", align_v) == 0 )     { position.vertical = ALIGN_MIDDLE; }
-	else if( strcmp("top", align_v) == 0)    { position.vertical = ALIGN_TOP; }
-	else                                     { position.vertical = ALIGN_BOTTOM; }
+	if( strcmp("center", align_h) == 0 )     { position.horizontal = ALIGN_CENTER; b->align = BOX_CENTER; }
+	else if( strcmp("right", align_h) == 0 ) { position.horizontal = ALIGN_RIGHT;  b->align = BOX_END; }
+	else                                     { position.horizontal = ALIGN_LEFT;   b->align = BOX_START; }
+	if( strcmp("middle", align_v) == 0 )     { position.vertical = ALIGN_MIDDLE; b->valign = BOX_CENTER; }
+	else if( strcmp("top", align_v) == 0)    { position.vertical = ALIGN_TOP;    b->valign = BOX_START; }
+	else                                     { position.vertical = ALIGN_BOTTOM; b->valign = BOX_END; }
 
 	return position;
 }
 
-static void parse_frame(cJSON *cjson_frame) {
+/*******************************************************************************
+ * Adds a table showing the rows of a JSON data file. Columns are either the
+ * key of a value, or an object with "key", "title" and "width".
+ ******************************************************************************/
+static uint_fast16_t layout_add_table(layout *l, screen_position *position, cJSON *attrs, char *str_evals) {
+	screen_attrs_table table;
+	memset(&table, 0, sizeof(table));
+	cJSON *cjson_src = cJSON_GetObjectItemCaseSensitive(attrs, "src");
+	CJSON_DEF_STR_ARENA(table.file_name, cjson_src, NULL, l->arena);
+	if( table.file_name == NULL ) {
+		LOG_ERROR("Table without src stays empty");
+	}
+	cJSON *cjson_rows = cJSON_GetObjectItemCaseSensitive(attrs, "rows");
+	CJSON_DEF_STR_ARENA(table.rows_key, cjson_rows, NULL, l->arena);
+	LOG_DEBUG("Add table to layout: %s", ( table.file_name != NULL )?table.file_name:"");
+
+	screen_attrs_text attrs_text = layout_parse_attrs_text(l, attrs);
+	table.font_size = attrs_text.font_size;
+	table.font_name = attrs_text.font_name;
+	table.color = attrs_text.color;
+	char *str_header_color;
+	cJSON *cjson_header_color = cJSON_GetObjectItemCaseSensitive(attrs, "header-color");
+	CJSON_DEF_STR_ARENA(str_header_color, cjson_header_color, NULL, l->arena);
+	table.header_color = ( str_header_color != NULL )?parse_color_str(str_header_color):table.color;
+
+	int row_height;
+	cJSON *cjson_row_height = cJSON_GetObjectItemCaseSensitive(attrs, "row-height");
+	CJSON_DEF_INT(row_height, cjson_row_height, 0);
+	UINT_FAST16_T(table.row_height, row_height);
+	cJSON *cjson_page_interval = cJSON_GetObjectItemCaseSensitive(attrs, "page-interval");
+	CJSON_DEF_DOUBLE(table.page_interval, cjson_page_interval, 10.0);
+
+	cJSON *cjson_columns = cJSON_GetObjectItemCaseSensitive(attrs, "columns");
+	table.columns = arena_alloc(l->arena, sizeof(screen_table_column) * ( cJSON_GetArraySize(cjson_columns) + 1 ));
+	cJSON *cjson_column;
+	cJSON_ArrayForEach(cjson_column, cjson_columns) {
+		screen_table_column *column = &table.columns[table.columns_count];
+		memset(column, 0, sizeof(screen_table_column));
+		cJSON *cjson_key = cJSON_IsString(cjson_column)?cjson_column:cJSON_GetObjectItemCaseSensitive(cjson_column, "key");
+		CJSON_DEF_STR_ARENA(column->key, cjson_key, NULL, l->arena);
+		if( column->key == NULL ) {
+			LOG_ERROR("Ignoring table column %lu without key", table.columns_count + 1);
+			continue;
+		}
+		cJSON *cjson_title = cJSON_GetObjectItemCaseSensitive(cjson_column, "title");
+		CJSON_DEF_STR_ARENA(column->title, cjson_title, NULL, l->arena);
+		box_length width = layout_parse_length(cJSON_GetObjectItemCaseSensitive(cjson_column, "width"), "column width");
+		column->width = width.value;
+		column->relative = width.unit == BOX_PERCENT;
+		table.columns_count++;
+	}
+	if( table.columns_count == 0 ) {
+		LOG_ERROR("Table »%s« has no columns", ( table.file_name != NULL )?table.file_name:"");
+	}
+
+	return screen_add_table(l->arena, *position, &table, str_evals);
+}
+
+static anim_easing layout_parse_easing(cJSON *cjson_easing, anim_easing fallback) {
+	if( cjson_easing == NULL || !cJSON_IsString(cjson_easing) || cjson_easing->valuestring == NULL ) {
+		return fallback;
+	}
+	const char *name = cjson_easing->valuestring;
+	if( strcmp("linear", name) == 0 )           { return ANIM_LINEAR; }
+	else if( strcmp("ease-in", name) == 0 )     { return ANIM_EASE_IN; }
+	else if( strcmp("ease-out", name) == 0 )    { return ANIM_EASE_OUT; }
+	else if( strcmp("ease-in-out", name) == 0 ) { return ANIM_EASE_IN_OUT; }
+	else if( strcmp("step", name) == 0 )        { return ANIM_STEP; }
+	LOG_ERROR("Unknown easing »%s«, using linear", name);
+	return ANIM_LINEAR;
+}
+
+/*******************************************************************************
+ * Parses the animation block of a frame. Keyframes may set any of x, y, w, h,
+ * opacity and color, they are sorted into one track per property. Keyframes
+ * without "at" are spread evenly over the duration.
+ * @return the animation, NULL if the frame has none
+ ******************************************************************************/
+static anim *layout_parse_animation(layout *l, cJSON *cjson_animation) {
+	static const char *properties[ANIM_PROPERTIES] = { "x", "y", "w", "h", "opacity", "color" };
+	if( cjson_animation == NULL ) {
+		return NULL;
+	}
+	cJSON *cjson_keyframes = cJSON_GetObjectItemCaseSensitive(cjson_animation, "keyframes");
+	int keyframes_count = cJSON_GetArraySize(cjson_keyframes);
+	if( !cJSON_IsArray(cjson_keyframes) || keyframes_count == 0 ) {
+		LOG_ERROR("Ignoring animation without keyframes");
+		return NULL;
+	}
+
+	anim *a = arena_alloc(l->arena, sizeof(anim));
+	memset(a, 0, sizeof(anim));
+	a->start = -1;
+	cJSON *cjson_duration = cJSON_GetObjectItemCaseSensitive(cjson_animation, "duration");
+	cJSON *cjson_delay = cJSON_GetObjectItemCaseSensitive(cjson_animation, "delay");
+	cJSON *cjson_repeat = cJSON_GetObjectItemCaseSensitive(cjson_animation, "repeat");
+	CJSON_DEF_DOUBLE(a->duration, cjson_duration, 1.0);
+	CJSON_DEF_DOUBLE(a->delay, cjson_delay, 0.0);
+	if( a->duration <= 0 ) {
+		LOG_ERROR("Animation duration has to be positive, using 1s");
+		a->duration = 1.0f;
+	}
+	char *repeat;
+	CJSON_DEF_STR_ARENA(repeat, cjson_repeat, "loop", l->arena);
+	if( strcmp("once", repeat) == 0 )           { a->repeat = ANIM_ONCE; }
+	else if( strcmp("ping-pong", repeat) == 0 ) { a->repeat = ANIM_PING_PONG; }
+	else                                        { a->repeat = ANIM_LOOP; }
+	anim_easing easing = layout_parse_easing(cJSON_GetObjectItemCaseSensitive(cjson_animation, "easing"), ANIM_LINEAR);
+
+	for( anim_property property = 0; property < ANIM_PROPERTIES; property++ ) {
+		anim_track *track = &a->tracks[a->tracks_count];
+		track->property = property;
+		track->keys = NULL;
+		int index = 0;
+		cJSON *cjson_keyframe;
+		cJSON_ArrayForEach(cjson_keyframe, cjson_keyframes) {
+			cJSON *cjson_value = cJSON_GetObjectItemCaseSensitive(cjson_keyframe, properties[property]);
+			index++;
+			if( cjson_value == NULL ) {
+				continue;
+			}
+			if( track->keys == NULL ) {
+				track->keys = arena_alloc(l->arena, sizeof(anim_key) * keyframes_count);
+			}
+			anim_key key = { 0 };
+			cJSON *cjson_at = cJSON_GetObjectItemCaseSensitive(cjson_keyframe, "at");
+			CJSON_DEF_DOUBLE(key.at, cjson_at, ( keyframes_count > 1 )?(double)(index - 1) / (keyframes_count - 1):0.0);
+			key.easing = layout_parse_easing(cJSON_GetObjectItemCaseSensitive(cjson_keyframe, "easing"), easing);
+			if( property == ANIM_COLOR && cJSON_IsString(cjson_value) ) {
+				Color color = parse_color_str(cjson_value->valuestring);
+				key.value[0] = color.r;
+				key.value[1] = color.g;
+				key.value[2] = color.b;
+				key.value[3] = color.a;
+			}
+			else if( property != ANIM_COLOR && cJSON_IsNumber(cjson_value) ) {
+				key.value[0] = cjson_value->valuedouble;
+			}
+			else {
+				LOG_ERROR("Ignoring invalid %s of keyframe %d", properties[property], index);
+				continue;
+			}
+			// keep the keys sorted by time, keyframes are usually in order already
+			uint_fast16_t k = track->keys_count++;
+			while( k > 0 && track->keys[k-1].at > key.at ) {
+				track->keys[k] = track->keys[k-1];
+				k--;
+			}
+			track->keys[k] = key;
+		}
+		if( track->keys_count > 0 ) {
+			a->tracks_count++;
+		}
+	}
+	LOG_DEBUG("Parsed animation with %u tracks over %.2fs", a->tracks_count, a->duration);
+	return a;
+}
+
+static void parse_frame(layout *l, cJSON *cjson_frame, box *parent) {
 	cJSON *cjson_type = cJSON_GetObjectItemCaseSensitive(cjson_frame, "type");
 	char *type;
-	CJSON_DEF_STR(type, cjson_type, "dummy");
+	CJSON_DEF_STR_ARENA(type, cjson_type, "dummy", l->arena);
+
+	if( strcmp("row", type) == 0 || strcmp("column", type) == 0 ) {
+		box *container = box_new(l->arena, ( type[0] == 'r' )?BOX_ROW:BOX_COLUMN, parent);
+		layout_parse_position(l, cjson_frame, container);
+		if( cJSON_GetObjectItemCaseSensitive(cjson_frame, "fill") != NULL ) {
+			LOG_WARNING("Ignoring the fill of a »%s« frame, only elements can be filled", type);
+		}
+		cJSON *cjson_children = cJSON_GetObjectItemCaseSensitive(cjson_frame, "frames");
+		cJSON *cjson_child;
+		cJSON_ArrayForEach(cjson_child, cjson_children) {
+			parse_frame(l, cjson_child, container);
+		}
+		return;
+	}
 
-	screen_position position = layout_parse_position(cjson_frame);
+	uint_fast16_t (*add)(layout *, screen_position *, cJSON *, char *);
+	if( strcmp("text", type) == 0 )       { add = layout_add_text; }
+	else if( strcmp("clock", type) == 0 ) { add = layout_add_clock; }
+	else if( strcmp("img", type) == 0 )   { add = layout_add_img; }
+	else if( strcmp("table", type) == 0 ) { add = layout_add_table; }
+	else {
+		LOG_DEBUG("Ignoring frame of type »%s«", type);
+		return;
+	}
+
+	box *b = box_new(l->arena, BOX_FRAME, parent);
+	screen_position position = layout_parse_position(l, cjson_frame, b);
 
 	char *str_evals;
 	cJSON *cjson_evals = cJSON_GetObjectItemCaseSensitive(cjson_frame, "evals");
-	CJSON_DEF_STR(str_evals, cjson_evals, NULL);
+	CJSON_DEF_STR_ARENA(str_evals, cjson_evals, NULL, l->arena);
 
 	cJSON *attrs = cJSON_GetObjectItemCaseSensitive(cjson_frame, "attrs");
-	if( strcmp("text", type) == 0 ) {
-		layout_add_text(&position, attrs, str_evals);
-	}
-	else if( strcmp("clock", type) == 0 ) {
-		layout_add_clock(&position, attrs, str_evals);
+	uint_fast32_t id = add(l, &position, attrs, str_evals);
+	screen_attach_box(id, b);
+	anim *a = layout_parse_animation(l, cJSON_GetObjectItemCaseSensitive(cjson_frame, "animation"));
+	if( a != NULL ) {
+		screen_attach_anim(id, a);
 	}
-	else if( strcmp("img", type) == 0 ) {
-		layout_add_img(&position, attrs, str_evals);
+	fill *f = layout_parse_fill(l, cJSON_GetObjectItemCaseSensitive(cjson_frame, "fill"));
+	if( f != NULL ) {
+		screen_attach_fill(id, f);
 	}
 }
 
-void layout_init(char *layout_name) {
+/*******************************************************************************
+ * Parses a layout file into its own element list, it's shown by layout_swap.
+ * Everything living as long as the layout is allocated from its arena. Could be
+ * called from any thread.
+ * @param *layout_name name of the file in layouts/ without .json
+ * @return the loaded layout, has to be released with layout_unload
+ ******************************************************************************/
+layout *layout_load(char *layout_name) {
+	PROFILE_FUNC();
 	LOG_INFO("Load layout »%s«", layout_name);
 	layout_frame_init();
-	char *layout_path;
-	MALLOC(layout_path, strlen(layout_name) + sizeof("layouts/.json"));
+
+	arena *a = arena_new();
+	layout *l = arena_alloc(a, sizeof(layout));
+	memset(l, 0, sizeof(layout));
+	l->arena = a;
+	l->name = arena_strdup(a, layout_name);
+	l->elements = arena_alloc(a, sizeof(screen_element_list));
+	memset(l->elements, 0, sizeof(screen_element_list));
+	screen_element_list *previous = screen_build(l->elements);
+
+	char *layout_path = arena_alloc(a, strlen(layout_name) + sizeof("layouts/.json"));
 	sprintf(layout_path, "layouts/%s.json", layout_name);
 	LOG_VERBOSE("Parsing layout file »%s«", layout_path);
 	char *str_layout = NULL;
@@ -192,16 +463,93 @@ void layout_init(char *layout_name) {
 		LOG_WARNING("Could not read layout file »%s« using default layout", layout_path);
 		layout_default_init();
 	}
-	free(layout_path);
-	const char *str_error;
+	const char *str_error = NULL;
 	cJSON *cjson_layout = cJSON_ParseWithOpts(str_layout, &str_error, false);
-	// TODO: error check, log, call layout_default_init();
+	if( cjson_layout == NULL && str_layout != NULL ) {
+		LOG_ERROR("Failed to parse layout file »%s« at »%.20s«, using default layout, run --check for details", layout_path, ( str_error != NULL )?str_error:"");
+		layout_default_init();
+	}
+	free(str_layout);
+
+	layout_parse_main_attrs(l, cjson_layout);
 
-	layout_parse_main_attrs(cjson_layout);
+	l->root = box_new(a, BOX_FRAME, NULL);
+	l->root->w = (box_length){ 100, BOX_PERCENT };
+	l->root->h = (box_length){ 100, BOX_PERCENT };
 
 	cJSON *cjson_frames = cJSON_GetObjectItemCaseSensitive(cjson_layout, "frames");
 	cJSON *cjson_frame;
 	cJSON_ArrayForEach(cjson_frame, cjson_frames) {
-		parse_frame(cjson_frame);
+		parse_frame(l, cjson_frame, l->root);
+	}
+	cJSON_Delete(cjson_layout);
+
+	// initial layout pass, so the first frame is drawn at the resolved positions
+	box_update(l->root);
+	screen_build(previous);
+	LOG_DEBUG("Layout »%s« uses %lu bytes in %lu allocations", l->name, a->bytes, a->allocations);
+	return l;
+}
+
+/*******************************************************************************
+ * Releases all elements of a layout and frees its memory, the layout must not
+ * be shown anymore
+ ******************************************************************************/
+void layout_unload(layout *l) {
+	if( l == NULL ) {
+		return;
+	}
+	LOG_INFO("Unload layout »%s«", l->name);
+	screen_element_list *previous = screen_build(l->elements);
+	screen_clear_elements();
+	screen_build(previous);
+	arena_free(l->arena);
+}
+
+/*******************************************************************************
+ * Shows a loaded layout from the next frame on, must be called from the screen
+ * thread or before it starts
+ * @param *l the layout to show, NULL to show nothing
+ * @return the layout shown before, NULL if none
+ ******************************************************************************/
+layout *layout_swap(layout *l) {
+	layout *previous = layout_current;
+	layout_current = l;
+	if( l != NULL ) {
+		LOG_INFO("Show layout »%s«", l->name);
+		screen_background_color = l->background_color;
+		screen_background_fill = l->background;
+		screen_default_color = l->default_color;
+	}
+	else {
+		screen_background_fill = NULL;
+	}
+	screen_set_root_box(( l != NULL )?l->root:NULL);
+	screen_show(( l != NULL )?l->elements:NULL);
+	return previous;
+}
+
+/*******************************************************************************
+ * Returns the name of the layout shown, NULL if none
+ ******************************************************************************/
+const char *layout_current_name() {
+	return ( layout_current != NULL )?layout_current->name:NULL;
+}
+
+/*******************************************************************************
+ * Loads a layout and shows it, replaces the layout shown before
+ * @param *layout_name name of the file in layouts/ without .json
+ ******************************************************************************/
+void layout_init(char *layout_name) {
+	layout_unload(layout_swap(layout_load(layout_name)));
+}
+
+/*******************************************************************************
+ * Unloads the layout shown, if any
+ ******************************************************************************/
+void layout_deinit() {
+	if( layout_current == NULL ) {
+		return;
 	}
+	layout_unload(layout_swap(NULL));
 }
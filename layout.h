@@ -8,10 +8,31 @@
 #include "screen.h"
 #include "helpers.h"
 #include "config.h"
+#include "profile.h"
 #include "cJSON.h"
+#include "box.h"
+#include "anim.h"
+#include "fill.h"
+#include "arena.h"
 
 
+typedef struct layout {
+	char *name;
+	arena *arena;                 // backs the layout, its boxes and the attributes of its elements
+	struct box *root;
+	struct screen_element_list *elements;  // shown by layout_swap
+	Color background_color;
+	struct fill *background;      // drawn over the background color, NULL if none
+	Color default_color;
+} layout;
+
+
+layout *layout_load(char *layout_name);
+void layout_unload(layout *l);
+layout *layout_swap(layout *l);
+const char *layout_current_name();
 void layout_init(char *layout_name);
+void layout_deinit();
 
 
 #endif
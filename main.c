@@ -10,9 +10,15 @@ int main(int argc, char *argv[]) {
 	log_color = false;
 	do_stop = false;
 	do_fork = false;
+	do_bench_scripts = false;
+	do_bench = false;
+	do_convert_textures = false;
+	do_check = false;
 	LOG_INFO("Info Screen(https://github.com/Mr-Pi/info_screen) by Mr-Pi(contact@mr-pi.de) - Build: " __DATE__ " " __TIME__);
 
 	parse_cmd(argc, argv);
+	PROFILE_INIT();
+	PROFILE_THREAD_NAME("main");
 
 	SetTraceLogLevel(LOG_WARNING);
 
@@ -32,7 +38,34 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
-	layout_init(config.layout);
+	if( do_bench_scripts ) {
+		layout_init(config.layout);
+		script_bench(SCRIPT_BENCH_RUNS);
+		exit(EXIT_SUCCESS);
+	}
+
+	if( do_convert_textures ) {
+		layout_init(config.layout);
+		texture_convert_layout();
+		exit(EXIT_SUCCESS);
+	}
+
+	if( do_check ) {
+		bool ok = true;
+		if( check_layouts_count == 0 ) {
+			ok = check_layout(config.layout);
+		}
+		for( int i = 0; i < check_layouts_count; i++ ) {
+			ok = check_layout(check_layouts[i]) && ok;
+		}
+		exit(ok?EXIT_SUCCESS:EXIT_FAILURE);
+	}
+
+	if( do_bench ) {
+		bench_init(bench_size);
+	}
+
+	startup_load((char *)schedule_layout_at(time(NULL)));
 	screen(NULL);
 	//PTHREAD_CREATE(screen);
 	//PTHREAD_JOIN(screen);
@@ -14,10 +14,24 @@
 #include "log.h"
 #include "screen.h"
 #include "layout.h"
+#include "startup.h"
+#include "script.h"
+#include "bench.h"
+#include "texture.h"
+#include "check.h"
+#include "schedule.h"
+#include "profile.h"
 
 
 bool do_stop;
 bool do_fork;
+bool do_bench_scripts;  // run the scripts of the layout without a window and exit
+bool do_bench;          // run a synthetic layout of bench_size elements and exit
+unsigned long bench_size;
+bool do_convert_textures;  // write compressed siblings of the layout images and exit
+bool do_check;             // validate layouts, print their estimated cost and exit
+char **check_layouts;      // layouts given on the command line
+int check_layouts_count;
 pthread_mutex_t mutex_look;
 
 
@@ -0,0 +1,366 @@
+#include "mirror.h"
+
+static const char *TOPIC = "mirror";
+
+
+static bool mirror_enabled;
+static int mirror_width, mirror_height;
+static size_t mirror_bytes;
+static double mirror_last_capture;
+
+#ifdef MIRROR_USE_PBO
+static GLuint mirror_pbos[2];
+static GLsync mirror_fences[2];  // NULL if the pixel buffer is idle
+static uint_fast16_t mirror_pbo_next;
+#else
+static uint8_t *mirror_readback;
+#endif
+
+// hand over from the render thread to the worker
+static pthread_t mirror_thread;
+static pthread_mutex_t mirror_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mirror_cond = PTHREAD_COND_INITIALIZER;
+static uint8_t *mirror_incoming;
+static bool mirror_incoming_ready;
+static bool mirror_stop;
+
+// owned by the worker
+static uint8_t *mirror_current;
+static uint8_t *mirror_previous;
+static uint8_t *mirror_snapshot;  // RGB, top-down
+static mirror_tile_header *mirror_tiles;
+static bool mirror_full;          // send every tile, e.g. after a reconnect
+static int mirror_socket = -1;
+static bool mirror_socket_error_logged;
+
+
+/*******************************************************************************
+ * Passes a frame to the worker, drops it if the worker is still busy with the
+ * previous one. Never blocks the render thread for longer than a memcpy.
+ ******************************************************************************/
+static void mirror_hand_over(const uint8_t *pixels) {
+	pthread_mutex_lock(&mirror_mutex);
+	bool busy = mirror_incoming_ready;
+	pthread_mutex_unlock(&mirror_mutex);
+	if( busy ) {
+		LOG_VERBOSE("Mirror worker is busy, dropping frame");
+		return;
+	}
+	// the worker doesn't touch the incoming buffer until it's marked ready
+	memcpy(mirror_incoming, pixels, mirror_bytes);
+	pthread_mutex_lock(&mirror_mutex);
+	mirror_incoming_ready = true;
+	pthread_cond_signal(&mirror_cond);
+	pthread_mutex_unlock(&mirror_mutex);
+}
+
+/*******************************************************************************
+ * Collects the tiles which changed since the previous frame
+ * @return number of damaged tiles in mirror_tiles
+ ******************************************************************************/
+static uint_fast32_t mirror_damage() {
+	uint_fast32_t count = 0;
+	for( int ty = 0; ty < mirror_height; ty += MIRROR_TILE_SIZE ) {
+		int th = ( ty + MIRROR_TILE_SIZE > mirror_height )?mirror_height-ty:MIRROR_TILE_SIZE;
+		for( int tx = 0; tx < mirror_width; tx += MIRROR_TILE_SIZE ) {
+			int tw = ( tx + MIRROR_TILE_SIZE > mirror_width )?mirror_width-tx:MIRROR_TILE_SIZE;
+			bool damaged = mirror_full;
+			for( int row = ty; row < ty + th && !damaged; row++ ) {
+				size_t offset = ((size_t)row * mirror_width + tx) * 4;
+				damaged = memcmp(mirror_current + offset, mirror_previous + offset, tw * 4) != 0;
+			}
+			if( damaged ) {
+				// GL rows are bottom-up, tiles are stored top-down
+				mirror_tiles[count++] = (mirror_tile_header){ tx, mirror_height - ty - th, tw, th };
+			}
+		}
+	}
+	return count;
+}
+
+/*******************************************************************************
+ * Converts a damaged tile into the RGB snapshot
+ ******************************************************************************/
+static void mirror_encode_tile(const mirror_tile_header *tile) {
+	for( int y = tile->y; y < tile->y + tile->h; y++ ) {
+		const uint8_t *src = mirror_current + ((size_t)(mirror_height - 1 - y) * mirror_width + tile->x) * 4;
+		uint8_t *dst = mirror_snapshot + ((size_t)y * mirror_width + tile->x) * 3;
+		for( int x = 0; x < tile->w; x++, src += 4, dst += 3 ) {
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+		}
+	}
+}
+
+static void mirror_write_file() {
+	char *path_tmp;
+	MALLOC(path_tmp, strlen(config.mirror_path) + sizeof(".tmp"));
+	sprintf(path_tmp, "%s.tmp", config.mirror_path);
+	FILE *fd = fopen(path_tmp, "w");
+	if( !fd ) {
+		LOG_ERROR("Failed to open %s for writing: %s", path_tmp, strerror(errno));
+		free(path_tmp);
+		return;
+	}
+	fprintf(fd, "P6\n%d %d\n255\n", mirror_width, mirror_height);
+	fwrite(mirror_snapshot, 3, (size_t)mirror_width * mirror_height, fd);
+	if( fclose(fd) != 0 ) {
+		LOG_ERROR("Failed to write snapshot %s: %s", path_tmp, strerror(errno));
+	}
+	else if( rename(path_tmp, config.mirror_path) != 0 ) {
+		LOG_ERROR("Failed to move snapshot to %s: %s", config.mirror_path, strerror(errno));
+	}
+	free(path_tmp);
+}
+
+static bool mirror_send(const void *data, size_t length) {
+	const uint8_t *ptr = data;
+	while( length > 0 ) {
+		ssize_t sent = send(mirror_socket, ptr, length, MSG_NOSIGNAL);
+		if( sent < 0 ) {
+			if( errno == EINTR ) {
+				continue;
+			}
+			return false;
+		}
+		ptr += sent;
+		length -= sent;
+	}
+	return true;
+}
+
+static bool mirror_connect() {
+	if( mirror_socket >= 0 ) {
+		return true;
+	}
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	strncpy(addr.sun_path, config.mirror_path + strlen(MIRROR_SOCKET_PREFIX), sizeof(addr.sun_path) - 1);
+	mirror_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if( mirror_socket < 0 || connect(mirror_socket, (struct sockaddr *)&addr, sizeof(addr)) != 0 ) {
+		if( !mirror_socket_error_logged ) {
+			LOG_WARNING("Failed to connect to mirror socket %s: %s", addr.sun_path, strerror(errno));
+			mirror_socket_error_logged = true;
+		}
+		if( mirror_socket >= 0 ) {
+			close(mirror_socket);
+			mirror_socket = -1;
+		}
+		return false;
+	}
+	LOG_INFO("Connected to mirror socket %s", addr.sun_path);
+	mirror_socket_error_logged = false;
+	mirror_full = true;
+	return true;
+}
+
+/*******************************************************************************
+ * Sends the damaged tiles as RGB to the socket, see mirror_frame_header
+ ******************************************************************************/
+static void mirror_write_socket(uint_fast32_t tiles_count) {
+	mirror_frame_header header = { { 'I', 'S', 'M', 'F' }, mirror_width, mirror_height, tiles_count };
+	bool ok = mirror_send(&header, sizeof(header));
+	for( uint_fast32_t i = 0; i < tiles_count && ok; i++ ) {
+		mirror_tile_header *tile = &mirror_tiles[i];
+		ok = mirror_send(tile, sizeof(mirror_tile_header));
+		for( int y = tile->y; y < tile->y + tile->h && ok; y++ ) {
+			ok = mirror_send(mirror_snapshot + ((size_t)y * mirror_width + tile->x) * 3, tile->w * 3);
+		}
+	}
+	if( !ok ) {
+		LOG_WARNING("Lost connection to mirror socket: %s", strerror(errno));
+		close(mirror_socket);
+		mirror_socket = -1;
+	}
+}
+
+static void mirror_process() {
+	PROFILE_FUNC();
+	bool to_socket = strncmp(config.mirror_path, MIRROR_SOCKET_PREFIX, strlen(MIRROR_SOCKET_PREFIX)) == 0;
+	if( to_socket && !mirror_connect() ) {
+		return;
+	}
+	uint_fast32_t tiles_count = mirror_damage();
+	mirror_full = false;
+	if( tiles_count == 0 ) {
+		return;
+	}
+	for( uint_fast32_t i = 0; i < tiles_count; i++ ) {
+		mirror_encode_tile(&mirror_tiles[i]);
+	}
+	LOG_VERBOSE("Mirror frame with %lu damaged tiles", tiles_count);
+	if( to_socket ) {
+		mirror_write_socket(tiles_count);
+	}
+	else {
+		mirror_write_file();
+	}
+}
+
+static void *mirror_worker(void *_) {
+	PROFILE_THREAD_NAME("mirror");
+	while( true ) {
+		pthread_mutex_lock(&mirror_mutex);
+		while( !mirror_incoming_ready && !mirror_stop ) {
+			pthread_cond_wait(&mirror_cond, &mirror_mutex);
+		}
+		if( mirror_stop ) {
+			pthread_mutex_unlock(&mirror_mutex);
+			break;
+		}
+		uint8_t *tmp = mirror_current;
+		mirror_current = mirror_incoming;
+		mirror_incoming = tmp;
+		mirror_incoming_ready = false;
+		pthread_mutex_unlock(&mirror_mutex);
+
+		mirror_process();
+
+		tmp = mirror_previous;
+		mirror_previous = mirror_current;
+		mirror_current = tmp;
+	}
+	return NULL;
+}
+
+/*******************************************************************************
+ * Starts mirroring if configured, has to be called after the window is opened
+ * @param width width of the captured framebuffer
+ * @param height height of the captured framebuffer
+ ******************************************************************************/
+void mirror_init(int width, int height) {
+	if( config.mirror_path == NULL ) {
+		return;
+	}
+	mirror_width = width;
+	mirror_height = height;
+	mirror_bytes = (size_t)width * height * 4;
+	MALLOC(mirror_incoming, mirror_bytes);
+	MALLOC(mirror_current, mirror_bytes);
+	MALLOC(mirror_previous, mirror_bytes);
+	MALLOC(mirror_snapshot, (size_t)width * height * 3);
+	size_t tiles = (size_t)((width + MIRROR_TILE_SIZE - 1) / MIRROR_TILE_SIZE) * ((height + MIRROR_TILE_SIZE - 1) / MIRROR_TILE_SIZE);
+	MALLOC(mirror_tiles, sizeof(mirror_tile_header) * tiles);
+	memset(mirror_snapshot, 0, (size_t)width * height * 3);
+	mirror_full = true;
+
+#ifdef MIRROR_USE_PBO
+	glGenBuffers(2, mirror_pbos);
+	for( int i = 0; i < 2; i++ ) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, mirror_pbos[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, mirror_bytes, NULL, GL_STREAM_READ);
+		mirror_fences[i] = NULL;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+#else
+	MALLOC(mirror_readback, mirror_bytes);
+	LOG_WARNING("No pixel buffer objects on this platform, mirror readback stalls once per interval");
+#endif
+
+	mirror_stop = false;
+	if( pthread_create(&mirror_thread, NULL, mirror_worker, NULL) ) {
+		LOG_FATAL("Failed to start thread mirror_worker");
+	}
+	mirror_enabled = true;
+	LOG_INFO("Mirroring %dx%d to %s every %.2fs", width, height, config.mirror_path, config.mirror_interval);
+}
+
+/*******************************************************************************
+ * Capture stage, called once per frame after everything is drawn and before
+ * the buffers are swapped. Readbacks are issued into one of two pixel buffers
+ * and only mapped in a later frame after the GPU signaled their fence.
+ * @param framebuffer the framebuffer to read, 0 for the default one
+ ******************************************************************************/
+void mirror_capture(unsigned int framebuffer) {
+	if( !mirror_enabled ) {
+		return;
+	}
+	PROFILE_FUNC();
+
+#ifdef MIRROR_USE_PBO
+	for( int i = 0; i < 2; i++ ) {
+		if( mirror_fences[i] == NULL ) {
+			continue;
+		}
+		GLenum state = glClientWaitSync(mirror_fences[i], 0, 0);
+		if( state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED ) {
+			continue;
+		}
+		glDeleteSync(mirror_fences[i]);
+		mirror_fences[i] = NULL;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, mirror_pbos[i]);
+		const uint8_t *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, mirror_bytes, GL_MAP_READ_BIT);
+		if( pixels != NULL ) {
+			mirror_hand_over(pixels);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		else {
+			LOG_ERROR("Failed to map mirror pixel buffer");
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+#endif
+
+	double now = GetTime();
+	if( now - mirror_last_capture < config.mirror_interval ) {
+		return;
+	}
+
+#ifdef MIRROR_USE_PBO
+	if( mirror_fences[mirror_pbo_next] != NULL ) {
+		// both readbacks are still in flight, try again next frame
+		return;
+	}
+#endif
+	mirror_last_capture = now;
+
+	rlglDraw();
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+#ifdef MIRROR_USE_PBO
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, mirror_pbos[mirror_pbo_next]);
+	glReadPixels(0, 0, mirror_width, mirror_height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	mirror_fences[mirror_pbo_next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	mirror_pbo_next ^= 1;
+#else
+	glReadPixels(0, 0, mirror_width, mirror_height, GL_RGBA, GL_UNSIGNED_BYTE, mirror_readback);
+	mirror_hand_over(mirror_readback);
+#endif
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/*******************************************************************************
+ * Stops the worker and frees all buffers, must be called before the window is
+ * closed
+ ******************************************************************************/
+void mirror_close() {
+	if( !mirror_enabled ) {
+		return;
+	}
+	pthread_mutex_lock(&mirror_mutex);
+	mirror_stop = true;
+	pthread_cond_signal(&mirror_cond);
+	pthread_mutex_unlock(&mirror_mutex);
+	pthread_join(mirror_thread, NULL);
+
+#ifdef MIRROR_USE_PBO
+	for( int i = 0; i < 2; i++ ) {
+		if( mirror_fences[i] != NULL ) {
+			glDeleteSync(mirror_fences[i]);
+		}
+	}
+	glDeleteBuffers(2, mirror_pbos);
+#else
+	free(mirror_readback);
+#endif
+	if( mirror_socket >= 0 ) {
+		close(mirror_socket);
+		mirror_socket = -1;
+	}
+	free(mirror_incoming);
+	free(mirror_current);
+	free(mirror_previous);
+	free(mirror_snapshot);
+	free(mirror_tiles);
+	mirror_enabled = false;
+}
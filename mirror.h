@@ -0,0 +1,56 @@
+#ifndef __MIRROR_H__
+#define __MIRROR_H__
+
+
+#ifndef MIRROR_TILE_SIZE
+#define MIRROR_TILE_SIZE 32
+#endif
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <raylib.h>
+#include <rlgl.h>
+
+#if defined(PLATFORM_DESKTOP)
+	// pixel buffer objects need desktop GL or GLES 3, readback is synchronous on GLES 2
+	#define MIRROR_USE_PBO
+	#define GL_GLEXT_PROTOTYPES
+	#include <GL/gl.h>
+	#include <GL/glext.h>
+#else
+	#include <GLES2/gl2.h>
+#endif
+
+#include "log.h"
+#include "helpers.h"
+#include "config.h"
+#include "profile.h"
+
+
+#define MIRROR_SOCKET_PREFIX "unix:"
+
+typedef struct mirror_tile_header {
+	uint16_t x, y, w, h;
+} mirror_tile_header;
+
+typedef struct mirror_frame_header {
+	char magic[4];  // "ISMF"
+	uint16_t width, height;
+	uint32_t tiles;
+} mirror_frame_header;
+
+
+void mirror_init(int width, int height);
+void mirror_capture(unsigned int framebuffer);
+void mirror_close();
+
+
+#endif
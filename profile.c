@@ -0,0 +1,143 @@
+#include "profile.h"
+
+static const char *TOPIC = "profile";
+
+
+static FILE *profile_file;
+static bool profile_first_event;
+static uint64_t profile_start;
+static profile_buffer *profile_buffers;  // of running threads, a thread writes and frees its buffer when it exits
+static pthread_mutex_t profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t profile_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t profile_key;  // its destructor releases the buffer of an exiting thread
+static _Thread_local profile_buffer *profile_thread_buffer;
+
+
+/*******************************************************************************
+ * Writes all events of a buffer as chrome trace events, caller has to hold
+ * profile_mutex
+ ******************************************************************************/
+static void profile_write(profile_buffer *buffer) {
+	if( profile_file == NULL ) {
+		buffer->count = 0;
+		return;
+	}
+	for( uint_fast32_t i = 0; i < buffer->count; i++ ) {
+		profile_event *event = &buffer->events[i];
+		fprintf(profile_file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+				profile_first_event?"":",", event->name, (event->start - profile_start) / 1000.0, event->duration / 1000.0,
+				(int)getpid(), buffer->tid);
+		profile_first_event = false;
+	}
+	buffer->count = 0;
+}
+
+/*******************************************************************************
+ * Names the thread of a buffer in the trace, caller has to hold profile_mutex
+ ******************************************************************************/
+static void profile_write_name(profile_buffer *buffer) {
+	if( profile_file != NULL && buffer->thread_name != NULL ) {
+		fprintf(profile_file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				profile_first_event?"":",", (int)getpid(), buffer->tid, buffer->thread_name);
+		profile_first_event = false;
+	}
+}
+
+/*******************************************************************************
+ * Writes the remaining events of an exiting thread, unlinks its buffer and
+ * frees it. Threads are created again for each prepared layout, so buffers
+ * mustn't outlive them.
+ ******************************************************************************/
+static void profile_release_buffer(void *data) {
+	profile_buffer *buffer = data;
+	pthread_mutex_lock(&profile_mutex);
+	profile_write(buffer);
+	profile_write_name(buffer);
+	profile_buffer **link = &profile_buffers;
+	while( *link != NULL && *link != buffer ) {
+		link = &(*link)->next;
+	}
+	if( *link != NULL ) {
+		*link = buffer->next;
+	}
+	pthread_mutex_unlock(&profile_mutex);
+	free(buffer);
+	profile_thread_buffer = NULL;
+}
+
+static void profile_create_key() {
+	if( pthread_key_create(&profile_key, profile_release_buffer) != 0 ) {
+		LOG_FATAL("Failed to create the thread key of profile buffers");
+	}
+}
+
+static profile_buffer *profile_get_buffer() {
+	if( profile_thread_buffer != NULL ) {
+		return profile_thread_buffer;
+	}
+	pthread_once(&profile_key_once, profile_create_key);
+	MALLOC(profile_thread_buffer, sizeof(profile_buffer));
+	pthread_setspecific(profile_key, profile_thread_buffer);
+	profile_thread_buffer->tid = (int)syscall(SYS_gettid);
+	profile_thread_buffer->thread_name = NULL;
+	profile_thread_buffer->count = 0;
+	pthread_mutex_lock(&profile_mutex);
+	profile_thread_buffer->next = profile_buffers;
+	profile_buffers = profile_thread_buffer;
+	pthread_mutex_unlock(&profile_mutex);
+	return profile_thread_buffer;
+}
+
+/*******************************************************************************
+ * Ends a zone, called by the cleanup attribute of PROFILE_ZONE. Events are
+ * collected per thread and only written out when the buffer is full.
+ ******************************************************************************/
+void profile_zone_end(profile_zone *zone) {
+	uint64_t end = profile_now();
+	profile_buffer *buffer = profile_get_buffer();
+	buffer->events[buffer->count++] = (profile_event){ zone->name, zone->start, end - zone->start };
+	if( buffer->count == PROFILE_BUFFER_EVENTS ) {
+		pthread_mutex_lock(&profile_mutex);
+		profile_write(buffer);
+		pthread_mutex_unlock(&profile_mutex);
+	}
+}
+
+void profile_init(const char *path) {
+	profile_start = profile_now();
+	profile_file = fopen(path, "w");
+	if( profile_file == NULL ) {
+		LOG_ERROR("Failed to open profile file %s: %s", path, strerror(errno));
+		return;
+	}
+	fprintf(profile_file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	profile_first_event = true;
+	LOG_INFO("Writing trace events to %s", path);
+}
+
+/*******************************************************************************
+ * Names the calling thread in the trace
+ ******************************************************************************/
+void profile_thread_name(const char *name) {
+	profile_get_buffer()->thread_name = name;
+}
+
+/*******************************************************************************
+ * Writes the pending events of the calling thread and closes the trace file.
+ * Exited threads wrote theirs already, buffers of threads still running are
+ * left alone, they may be appending to them. Their events after the last full
+ * buffer are dropped.
+ ******************************************************************************/
+void profile_finish() {
+	pthread_mutex_lock(&profile_mutex);
+	if( profile_thread_buffer != NULL ) {
+		profile_write(profile_thread_buffer);
+		profile_write_name(profile_thread_buffer);
+	}
+	if( profile_file != NULL ) {
+		fprintf(profile_file, "\n]}\n");
+		fclose(profile_file);
+		profile_file = NULL;
+	}
+	pthread_mutex_unlock(&profile_mutex);
+}
@@ -0,0 +1,89 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+
+#ifndef PROFILE_FILE
+#define PROFILE_FILE "profile.json"
+#endif
+
+#ifndef PROFILE_BUFFER_EVENTS
+#define PROFILE_BUFFER_EVENTS 4096
+#endif
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "log.h"
+#include "helpers.h"
+
+
+#define PROFILE_CONCAT_(_a_, _b_) _a_ ## _b_
+#define PROFILE_CONCAT(_a_, _b_) PROFILE_CONCAT_(_a_, _b_)
+
+#ifdef PROFILE
+
+/*******************************************************************************
+ * Scoped zones, the zone ends when the enclosing block is left
+ ******************************************************************************/
+#define PROFILE_ZONE(_name_) \
+	profile_zone PROFILE_CONCAT(profile_zone_, __LINE__) __attribute__((cleanup(profile_zone_end))) = profile_zone_begin(_name_);
+#define PROFILE_FUNC() PROFILE_ZONE(__func__)
+#define PROFILE_INIT() profile_init(PROFILE_FILE)
+#define PROFILE_THREAD_NAME(_name_) profile_thread_name(_name_)
+#define PROFILE_FINISH() profile_finish()
+
+#else
+
+#define PROFILE_ZONE(_name_)
+#define PROFILE_FUNC()
+#define PROFILE_INIT()
+#define PROFILE_THREAD_NAME(_name_)
+#define PROFILE_FINISH()
+
+#endif
+
+
+typedef struct profile_zone {
+	const char *name;
+	uint64_t start;  // ns
+} profile_zone;
+
+typedef struct profile_event {
+	const char *name;
+	uint64_t start;  // ns
+	uint64_t duration;  // ns
+} profile_event;
+
+typedef struct profile_buffer {
+	int tid;
+	const char *thread_name;
+	uint_fast32_t count;
+	profile_event events[PROFILE_BUFFER_EVENTS];
+	struct profile_buffer *next;
+} profile_buffer;
+
+
+static inline uint64_t profile_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline profile_zone profile_zone_begin(const char *name) {
+	return (profile_zone){ name, profile_now() };
+}
+
+void profile_zone_end(profile_zone *zone);
+void profile_init(const char *path);
+void profile_thread_name(const char *name);
+void profile_finish();
+
+
+#endif
@@ -0,0 +1,151 @@
+#include "schedule.h"
+
+static const char *TOPIC = "schedule";
+
+
+static schedule_prewarm prewarm;
+static time_t schedule_last_poll;
+
+
+static bool schedule_matches(const config_schedule *entry, const struct tm *tm) {
+	long date = (tm->tm_year + 1900) * 10000L + (tm->tm_mon + 1) * 100 + tm->tm_mday;
+	if( entry->date != 0 && ( date < entry->date || date > entry->until ) ) {
+		return false;
+	}
+	if( !(entry->days & (1 << tm->tm_wday)) ) {
+		return false;
+	}
+	if( entry->from < 0 && entry->to < 0 ) {
+		return true;
+	}
+	int minutes = tm->tm_hour * 60 + tm->tm_min;
+	int from = ( entry->from >= 0 )?entry->from:0;
+	int to = ( entry->to >= 0 )?entry->to:24 * 60;
+	if( from <= to ) {
+		return minutes >= from && minutes < to;
+	}
+	// spans midnight, e.g. 22:00 to 06:00
+	return minutes >= from || minutes < to;
+}
+
+/*******************************************************************************
+ * Returns the layout scheduled at a time, the last matching entry wins so
+ * overrides like events go to the end of the schedule
+ * @param t the time to look up
+ * @return the name of the layout, config.layout if no entry matches
+ ******************************************************************************/
+const char *schedule_layout_at(time_t t) {
+	struct tm tm;
+	localtime_r(&t, &tm);
+	const char *name = config.layout;
+	for( int i = 0; i < config.schedule_count; i++ ) {
+		if( schedule_matches(&config.schedule[i], &tm) ) {
+			name = config.schedule[i].layout;
+		}
+	}
+	return name;
+}
+
+static void *schedule_prewarm_thread(void *_) {
+	PROFILE_THREAD_NAME("prewarm");
+	uint_fast16_t cpus = tasks_cpu_count();
+	struct layout *l = layout_load(prewarm.name);
+	// leave a core to the screen thread
+	startup_prepare_layout(l, ( cpus > 1 )?cpus - 1:1);
+	prewarm.layout = l;
+	atomic_store(&prewarm.done, true);
+	return NULL;
+}
+
+static void schedule_start_prewarm(const char *name) {
+	LOG_INFO("Prepare layout »%s«", name);
+	prewarm.name = strdup(name);
+	FAIL_ON_NULL(prewarm.name, "Failed to copy layout name »%s«", name);
+	prewarm.layout = NULL;
+	prewarm.uploaded = false;
+	prewarm.forced = false;
+	atomic_store(&prewarm.done, false);
+	if( pthread_create(&prewarm.thread, NULL, schedule_prewarm_thread, NULL) ) {
+		LOG_FATAL("Failed to start thread schedule_prewarm_thread");
+	}
+}
+
+static struct layout *schedule_take_prewarmed() {
+	struct layout *l = prewarm.layout;
+	free(prewarm.name);
+	prewarm.name = NULL;
+	prewarm.layout = NULL;
+	return l;
+}
+
+/*******************************************************************************
+ * Loads a layout in the background and shows it once it's ready, e.g. to
+ * reload the current layout after its file changed
+ * @return false if another layout is being prepared
+ ******************************************************************************/
+bool schedule_load(const char *name) {
+	if( prewarm.name != NULL ) {
+		return false;
+	}
+	schedule_start_prewarm(name);
+	prewarm.forced = true;
+	return true;
+}
+
+/*******************************************************************************
+ * Checks the schedule once per second, starts preparing the next layout in the
+ * background before it's due and uploads it once it's ready. Must be called
+ * from the screen thread before each frame.
+ * @return the prepared layout once it's due, the caller swaps it in. NULL if
+ * nothing has to be changed.
+ ******************************************************************************/
+struct layout *schedule_poll() {
+	time_t now = time(NULL);
+	if( prewarm.name == NULL ) {
+		if( config.schedule_count == 0 || now == schedule_last_poll ) {
+			return NULL;
+		}
+		schedule_last_poll = now;
+		const char *current = layout_current_name();
+		const char *due = schedule_layout_at(now);
+		const char *soon = schedule_layout_at(now + (time_t)config.schedule_prewarm);
+		if( current == NULL || strcmp(due, current) != 0 ) {
+			schedule_start_prewarm(due);
+		}
+		else if( strcmp(soon, current) != 0 ) {
+			schedule_start_prewarm(soon);
+		}
+		return NULL;
+	}
+	if( !atomic_load(&prewarm.done) ) {
+		return NULL;
+	}
+	if( !prewarm.uploaded ) {
+		pthread_join(prewarm.thread, NULL);
+		screen_upload(prewarm.layout->elements);
+		prewarm.uploaded = true;
+		LOG_DEBUG("Layout »%s« is ready", prewarm.name);
+	}
+	if( prewarm.forced || strcmp(prewarm.name, schedule_layout_at(now)) == 0 ) {
+		return schedule_take_prewarmed();
+	}
+	if( strcmp(prewarm.name, schedule_layout_at(now + (time_t)config.schedule_prewarm)) != 0 ) {
+		// the schedule changed meanwhile, e.g. by a clock jump
+		LOG_DEBUG("Dropping prepared layout »%s«, it isn't scheduled anymore", prewarm.name);
+		layout_unload(schedule_take_prewarmed());
+	}
+	return NULL;
+}
+
+/*******************************************************************************
+ * Waits for a running prewarm and releases a prepared layout which wasn't shown
+ ******************************************************************************/
+void schedule_deinit() {
+	if( prewarm.name == NULL ) {
+		return;
+	}
+	if( !prewarm.uploaded ) {
+		pthread_join(prewarm.thread, NULL);
+	}
+	layout_unload(schedule_take_prewarmed());
+}
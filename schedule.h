@@ -0,0 +1,39 @@
+#ifndef __SCHEDULE_H__
+#define __SCHEDULE_H__
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+#include "log.h"
+#include "helpers.h"
+#include "config.h"
+#include "layout.h"
+#include "startup.h"
+#include "tasks.h"
+#include "profile.h"
+
+
+struct layout;
+
+typedef struct schedule_prewarm {
+	char *name;           // layout being prepared, NULL if none
+	struct layout *layout;
+	atomic_bool done;     // set by the prewarm thread
+	bool uploaded;        // textures and fonts are in GPU memory
+	bool forced;          // shown once ready, regardless of the schedule
+	pthread_t thread;
+} schedule_prewarm;
+
+
+const char *schedule_layout_at(time_t t);
+bool schedule_load(const char *name);
+struct layout *schedule_poll();
+void schedule_deinit();
+
+
+#endif
@@ -3,18 +3,23 @@
 static const char *TOPIC = "screen";
 
 
-typedef struct screen_font {
-	Font font;
-	char *name;
-	uint_fast16_t font_size;
-} screen_font;
+static screen_element_list screen_empty_list;
+static screen_element_list *screen_shown = &screen_empty_list;
+static _Thread_local screen_element_list *screen_building;  // list elements are added to, NULL for the shown one
+static box *screen_root_box;
+static uint_fast32_t *screen_grid_start;    // per cell the first entry in screen_grid_items, one more for the end
+static uint_fast32_t *screen_grid_items;    // indices of the occluders overlapping each cell
+static uint_fast32_t screen_grid_cells;     // allocated cells
+static uint_fast32_t screen_grid_capacity;  // allocated items
+static screen_cull_stats screen_culled;     // of the last frame drawn
+static double screen_anim_clock;            // seconds animations are running, stands still while paused
+static double screen_anim_last;             // GetTime() of the last frame
+static double screen_script_next;           // animation clock the next script tick is due at
 
 
-static screen_font *screen_fonts;
-static uint_fast16_t screen_fonts_count;
-
-static screen_element *screen_elements;
-static uint_fast32_t screen_elements_count;
+static inline screen_element_list *screen_list() {
+	return ( screen_building != NULL )?screen_building:screen_shown;
+}
 
 
 /*******************************************************************************
@@ -22,11 +27,12 @@ static uint_fast32_t screen_elements_count;
  * @return free element id, UINT_FAST32_MAX if no element id is available
  ******************************************************************************/
 static uint_fast32_t get_free_element_id() {
+	screen_element_list *list = screen_list();
 	bool unique;
-	for( uint_fast32_t id = 0; id < screen_elements_count; id++ ) {
+	for( uint_fast32_t id = 0; id < list->count; id++ ) {
 		unique = true;
-		for( uint_fast32_t i = 0; i < screen_elements_count - 1; i++ ) {
-			if( screen_elements[i].id == id ) {
+		for( uint_fast32_t i = 0; i < list->count - 1; i++ ) {
+			if( list->elements[i].id == id ) {
 				unique = false;
 				break;
 			}
@@ -40,190 +46,496 @@ static uint_fast32_t get_free_element_id() {
 }
 
 /*******************************************************************************
- * Load front into GPU memory if not loaded
+ * Register font with the glyph cache, glyphs are rasterized on first use
  * @param *name Name of the font to be loaded
  * @param font_size max size of font to loaded
- * @return the index of the loaded font
+ * @return the glyph cache handle of the font
  ******************************************************************************/
-static uint_fast16_t load_font(const char *name, const uint_fast16_t font_size) {
-	for( uint_fast16_t i = 0; i < screen_fonts_count; i++ ) {
-		if( font_size == screen_fonts[i].font_size && strcmp(name, screen_fonts[i].name ) == 0 ) {
-			LOG_VERBOSE("Font »%s:%lu« already loaded", name, font_size);
-			return i;
-		}
-	}
+static uint_fast32_t load_font(const char *name, const uint_fast16_t font_size) {
+	PROFILE_FUNC();
 	LOG_VERBOSE("Load font: %s:%lu", name, font_size);
-	REALLOC(screen_fonts_new, screen_fonts, sizeof(screen_font) * ++screen_fonts_count);
-	screen_fonts[screen_fonts_count-1].font_size = font_size;
-	screen_fonts[screen_fonts_count-1].name = strdup(name);
-	FAIL_ON_NULL(screen_fonts[screen_fonts_count-1].name, "Failed to copy font name »%s« while loading font into vRAM", name);
-	screen_fonts[screen_fonts_count-1].font = LoadFontEx(name, font_size, 0, 0xff);
-	LOG_DEBUG("Loaded font »%s:%lu« with id %lu", screen_fonts[screen_fonts_count-1].name, screen_fonts[screen_fonts_count-1].font_size, screen_fonts_count-1);
-	return screen_fonts_count-1;
+	return glyph_add_font(name, font_size);
 }
 
-static void free_text_attrs(screen_attrs_text *attrs) {
-	free(attrs->text);
-	if( attrs->font_name ) {
-		free(attrs->font_name);
+/*******************************************************************************
+ * Releases what an element holds outside of its arena, the attributes
+ * themselves are freed with the arena of the layout
+ ******************************************************************************/
+static void release_text_attrs(screen_attrs_text *attrs) {
+	if( attrs->text_owned ) {
+		free(attrs->text);
+	}
+	free(attrs->formatted);
+	if( attrs->font_id != UINT_FAST32_MAX ) {
+		glyph_run_free(attrs->run);
+		glyph_remove_font(attrs->font_id);
+	}
+}
+
+static void release_table_attrs(screen_attrs_table *attrs) {
+	table_free(&attrs->store);
+	for( uint_fast32_t i = 0; i < attrs->runs_count; i++ ) {
+		glyph_run_free(&attrs->runs[i]);
+	}
+	free(attrs->runs);
+	if( attrs->font_id != UINT_FAST32_MAX ) {
+		glyph_remove_font(attrs->font_id);
+	}
+}
+
+static void release_img_attrs(screen_attrs_img *attrs) {
+	if( attrs->texture_id != UINT_FAST32_MAX ) {
+		vram_remove(attrs->texture_id);
+	}
+	if( attrs->atlas_slot != UINT_FAST32_MAX ) {
+		atlas_remove(attrs->atlas_slot);
 	}
 }
 
 /*******************************************************************************
- * Removes element from screen and free it's memory
+ * Removes element from screen and releases its vRAM and lua state, memory
+ * allocated from the arena is released with the arena
  * @param element_id element to remove
  ******************************************************************************/
-void screen_remove_element(uint_fast16_t element_id) {
-	switch( screen_elements[element_id].type ) {
+void screen_remove_element(uint_fast32_t element_id) {
+	screen_element_list *list = screen_list();
+	uint_fast32_t index = 0;
+	while( index < list->count && list->elements[index].id != element_id ) {
+		index++;
+	}
+	if( index == list->count ) {
+		LOG_ERROR("Can't remove unknown element %lu", element_id);
+		return;
+	}
+	screen_element *element = &list->elements[index];
+	switch( element->type ) {
 		case SCREEN_CLOCK:
 		case SCREEN_TEXT:
-			free_text_attrs(screen_elements[element_id].attrs);
-			free(screen_elements[element_id].attrs);
+			release_text_attrs(element->attrs);
+			break;
+		case SCREEN_IMG:
+			release_img_attrs(element->attrs);
+			break;
+		case SCREEN_TABLE:
+			release_table_attrs(element->attrs);
 			break;
 		default:
-			LOG_FATAL("Failed to remove unknown element type %d from screen elements", screen_elements[element_id].type);
+			LOG_FATAL("Failed to remove unknown element type %d from screen elements", element->type);
 	}
-	//free(&screen_elements[element_id]);
-	for( uint_fast16_t i = element_id; i < screen_elements_count - 1; i++ ) {
-		screen_elements[i] = screen_elements[i+1];
+	if( element->evals != NULL && element->evals->lua_state != NULL ) {
+		lua_close(element->evals->lua_state);
 	}
-	screen_elements_count--;
-	REALLOC(new_screen_elements, screen_elements, sizeof(screen_element) * screen_elements_count);
+	for( uint_fast32_t i = index; i < list->count - 1; i++ ) {
+		list->elements[i] = list->elements[i+1];
+	}
+	list->count--;
+	if( list->count == 0 ) {
+		free(list->elements);
+		list->elements = NULL;
+		return;
+	}
+	REALLOC(new_screen_elements, list->elements, sizeof(screen_element) * list->count);
 }
 
-void screen_resize_image(Image *image, screen_resize resize_method, uint_fast16_t max_w, uint_fast16_t max_h) {
-	LOG_VERBOSE("Resize image in box (w:%lu,h:%lu)", max_w, max_h);
+/*******************************************************************************
+ * Creates the evals of an element
+ * @param *lua_script the script, has to live as long as the arena
+ * @return the evals, NULL if there is no script
+ ******************************************************************************/
+static screen_evals *new_evals(arena *a, char *lua_script) {
+	if( lua_script == NULL ) {
+		return NULL;
+	}
+	screen_evals *evals = arena_alloc(a, sizeof(screen_evals));
+	evals->lua_state = NULL;
+	evals->lua_script = lua_script;
+	evals->moved = 0;
+	return evals;
+}
 
-	float factor = 1;
-	switch( resize_method ) {
-		case RESIZE_PROPER:
-			if( max_w < max_h ) {
-				factor = (float)max_w / (float)image->width;
-			}	
-			else {
-				factor = (float)max_h / (float)image->height;
-			}
-			LOG_VERBOSE("Rescale factor is: %f", factor);
+/*******************************************************************************
+ * Add an image to screen elements, the image is loaded and prepared later by
+ * screen_prepare_img
+ * @param *a the arena of the layout, attributes are allocated from it
+ * @param position position and size of the image
+ * @param resize_type how to fit the image into the size of the element
+ * @param file path of the image file
+ * @param background_color color of the area not covered by the image, or NULL
+ * @return the unique id of the element, can be later used to remove it
+ ******************************************************************************/
+uint_fast16_t screen_add_img(arena *a, const screen_position position, screen_resize resize_type, const char *file, Color *background_color, char *lua_script) {
+	screen_element_list *list = screen_list();
+	list->count++;
+	REALLOC(new_screen_elements, list->elements, sizeof(screen_element) * list->count);
 
-			ImageResize(image, (int)((float)image->width*factor), (int)((float)image->height*factor));
-			break;
-		case RESIZE_STRETCH:
-			ImageResize(image, max_w, max_h);
-			break;
-		case RESIZE_CROP:
-			ImageResizeCanvas(image, (image->width>=max_w)?max_w:image->width, (image->height>=max_h)?max_h:image->height, 0, 0, (Color){0,0,0,0});
-			break;
-		default:
-			LOG_FATAL("NYI");
+	screen_attrs_img *attr_img = arena_alloc(a, sizeof(screen_attrs_img));
+
+	if( background_color == NULL) {
+		attr_img->background_color = (Color){0,0,0,0};
+	}
+	else {
+		attr_img->background_color = *background_color;
 	}
+	attr_img->file_name = ( file != NULL )?arena_strdup(a, file):NULL;
+	attr_img->resize_type = resize_type;
+	attr_img->texture_id = UINT_FAST32_MAX;
+	attr_img->atlas_slot = UINT_FAST32_MAX;
+
+	list->elements[list->count-1].position = position;
+	list->elements[list->count-1].type = SCREEN_IMG;
+	list->elements[list->count-1].id = get_free_element_id();
+	list->elements[list->count-1].attrs = attr_img;
+	list->elements[list->count-1].box = NULL;
+	list->elements[list->count-1].anim = NULL;
+	list->elements[list->count-1].fill = NULL;
+	list->elements[list->count-1].dirty = SCREEN_DIRTY_ALL;
+	list->elements[list->count-1].visible = true;
+	list->elements[list->count-1].opacity = 1.0f;
+	list->elements[list->count-1].evals = new_evals(a, lua_script);
+
+	LOG_DEBUG("Added screen_element %lu with id %lu", list->count, list->elements[list->count-1].id);
+	return list->elements[list->count-1].id;
 }
 
 /*******************************************************************************
- * Prepares an image file to be displayed
- * This function could be called from a diffrent thread and does all the resize
- * and alignment jobs
- *
- * TODO: error check file
- * TODO: gradient
+ * Add a table to screen elements, its data file is read later by
+ * screen_prepare_table
+ * @param *a the arena of the layout, attributes are allocated from it
+ * @param position position and size of the table
+ * @param *table the attributes of the table, its strings and columns have to
+ * live as long as the arena
+ * @return the unique id of the element, can be later used to remove it
  ******************************************************************************/
-screen_attrs_img *screen_prepare_image(screen_position *position, screen_resize resize_type, char *file, Color *background_color) {
-	LOG_VERBOSE("prepare image »%s«", file);
+uint_fast16_t screen_add_table(arena *a, const screen_position position, const screen_attrs_table *table, char *lua_script) {
+	screen_element_list *list = screen_list();
+	list->count++;
+	REALLOC(new_screen_elements, list->elements, sizeof(screen_element) * list->count);
 
-	// fail if not possible
-	if( file == NULL && ( position->w <= 0 || position->h <= 0 ) ) {
-		LOG_ERROR("Can't prepare image, no file is specified or no size is specified");
-		return NULL;
+	screen_attrs_table *attr_table = arena_alloc(a, sizeof(screen_attrs_table));
+	*attr_table = *table;
+	if( attr_table->font_size == 0 ) {
+		attr_table->font_size = 10;
+	}
+	if( attr_table->row_height == 0 ) {
+		UINT_FAST16_T(attr_table->row_height, attr_table->font_size * 1.5f);
+	}
+	attr_table->font_id = ( table->font_name != NULL )?load_font(table->font_name, attr_table->font_size):UINT_FAST32_MAX;
+	attr_table->keys = arena_alloc(a, sizeof(char *) * table->columns_count);
+	attr_table->header = false;
+	for( uint_fast16_t column = 0; column < table->columns_count; column++ ) {
+		attr_table->keys[column] = table->columns[column].key;
+		attr_table->header |= table->columns[column].title != NULL;
 	}
+	memset(&attr_table->store, 0, sizeof(table_store));
+	attr_table->first_row = 0;
+	attr_table->page_start = -1;
+	attr_table->runs = NULL;
+	attr_table->runs_count = 0;
 
-	screen_attrs_img *attrs;
-	MALLOC(attrs, sizeof(screen_attrs_img));
+	list->elements[list->count-1].position = position;
+	list->elements[list->count-1].type = SCREEN_TABLE;
+	list->elements[list->count-1].id = get_free_element_id();
+	list->elements[list->count-1].attrs = attr_table;
+	list->elements[list->count-1].box = NULL;
+	list->elements[list->count-1].anim = NULL;
+	list->elements[list->count-1].fill = NULL;
+	list->elements[list->count-1].dirty = SCREEN_DIRTY_ALL;
+	list->elements[list->count-1].visible = true;
+	list->elements[list->count-1].opacity = 1.0f;
+	list->elements[list->count-1].evals = new_evals(a, lua_script);
 
-	attrs->texture = NULL;
+	LOG_DEBUG("Added screen_element %lu with id %lu", list->count, list->elements[list->count-1].id);
+	return list->elements[list->count-1].id;
+}
 
-	uint_fast16_t w = 0, h = 0;
-	Image img_src;
-	if( file != NULL ) {
-		img_src = LoadImage(file);
-		UINT_FAST16_T(w, img_src.width);
-		UINT_FAST16_T(h, img_src.height);
-	}
-	w = ( position->w >= 0 )?position->w:w;
-	h = ( position->h >= 0 )?position->h:h;
-	position->w = w;
-	position->h = h;
+/*******************************************************************************
+ * Returns how many rows of a table fit into its element below the header, a
+ * table without height reaches to the bottom of the render area
+ ******************************************************************************/
+uint_fast32_t screen_table_rows(const screen_element *element) {
+	const screen_attrs_table *attr_table = (screen_attrs_table *)element->attrs;
+	int height = ( element->position.h > 0 )?(int)element->position.h:config.render_height - (int)element->position.y;
+	height -= attr_table->header?attr_table->row_height:0;
+	return ( height > 0 )?height / attr_table->row_height:0;
+}
 
-	screen_resize_image(&img_src, resize_type, w, h);
+/*******************************************************************************
+ * Reads the data file of a table element and rasterizes the glyphs of its
+ * header and first page. Could be called from a different thread, as long as
+ * no elements are added or removed meanwhile.
+ * @param *element the table element to prepare
+ ******************************************************************************/
+void screen_prepare_table(screen_element *element) {
+	PROFILE_FUNC();
+	screen_attrs_table *attr_table = (screen_attrs_table *)element->attrs;
+	if( attr_table->file_name == NULL || attr_table->store.columns_count > 0 ) {
+		return;
+	}
+	table_load(&attr_table->store, attr_table->file_name, attr_table->rows_key, attr_table->keys, attr_table->columns_count);
+	if( attr_table->font_id == UINT_FAST32_MAX ) {
+		return;
+	}
+	for( uint_fast16_t column = 0; column < attr_table->columns_count; column++ ) {
+		if( attr_table->columns[column].title != NULL ) {
+			glyph_prepare(attr_table->font_id, attr_table->columns[column].title);
+		}
+	}
+	uint_fast32_t rows = screen_table_rows(element);
+	for( uint_fast32_t row = 0; row < rows && row < attr_table->store.rows_count; row++ ) {
+		for( uint_fast16_t column = 0; column < attr_table->columns_count; column++ ) {
+			glyph_prepare(attr_table->font_id, table_cell(&attr_table->store, row, column));
+		}
+	}
+}
 
-	if( background_color == NULL) {
-		attrs->background_color = (Color){0,0,0,0};
+/*******************************************************************************
+ * Loads the image of an image element and registers it with the vRAM manager,
+ * it's scaled and aligned when drawn. Small images are packed into a shared
+ * atlas page instead. Could be called from a different thread, as long as no
+ * elements are added or removed meanwhile.
+ * @param *element the image element to prepare
+ ******************************************************************************/
+void screen_prepare_img(screen_element *element) {
+	PROFILE_FUNC();
+	screen_attrs_img *attr_img = (screen_attrs_img *)element->attrs;
+	if( attr_img->texture_id != UINT_FAST32_MAX || attr_img->atlas_slot != UINT_FAST32_MAX ) {
+		return;
 	}
-	else {
-		attrs->background_color = (Color){background_color->r, background_color->g, background_color->b, background_color->a};
+	// images without a source only draw their background
+	if( attr_img->file_name == NULL ) {
+		return;
+	}
+	Image image = { 0 };
+	char *fallback_file = NULL;
+	if( config.atlas_max_size > 0 ) {
+		attr_img->atlas_slot = atlas_find(attr_img->file_name);
+		if( attr_img->atlas_slot != UINT_FAST32_MAX ) {
+			return;
+		}
 	}
+	LOG_VERBOSE("prepare image »%s«", attr_img->file_name);
+	image = texture_load(attr_img->file_name, &fallback_file);
+	if( image.data == NULL ) {
+		LOG_ERROR("Failed to load image »%s« of element %lu, using an empty image", attr_img->file_name, element->id);
+		free(fallback_file);
+		fallback_file = NULL;
+		image = GenImageColor(1, 1, (Color){0,0,0,0});
+	}
+	else if( atlas_fits(image) ) {
+		free(fallback_file);
+		attr_img->atlas_slot = atlas_add(attr_img->file_name, image);
+		return;
+	}
+	attr_img->texture_id = vram_add_image(image, fallback_file);
+}
 
-	attrs->image = GenImageColor(position->w, position->h, attrs->background_color);
+/*******************************************************************************
+ * Rasterizes the glyphs of the static text of a text or clock element, so they
+ * aren't rasterized while the first frame is drawn. Clocks get their digits and
+ * the current time. Could be called from a different thread, as long as no
+ * elements are added or removed meanwhile.
+ * @param *element the text or clock element to prepare
+ ******************************************************************************/
+void screen_prepare_text(screen_element *element) {
+	PROFILE_FUNC();
+	screen_attrs_text *attr_text = (screen_attrs_text *)element->attrs;
+	if( attr_text->font_id == UINT_FAST32_MAX ) {
+		return;
+	}
+	if( element->type != SCREEN_CLOCK ) {
+		glyph_prepare(attr_text->font_id, attr_text->text);
+		return;
+	}
+	char str_time[255];
+	time_t now = time(NULL);
+	struct tm tm_local;
+	glyph_prepare(attr_text->font_id, "0123456789");
+	if( localtime_r(&now, &tm_local) != NULL && strftime(str_time, sizeof(str_time), attr_text->text, &tm_local) > 0 ) {
+		glyph_prepare(attr_text->font_id, str_time);
+	}
+}
 
-	uint_fast16_t x = 0, y = 0;
-	switch( position->horizontal ) {
-		case ALIGN_RIGHT:
-			x = w - img_src.width;
-			break;
-		case ALIGN_CENTER:
-		default:
-			x = ( w - img_src.width ) / 2;
-			break;
+/*******************************************************************************
+ * Creates the lua state of an element and compiles its script
+ * @param *element the element with evals
+ ******************************************************************************/
+void screen_compile_lua(screen_element *element) {
+	screen_evals *evals = element->evals;
+	if( evals == NULL || evals->lua_state != NULL ) {
+		return;
 	}
-	switch( position->vertical ) {
-		case ALIGN_BOTTOM:
-			y = h - img_src.height;
-			break;
-		case ALIGN_CENTER:
-		default:
-			y = ( h - img_src.height ) / 2;
-			break;
+	LOG_DEBUG("Init lua state for element id %lu", element->id);
+	evals->lua_state = script_new_state(&evals->lua_binding);
+	if( luaL_loadstring(evals->lua_state, evals->lua_script) != LUA_OK ) {
+		LOG_ERROR("Failed to compile lua script of element %lu: %s", element->id, lua_tostring(evals->lua_state, -1));
+		lua_close(evals->lua_state);
+		element->evals = NULL;
+		return;
 	}
-	ImageDraw(&attrs->image, img_src, (Rectangle){0,0,img_src.width,img_src.height}, (Rectangle){x,y,img_src.width,img_src.height});
+	evals->lua_ref = luaL_ref(evals->lua_state, LUA_REGISTRYINDEX);
+}
 
-	return attrs;
+/*******************************************************************************
+ * Returns all screen elements, the array is only valid until the next element
+ * is added or removed
+ * @param *count is set to the number of elements
+ ******************************************************************************/
+screen_element *screen_get_elements(uint_fast32_t *count) {
+	screen_element_list *list = screen_list();
+	*count = list->count;
+	return list->elements;
 }
 
-uint_fast16_t screen_add_img(const screen_position position, const screen_attrs_img attr_img_in, char *lua_script) {
-	screen_elements_count++;
-	REALLOC(new_screen_elements, screen_elements, sizeof(screen_element) * screen_elements_count);
+/*******************************************************************************
+ * Returns the element with the given id
+ * @return the element, NULL if there is no element with this id
+ ******************************************************************************/
+screen_element *screen_get_element(uint_fast32_t id) {
+	screen_element_list *list = screen_list();
+	for( uint_fast32_t i = 0; i < list->count; i++ ) {
+		if( list->elements[i].id == id ) {
+			return &list->elements[i];
+		}
+	}
+	return NULL;
+}
 
-	screen_attrs_img *attr_img;
-	MALLOC(attr_img, sizeof(screen_attrs_img)); //TODO free
+/*******************************************************************************
+ * Attaches a layout box to an element, the position of the element is written
+ * by the layout pass from then on
+ ******************************************************************************/
+void screen_attach_box(uint_fast32_t id, box *b) {
+	screen_element *element = screen_get_element(id);
+	if( element == NULL ) {
+		LOG_ERROR("Can't attach box to unknown element %lu", id);
+		return;
+	}
+	element->box = b;
+	b->element_id = id;
+}
 
-	attr_img->texture = attr_img_in.texture;
+/*******************************************************************************
+ * Attaches a keyframe animation to an element, it starts with the first frame
+ * the element is drawn in
+ ******************************************************************************/
+void screen_attach_anim(uint_fast32_t id, anim *a) {
+	screen_element *element = screen_get_element(id);
+	if( element == NULL ) {
+		LOG_ERROR("Can't attach animation to unknown element %lu", id);
+		return;
+	}
+	element->anim = a;
+}
 
-	attr_img->background_color = attr_img_in.background_color;
-	if( attr_img_in.file_name != NULL ) {
-		attr_img->file_name = strdup(attr_img_in.file_name);
-		FAIL_ON_NULL(attr_img->file_name, "Failed to copy file name, while adding image to screen elements");
+/*******************************************************************************
+ * Attaches a fill to an element, it's drawn behind the content over the whole
+ * area of the element
+ ******************************************************************************/
+void screen_attach_fill(uint_fast32_t id, fill *f) {
+	screen_element *element = screen_get_element(id);
+	if( element == NULL ) {
+		LOG_ERROR("Can't attach fill to unknown element %lu", id);
+		return;
 	}
-	attr_img->resize_type = attr_img_in.resize_type;
-	attr_img->image = ImageCopy(attr_img_in.image);
+	element->fill = f;
+}
 
-	screen_elements[screen_elements_count-1].position = position;
-	screen_elements[screen_elements_count-1].type = SCREEN_IMG;
-	screen_elements[screen_elements_count-1].id = get_free_element_id();
-	screen_elements[screen_elements_count-1].attrs = attr_img;
+/*******************************************************************************
+ * Sets the box of the whole screen, which is updated before each frame
+ ******************************************************************************/
+void screen_set_root_box(box *b) {
+	screen_root_box = b;
+}
 
-	if( lua_script != NULL ) {
-		MALLOC(screen_elements[screen_elements_count-1].evals, sizeof(screen_evals));
-		screen_elements[screen_elements_count-1].evals->lua_state = NULL;
-		screen_elements[screen_elements_count-1].evals->lua_script = lua_script;
+/*******************************************************************************
+ * Replaces the text of a text element, or the format of a clock
+ ******************************************************************************/
+void screen_set_text(screen_element *element, const char *text) {
+	screen_attrs_text *attr_text = (screen_attrs_text *)element->attrs;
+	if( strcmp(text, attr_text->text) == 0 ) {
+		return;
 	}
-	else {
-		screen_elements[screen_elements_count-1].evals = NULL;
+	char *copy = strdup(text);
+	FAIL_ON_NULL(copy, "Failed to copy text of element %lu", element->id);
+	// the initial text lives in the arena of the layout
+	if( attr_text->text_owned ) {
+		free(attr_text->text);
 	}
+	attr_text->text = copy;
+	attr_text->text_owned = true;
+	element->dirty |= SCREEN_DIRTY_TEXT;
+}
 
-	LOG_DEBUG("Added screen_element %lu with id %lu", screen_elements_count, screen_elements[screen_elements_count-1].id);
-	return screen_elements[screen_elements_count-1].id;
+void screen_set_visible(screen_element *element, bool visible) {
+	if( visible != element->visible ) {
+		element->visible = visible;
+		element->dirty |= SCREEN_DIRTY_STYLE;
+	}
+}
+
+/*******************************************************************************
+ * Directs adding, removing and looking up elements of the calling thread to
+ * another list, used to build a layout while a different one is shown
+ * @param *list the list to work on, NULL for the shown list
+ * @return the list used before
+ ******************************************************************************/
+screen_element_list *screen_build(screen_element_list *list) {
+	screen_element_list *previous = screen_building;
+	screen_building = list;
+	return previous;
+}
+
+/*******************************************************************************
+ * Shows the elements of a list from the next frame on, must be called from the
+ * screen thread or before it starts
+ * @param *list the elements to draw, NULL to draw nothing
+ ******************************************************************************/
+void screen_show(screen_element_list *list) {
+	screen_shown = ( list != NULL )?list:&screen_empty_list;
+}
+
+/*******************************************************************************
+ * Removes all elements of the current list
+ ******************************************************************************/
+void screen_clear_elements() {
+	screen_element_list *list = screen_list();
+	while( list->count > 0 ) {
+		screen_remove_element(list->elements[list->count-1].id);
+	}
+}
+
+/*******************************************************************************
+ * Uploads the textures and fonts of a list which isn't shown yet, so the first
+ * frame showing it doesn't have to. Must be called from the screen thread.
+ ******************************************************************************/
+void screen_upload(screen_element_list *list) {
+	PROFILE_FUNC();
+	Rectangle source;
+	for( uint_fast32_t i = 0; i < list->count; i++ ) {
+		screen_element *element = &list->elements[i];
+		if( element->type == SCREEN_IMG ) {
+			screen_attrs_img *attr_img = (screen_attrs_img *)element->attrs;
+			if( attr_img->atlas_slot != UINT_FAST32_MAX ) {
+				atlas_get_texture(attr_img->atlas_slot, &source);
+			}
+			else if( attr_img->texture_id != UINT_FAST32_MAX ) {
+				vram_get_texture(attr_img->texture_id);
+			}
+		}
+		else if( element->type == SCREEN_TABLE ) {
+			if( ((screen_attrs_table *)element->attrs)->font_id != UINT_FAST32_MAX ) {
+				glyph_upload(((screen_attrs_table *)element->attrs)->font_id);
+			}
+		}
+		else if( ((screen_attrs_text *)element->attrs)->font_id != UINT_FAST32_MAX ) {
+			glyph_upload(((screen_attrs_text *)element->attrs)->font_id);
+		}
+	}
 }
 
 /*******************************************************************************
  * Add text to screen elements
+ * @param *a the arena of the layout, attributes are allocated from it
  * @param position position and size of the text to add to the screen
  * @text text to draw
  * @font_size font size to use
@@ -231,50 +543,51 @@ uint_fast16_t screen_add_img(const screen_position position, const screen_attrs_
  * @color the color which should be used
  * @return the unique id of the element, can be later used to remove it
  ******************************************************************************/
-uint_fast16_t screen_add_text(const screen_position position, const char *text, const uint_fast16_t font_size, const char *font, const Color color, char *lua_script) {
-	screen_elements_count++;
-	REALLOC(new_screen_elements, screen_elements, sizeof(screen_element) * screen_elements_count);
+uint_fast16_t screen_add_text(arena *a, const screen_position position, const char *text, const uint_fast16_t font_size, const char *font, const Color color, char *lua_script) {
+	screen_element_list *list = screen_list();
+	list->count++;
+	REALLOC(new_screen_elements, list->elements, sizeof(screen_element) * list->count);
 
-	screen_attrs_text *attr_text;
-	MALLOC(attr_text, sizeof(screen_attrs_text));
+	screen_attrs_text *attr_text = arena_alloc(a, sizeof(screen_attrs_text));
 
 	if( font_size == 0 ) { attr_text->font_size = 10; }
 	else { attr_text->font_size = font_size; }
 
 	if( font == NULL ) {
-		attr_text->font_id = UINT_FAST16_MAX;
+		attr_text->font_id = UINT_FAST32_MAX;
 		attr_text->font_name = NULL;
 	}
 	else {
-		attr_text->font_id = UINT_FAST16_MAX;
-		attr_text->font_name = strdup(font);
-		FAIL_ON_NULL(attr_text->font_name, "Failed to copy font name, while adding text to screen elements");
+		attr_text->font_name = arena_strdup(a, font);
+		attr_text->font_id = load_font(attr_text->font_name, attr_text->font_size);
 	}
 
 	attr_text->color = color;
-	attr_text->text = strdup(text);
-	FAIL_ON_NULL(attr_text->text, "Failed to copy text, while adding text to screen elements");
-
-	screen_elements[screen_elements_count-1].position = position;
-	screen_elements[screen_elements_count-1].type = SCREEN_TEXT;
-	screen_elements[screen_elements_count-1].id = get_free_element_id();
-	screen_elements[screen_elements_count-1].attrs = attr_text;
+	attr_text->run = arena_alloc(a, sizeof(glyph_run));
+	memset(attr_text->run, 0, sizeof(glyph_run));
+	attr_text->formatted = NULL;
+	attr_text->text = arena_strdup(a, text);
+	attr_text->text_owned = false;
 
-	if( lua_script != NULL ) {
-		MALLOC(screen_elements[screen_elements_count-1].evals, sizeof(screen_evals));
-		screen_elements[screen_elements_count-1].evals->lua_state = NULL;
-		screen_elements[screen_elements_count-1].evals->lua_script = lua_script;
-	}
-	else {
-		screen_elements[screen_elements_count-1].evals = NULL;
-	}
+	list->elements[list->count-1].position = position;
+	list->elements[list->count-1].type = SCREEN_TEXT;
+	list->elements[list->count-1].id = get_free_element_id();
+	list->elements[list->count-1].attrs = attr_text;
+	list->elements[list->count-1].box = NULL;
+	list->elements[list->count-1].anim = NULL;
+	list->elements[list->count-1].fill = NULL;
+	list->elements[list->count-1].dirty = SCREEN_DIRTY_ALL;
+	list->elements[list->count-1].visible = true;
+	list->elements[list->count-1].opacity = 1.0f;
+	list->elements[list->count-1].evals = new_evals(a, lua_script);
 
-	LOG_DEBUG("Added screen_element %lu with id %lu", screen_elements_count, screen_elements[screen_elements_count-1].id);
-	return screen_elements[screen_elements_count-1].id;
+	LOG_DEBUG("Added screen_element %lu with id %lu", list->count, list->elements[list->count-1].id);
+	return list->elements[list->count-1].id;
 }
 
 /*******************************************************************************
  * Add a clock to screen elements
+ * @param *a the arena of the layout, attributes are allocated from it
  * @param position position and size of the text to add to the screen
  * @param format the strftime format string to used, defaults to %H:%M
  * @font_size font size to use
@@ -282,12 +595,12 @@ uint_fast16_t screen_add_text(const screen_position position, const char *text,
  * @color the color which should be used
  * @return the unique id of the element, can be later used to remove it
  ******************************************************************************/
-uint_fast16_t screen_add_clock(const screen_position position, char *format, const uint_fast16_t font_size, const char *font, const Color color, char *lua_script) {
+uint_fast16_t screen_add_clock(arena *a, const screen_position position, const char *format, const uint_fast16_t font_size, const char *font, const Color color, char *lua_script) {
 	if( format == NULL ) {
-		format = strdup("%H:%M");
+		format = "%H:%M";
 	}
-	uint_fast16_t id = screen_add_text(position, format, font_size, font, color, lua_script);
-	screen_elements[screen_elements_count-1].type = SCREEN_CLOCK;
+	uint_fast16_t id = screen_add_text(a, position, format, font_size, font, color, lua_script);
+	screen_get_element(id)->type = SCREEN_CLOCK;
 	return id;
 }
 
@@ -296,18 +609,26 @@ uint_fast16_t screen_add_clock(const screen_position position, char *format, con
  * @element the element to beed drawn
  ******************************************************************************/
 static void draw_text(screen_element *element) {
+	PROFILE_FUNC();
 	screen_attrs_text *attr_text = (screen_attrs_text *)element->attrs;
 
-	Vector2 text_size;
 	uint_fast16_t x, y;
-	if( attr_text->font_name == NULL ) {
-		text_size.x = MeasureText(attr_text->text, attr_text->font_size);
-		text_size.y = attr_text->font_size;
-	}
-	else {
-		if( attr_text->font_id == UINT_FAST16_MAX ) { attr_text->font_id = load_font(attr_text->font_name, attr_text->font_size); }
-		text_size = MeasureTextEx(screen_fonts[attr_text->font_id].font, attr_text->text, (float)attr_text->font_size, 0.0f);
+	if( element->dirty & SCREEN_DIRTY_TEXT ) {
+		if( attr_text->font_name == NULL ) {
+			attr_text->text_size.x = MeasureText(attr_text->text, attr_text->font_size);
+			attr_text->text_size.y = attr_text->font_size;
+		}
+		else {
+			// static text is laid out once, only changed text is laid out again
+			attr_text->text_size = glyph_run_build(attr_text->run, attr_text->font_id, attr_text->text);
+		}
+		if( element->box != NULL ) {
+			box_set_content(element->box, attr_text->text_size.x, attr_text->text_size.y);
+		}
 	}
+	Vector2 text_size = attr_text->text_size;
+	Color color = attr_text->color;
+	color.a = (unsigned char)(color.a * element->opacity);
 
 	x = element->position.x;
 	y = element->position.y;
@@ -336,15 +657,17 @@ static void draw_text(screen_element *element) {
 	}
 
 	if( attr_text->font_name == NULL ) {
-		DrawText(attr_text->text, x, y, attr_text->font_size, attr_text->color);
+		DrawText(attr_text->text, x, y, attr_text->font_size, color);
 	}
 	else {
-		DrawTextEx(screen_fonts[attr_text->font_id].font, attr_text->text, (Vector2){x, y}, (float)attr_text->font_size, 0.0f, attr_text->color);
+		glyph_run_draw(attr_text->run, attr_text->text, (Vector2){x, y}, 0, color);
 	}
 }
 
-static void draw_clock(const screen_element *element) {
-	char *str_format = ((screen_attrs_text *)element->attrs)->text;
+static void draw_clock(screen_element *element) {
+	PROFILE_FUNC();
+	screen_attrs_text *attr_text = (screen_attrs_text *)element->attrs;
+	char *str_format = attr_text->text;
 	char str_time[255];  // TODO: document max formated time size(255 characters)
 	struct tm *tm_local;
 	tm_local = localtime(&screen_update_start.tv_sec);
@@ -352,38 +675,329 @@ static void draw_clock(const screen_element *element) {
 	if( strftime(str_time, sizeof(str_time), str_format, tm_local) <= 0 ) {
 		LOG_FATAL("Failed to format time with strftime »%s«", str_format);
 	}
-	((screen_attrs_text *)element->attrs)->text = str_time;
+	// only measure again if the displayed time changed
+	if( attr_text->formatted == NULL || strcmp(attr_text->formatted, str_time) != 0 ) {
+		free(attr_text->formatted);
+		attr_text->formatted = strdup(str_time);
+		FAIL_ON_NULL(attr_text->formatted, "Failed to copy formatted time");
+		element->dirty |= SCREEN_DIRTY_TEXT;
+	}
+	attr_text->text = attr_text->formatted;
 	draw_text(element);
-	((screen_attrs_text *)element->attrs)->text = str_format;
+	attr_text->text = str_format;
+}
+
+static inline float align_offset(screen_align align, float space) {
+	switch( align ) {
+		case ALIGN_RIGHT:
+		case ALIGN_BOTTOM:
+			return space;
+		default:
+			return space / 2;
+	}
 }
 
-static void draw_img(const screen_element *element) {
+/*******************************************************************************
+ * Draw image from element on screen, the texture is scaled into the size of
+ * the element on the GPU, so animating the size is free
+ * @element the element to be drawn
+ ******************************************************************************/
+static void draw_img(screen_element *element) {
+	PROFILE_FUNC();
 	screen_attrs_img *attr_img = ((screen_attrs_img *)element->attrs);
-	
-	if( attr_img->texture == NULL ) {
-		MALLOC(attr_img->texture, sizeof(Texture2D));  // TODO free
-		*attr_img->texture = LoadTextureFromImage(attr_img->image);
-		LOG_DEBUG("Load image into GPU RAM, element ID %lu", element->id);
+
+	if( attr_img->texture_id == UINT_FAST32_MAX && attr_img->atlas_slot == UINT_FAST32_MAX ) {
+		screen_prepare_img(element);
+	}
+	if( attr_img->texture_id == UINT_FAST32_MAX && attr_img->atlas_slot == UINT_FAST32_MAX ) {
+		if( attr_img->background_color.a > 0 && element->position.w > 0 && element->position.h > 0 ) {
+			Color background = attr_img->background_color;
+			background.a = (unsigned char)(background.a * element->opacity);
+			DrawRectangleRec((Rectangle){ element->position.x, element->position.y, element->position.w, element->position.h }, background);
+		}
+		return;
 	}
 
-	DrawTexture(*attr_img->texture, element->position.x, element->position.y, (Color){255,255,255,255});
+	Texture2D *texture;
+	Rectangle source;
+	if( attr_img->atlas_slot != UINT_FAST32_MAX ) {
+		texture = atlas_get_texture(attr_img->atlas_slot, &source);
+	}
+	else {
+		texture = vram_get_texture(attr_img->texture_id);
+		source = (Rectangle){ 0, 0, texture->width, texture->height };
+	}
+	float image_w = source.width, image_h = source.height;
+	if( element->box != NULL ) {
+		box_set_content(element->box, image_w, image_h);
+	}
+
+	float w = ( element->position.w > 0 )?element->position.w:image_w;
+	float h = ( element->position.h > 0 )?element->position.h:image_h;
+	Rectangle box = { element->position.x, element->position.y, w, h };
+	Rectangle dest = box;
+
+	switch( attr_img->resize_type ) {
+		case RESIZE_PROPER: {
+			float factor = w / image_w;
+			if( h / image_h < factor ) {
+				factor = h / image_h;
+			}
+			dest.width = image_w * factor;
+			dest.height = image_h * factor;
+			break;
+		}
+		case RESIZE_CROP:
+			source.width = dest.width = ( image_w > w )?w:image_w;
+			source.height = dest.height = ( image_h > h )?h:image_h;
+			break;
+		case RESIZE_STRETCH:
+		default:
+			break;
+	}
+	// atlas pages have no mipmaps, they would bleed between the packed images
+	if( config.mipmaps && attr_img->atlas_slot == UINT_FAST32_MAX &&
+			dest.width * dest.height < source.width * source.height * SCREEN_MIPMAP_SCALE * SCREEN_MIPMAP_SCALE ) {
+		vram_request_mipmaps(attr_img->texture_id);
+	}
+	dest.x += align_offset(element->position.horizontal, box.width - dest.width);
+	dest.y += align_offset(element->position.vertical, box.height - dest.height);
+
+	unsigned char alpha = (unsigned char)(255 * element->opacity);
+	if( attr_img->background_color.a > 0 ) {
+		Color background = attr_img->background_color;
+		background.a = (unsigned char)(background.a * element->opacity);
+		DrawRectangleRec(box, background);
+	}
+	DrawTexturePro(*texture, source, dest, (Vector2){ 0, 0 }, 0.0f, (Color){255,255,255,alpha});
 }
 
-static void eval_lua(screen_element *element) {
+/*******************************************************************************
+ * Runs the script of an element, compiles it on first use
+ * @param t seconds of the animation clock, the script gets it as global »t«
+ * @param dt seconds since the last run, the script gets it as global »dt«
+ ******************************************************************************/
+void screen_eval_lua(screen_element *element, double t, double dt) {
+	PROFILE_FUNC();
 	if( element->evals->lua_state == NULL ) {
-		LOG_DEBUG("Init lua state for element id %lu", element->id);
-		element->evals->lua_state = luaL_newstate();
+		screen_compile_lua(element);
+		if( element->evals == NULL ) {
+			return;
+		}
+	}
+	lua_State *L = element->evals->lua_state;
+	lua_pushnumber(L, t);
+	lua_setglobal(L, "t");
+	lua_pushnumber(L, dt);
+	lua_setglobal(L, "dt");
+	script_bind(element->evals->lua_binding, element);
+	lua_rawgeti(L, LUA_REGISTRYINDEX, element->evals->lua_ref);
+	if( lua_pcall(L, 0, 0, 0) != LUA_OK ) {
+		LOG_ERROR("Failed to run lua script of element %lu: %s", element->id, lua_tostring(L, -1));
+	}
+	script_unbind(element->evals->lua_binding);
+	LUA_CLEAN_STACK(L);
+}
+
+static inline void screen_position_components(screen_element *element, uint_fast16_t *components[4]) {
+	components[0] = &element->position.x;
+	components[1] = &element->position.y;
+	components[2] = &element->position.w;
+	components[3] = &element->position.h;
+}
+
+/*******************************************************************************
+ * Runs one fixed tick of a script. The script sees the position it set in the
+ * tick before, not the interpolated one, and the components it changes are
+ * interpolated from the old to the new value until the next tick.
+ ******************************************************************************/
+static void screen_tick_lua(screen_element *element, double t, double dt) {
+	uint_fast16_t *components[4];
+	screen_position_components(element, components);
+	screen_evals *evals = element->evals;
+	for( uint_fast8_t i = 0; i < 4; i++ ) {
+		if( evals->moved & (1 << i) ) {
+			UINT_FAST16_T(*components[i], evals->to[i]);
+		}
+		evals->from[i] = *components[i];
+	}
+	screen_eval_lua(element, t, dt);
+	if( element->evals == NULL ) {
+		return;
+	}
+	evals->moved = 0;
+	for( uint_fast8_t i = 0; i < 4; i++ ) {
+		evals->to[i] = *components[i];
+		if( evals->to[i] != evals->from[i] ) {
+			evals->moved |= 1 << i;
+		}
+	}
+}
+
+/*******************************************************************************
+ * Places an element between the positions of its last two script ticks
+ * @param alpha progress from the last tick to the next one, 0 to 1
+ ******************************************************************************/
+static void screen_interpolate(screen_element *element, float alpha) {
+	screen_evals *evals = element->evals;
+	if( evals->moved == 0 ) {
+		return;
+	}
+	uint_fast16_t *components[4];
+	screen_position_components(element, components);
+	for( uint_fast8_t i = 0; i < 4; i++ ) {
+		if( !( evals->moved & (1 << i) ) ) {
+			continue;
+		}
+		uint_fast16_t old = *components[i];
+		UINT_FAST16_T(*components[i], roundf(evals->from[i] + ( evals->to[i] - evals->from[i] ) * alpha));
+		if( *components[i] != old ) {
+			element->dirty |= SCREEN_DIRTY_POSITION;
+		}
+	}
+}
+
+/*******************************************************************************
+ * Runs the scripts at the configured tick rate, independent of the frame rate.
+ * Ticks missed since the last frame are caught up, up to SCREEN_MAX_TICKS.
+ * Without a tick rate the scripts run once per frame.
+ ******************************************************************************/
+static void screen_run_scripts(screen_element_list *list, double frame_dt) {
+	if( config.script_tick_rate <= 0 ) {
+		for( uint_fast32_t i = 0; i < list->count; i++ ) {
+			if( list->elements[i].evals != NULL ) {
+				screen_eval_lua(&list->elements[i], screen_anim_clock, frame_dt);
+			}
+		}
+		return;
+	}
+	double step = 1.0 / config.script_tick_rate;
+	for( uint_fast8_t tick = 0; tick < SCREEN_MAX_TICKS && screen_script_next <= screen_anim_clock; tick++ ) {
+		for( uint_fast32_t i = 0; i < list->count; i++ ) {
+			if( list->elements[i].evals != NULL ) {
+				screen_tick_lua(&list->elements[i], screen_script_next, step);
+			}
+		}
+		screen_script_next += step;
+	}
+	if( screen_script_next <= screen_anim_clock ) {
+		LOG_DEBUG("Scripts are %.0f ms behind, dropping ticks", ( screen_anim_clock - screen_script_next ) * 1000);
+		screen_script_next = screen_anim_clock + step;
+	}
+	float alpha = 1.0f - (float)( ( screen_script_next - screen_anim_clock ) / step );
+	alpha = ( alpha < 0 )?0:( alpha > 1 )?1:alpha;
+	for( uint_fast32_t i = 0; i < list->count; i++ ) {
+		if( list->elements[i].evals != NULL ) {
+			screen_interpolate(&list->elements[i], alpha);
+		}
+	}
+}
+
+/*******************************************************************************
+ * Grows the glyph runs of a table to the cells of a page, the runs of the rows
+ * are laid out again after the page changed
+ ******************************************************************************/
+static void screen_table_runs(screen_attrs_table *attr_table, uint_fast32_t count, bool page_changed) {
+	if( count > attr_table->runs_count ) {
+		REALLOC(new_runs, attr_table->runs, sizeof(glyph_run) * count);
+		memset(attr_table->runs + attr_table->runs_count, 0, sizeof(glyph_run) * ( count - attr_table->runs_count ));
+		for( uint_fast32_t i = attr_table->runs_count; i < count; i++ ) {
+			attr_table->runs[i].font_id = attr_table->font_id;
+		}
+		attr_table->runs_count = count;
+	}
+	if( page_changed ) {
+		for( uint_fast32_t i = attr_table->header?attr_table->columns_count:0; i < attr_table->runs_count; i++ ) {
+			attr_table->runs[i].built = false;
+		}
+	}
+}
+
+/*******************************************************************************
+ * Draws the text of a cell, cut at the width of its column
+ * @param width of the column, 0 if it's not limited
+ ******************************************************************************/
+static void draw_table_cell(screen_attrs_table *attr_table, uint_fast32_t run, const char *text, Vector2 position, float width, Color color) {
+	if( text[0] == '\0' ) {
+		return;
+	}
+	if( attr_table->font_id == UINT_FAST32_MAX ) {
+		// the same size and spacing as DrawText()
+		int size = ( attr_table->font_size > 10 )?attr_table->font_size:10;
+		glyph_draw_default(text, position, size, size / 10, width, color);
+		return;
+	}
+	glyph_run_draw(&attr_table->runs[run], text, position, width, color);
+}
+
+/*******************************************************************************
+ * Draws the page of rows of a table shown, the pages follow each other every
+ * page interval of the animation clock. Only the rows of the page are drawn,
+ * so the cost doesn't depend on the size of the data file.
+ * @element the element to be drawn
+ ******************************************************************************/
+static void draw_table(screen_element *element) {
+	PROFILE_FUNC();
+	screen_attrs_table *attr_table = (screen_attrs_table *)element->attrs;
+	uint_fast32_t rows = screen_table_rows(element);
+	bool page_changed = false;
+	if( attr_table->page_start < 0 ) {
+		attr_table->page_start = screen_anim_clock;
+	}
+	else if( rows > 0 && attr_table->page_interval > 0 && screen_anim_clock - attr_table->page_start >= attr_table->page_interval ) {
+		attr_table->first_row += rows;
+		if( attr_table->first_row >= attr_table->store.rows_count ) {
+			attr_table->first_row = 0;
+		}
+		attr_table->page_start = screen_anim_clock;
+		page_changed = true;
+	}
+	uint_fast32_t lines = rows + ( attr_table->header?1:0 );
+	if( attr_table->font_id != UINT_FAST32_MAX ) {
+		screen_table_runs(attr_table, lines * attr_table->columns_count, page_changed);
+	}
+
+	Color color = attr_table->color;
+	color.a = (unsigned char)(color.a * element->opacity);
+	Color header_color = attr_table->header_color;
+	header_color.a = (unsigned char)(header_color.a * element->opacity);
+
+	// columns without a width share what the others leave, ten characters each without an element width
+	float fixed = 0;
+	uint_fast16_t shared = 0;
+	for( uint_fast16_t column = 0; column < attr_table->columns_count; column++ ) {
+		screen_table_column *c = &attr_table->columns[column];
+		float width = c->relative?c->width * element->position.w / 100.0f:c->width;
+		fixed += width;
+		shared += ( width <= 0 );
+	}
+	float share = ( element->position.w == 0 )?attr_table->font_size * 10.0f:
+		( shared > 0 && element->position.w > fixed )?( element->position.w - fixed ) / shared:0;
+
+	Vector2 position = { element->position.x, element->position.y };
+	for( uint_fast16_t column = 0; column < attr_table->columns_count; column++ ) {
+		screen_table_column *c = &attr_table->columns[column];
+		float width = c->relative?c->width * element->position.w / 100.0f:c->width;
+		width = ( width > 0 )?width:share;
+		if( width <= 0 ) {
+			continue;  // a shared column the others left no room for
+		}
+		uint_fast32_t line = 0;
+		position.y = element->position.y;
+		if( attr_table->header ) {
+			if( c->title != NULL ) {
+				draw_table_cell(attr_table, column, c->title, position, width, header_color);
+			}
+			position.y += attr_table->row_height;
+			line++;
+		}
+		for( uint_fast32_t row = attr_table->first_row; row < attr_table->first_row + rows && row < attr_table->store.rows_count; row++ ) {
+			draw_table_cell(attr_table, line * attr_table->columns_count + column, table_cell(&attr_table->store, row, column), position, width, color);
+			position.y += attr_table->row_height;
+			line++;
+		}
+		position.x += width;
 	}
-	LUA_SET_NUMBER(element->evals->lua_state, "x", element->position.x);
-	LUA_SET_NUMBER(element->evals->lua_state, "y", element->position.y);
-	LUA_SET_NUMBER(element->evals->lua_state, "w", element->position.w);
-	LUA_SET_NUMBER(element->evals->lua_state, "h", element->position.h);
-	luaL_dostring(element->evals->lua_state, element->evals->lua_script);
-	LUA_GET_NUMBER(element->evals->lua_state, "x", element->position.x, uint_fast16_t);
-	LUA_GET_NUMBER(element->evals->lua_state, "y", element->position.y, uint_fast16_t);
-	LUA_GET_NUMBER(element->evals->lua_state, "w", element->position.w, uint_fast16_t);
-	LUA_GET_NUMBER(element->evals->lua_state, "h", element->position.h, uint_fast16_t);
-	LUA_CLEAN_STACK(element->evals->lua_state);
 }
 
 /*******************************************************************************
@@ -391,10 +1005,8 @@ static void eval_lua(screen_element *element) {
  * @param i the index of the screen element to draw
  ******************************************************************************/
 static void draw_element(screen_element *element) {
-//static screen_element *screen_elements;
-//static uint_fast32_t screen_elements_count;
-	if( element->evals != NULL ) {
-		eval_lua(element);
+	if( element->fill != NULL && element->position.w > 0 && element->position.h > 0 ) {
+		fill_draw(element->fill, (Rectangle){ element->position.x, element->position.y, element->position.w, element->position.h }, element->opacity);
 	}
 	switch( element->type ) {
 		case SCREEN_TEXT:
@@ -406,9 +1018,216 @@ static void draw_element(screen_element *element) {
 		case SCREEN_IMG:
 			draw_img(element);
 			break;
+		case SCREEN_TABLE:
+			draw_table(element);
+			break;
 		default:
 			LOG_ERROR("Requested to draw unknown element type %u", element->type);
 	}
+	element->dirty = 0;
+}
+
+/*******************************************************************************
+ * Returns the area an element draws into, as long as it's known without
+ * drawing it. Text measured for a different text or wider than its element
+ * could overflow, so it's unknown.
+ * @return false if the area isn't known
+ ******************************************************************************/
+static bool screen_bounds(screen_element *element, Rectangle *rect) {
+	// cells of tables aren't measured
+	if( element->type == SCREEN_TABLE || element->position.w == 0 || element->position.h == 0 || ( element->dirty & SCREEN_DIRTY_TEXT ) ) {
+		return false;
+	}
+	if( element->type != SCREEN_IMG ) {
+		Vector2 text_size = ((screen_attrs_text *)element->attrs)->text_size;
+		if( text_size.x > element->position.w || text_size.y > element->position.h ) {
+			return false;
+		}
+	}
+	*rect = (Rectangle){ element->position.x, element->position.y, element->position.w, element->position.h };
+	return true;
+}
+
+/*******************************************************************************
+ * Images with an opaque background and elements with an opaque square fill
+ * cover their whole area
+ ******************************************************************************/
+static bool screen_is_occluder(screen_element *element) {
+	if( !element->visible || element->opacity < 1.0f || element->position.w == 0 || element->position.h == 0 ) {
+		return false;
+	}
+	fill *f = element->fill;
+	if( f != NULL && f->radius == 0 && f->from.a == 255 && ( f->type == FILL_SOLID || f->to.a == 255 ) &&
+			( f->border_width == 0 || f->border_color.a == 255 ) ) {
+		return true;
+	}
+	return element->type == SCREEN_IMG && ((screen_attrs_img *)element->attrs)->background_color.a == 255;
+}
+
+static inline uint_fast32_t screen_grid_cell(uint_fast32_t x, uint_fast32_t y) {
+	uint_fast32_t columns = ( config.render_width + SCREEN_GRID_CELL - 1 ) / SCREEN_GRID_CELL;
+	return y / SCREEN_GRID_CELL * columns + x / SCREEN_GRID_CELL;
+}
+
+/*******************************************************************************
+ * Sorts the occluders of a list into a uniform grid over the render area, each
+ * one into all cells it overlaps. Buffers are only grown, so this doesn't
+ * allocate in a steady frame.
+ ******************************************************************************/
+static void screen_build_grid(screen_element_list *list) {
+	PROFILE_FUNC();
+	uint_fast32_t columns = ( config.render_width + SCREEN_GRID_CELL - 1 ) / SCREEN_GRID_CELL;
+	uint_fast32_t rows = ( config.render_height + SCREEN_GRID_CELL - 1 ) / SCREEN_GRID_CELL;
+	uint_fast32_t cells = columns * rows;
+	if( cells + 1 > screen_grid_cells ) {
+		screen_grid_cells = cells + 1;
+		REALLOC(new_grid_start, screen_grid_start, sizeof(uint_fast32_t) * screen_grid_cells);
+	}
+	memset(screen_grid_start, 0, sizeof(uint_fast32_t) * ( cells + 1 ));
+
+	// count the occluders per cell, then turn the counts into offsets
+	for( uint_fast32_t pass = 0; pass < 2; pass++ ) {
+		for( uint_fast32_t i = 0; i < list->count; i++ ) {
+			screen_element *element = &list->elements[i];
+			if( !screen_is_occluder(element) || element->position.x >= config.render_width || element->position.y >= config.render_height ) {
+				continue;
+			}
+			uint_fast32_t right = element->position.x + element->position.w - 1;
+			uint_fast32_t bottom = element->position.y + element->position.h - 1;
+			right = ( right < (uint_fast32_t)config.render_width )?right:(uint_fast32_t)config.render_width - 1;
+			bottom = ( bottom < (uint_fast32_t)config.render_height )?bottom:(uint_fast32_t)config.render_height - 1;
+			for( uint_fast32_t y = element->position.y / SCREEN_GRID_CELL; y <= bottom / SCREEN_GRID_CELL; y++ ) {
+				for( uint_fast32_t x = element->position.x / SCREEN_GRID_CELL; x <= right / SCREEN_GRID_CELL; x++ ) {
+					if( pass == 0 ) {
+						screen_grid_start[y * columns + x + 1]++;
+					}
+					else {
+						screen_grid_items[screen_grid_start[y * columns + x]++] = i;
+					}
+				}
+			}
+		}
+		if( pass == 0 ) {
+			for( uint_fast32_t c = 0; c < cells; c++ ) {
+				screen_grid_start[c+1] += screen_grid_start[c];
+			}
+			if( screen_grid_start[cells] > screen_grid_capacity ) {
+				screen_grid_capacity = screen_grid_start[cells];
+				REALLOC(new_grid_items, screen_grid_items, sizeof(uint_fast32_t) * screen_grid_capacity);
+			}
+		}
+	}
+	// filling moved each start to the end of its cell, which is the start of the next one
+	memmove(screen_grid_start + 1, screen_grid_start, sizeof(uint_fast32_t) * cells);
+	screen_grid_start[0] = 0;
+}
+
+/*******************************************************************************
+ * Tests if an element can't be seen, because it's outside of the render area
+ * or inside of an opaque image drawn after it. An occluder containing the
+ * element contains its top left corner, so only that cell is searched.
+ * @param index the index of the element in the list
+ ******************************************************************************/
+static bool screen_is_culled(screen_element_list *list, uint_fast32_t index) {
+	Rectangle rect;
+	if( !screen_bounds(&list->elements[index], &rect) ) {
+		return false;
+	}
+	if( rect.x >= config.render_width || rect.y >= config.render_height ) {
+		screen_culled.offscreen++;
+		return true;
+	}
+	uint_fast32_t cell = screen_grid_cell(rect.x, rect.y);
+	for( uint_fast32_t i = screen_grid_start[cell]; i < screen_grid_start[cell+1]; i++ ) {
+		uint_fast32_t above = screen_grid_items[i];
+		screen_position *cover = &list->elements[above].position;
+		if( above > index && cover->x <= rect.x && cover->y <= rect.y &&
+				cover->x + cover->w >= rect.x + rect.width && cover->y + cover->h >= rect.y + rect.height ) {
+			screen_culled.occluded++;
+			return true;
+		}
+	}
+	return false;
+}
+
+/*******************************************************************************
+ * Lays out and draws all shown elements into the current target. Animations
+ * and scripts run first, they may move or hide elements, then only what can be
+ * seen is drawn.
+ * @param advance false draws the elements as they are, without running
+ *        animations and scripts
+ ******************************************************************************/
+static void draw_scene(bool advance) {
+	screen_element_list *list = screen_shown;
+	box_update(screen_root_box);
+	ClearBackground(screen_background_color);
+	if( screen_background_fill != NULL ) {
+		fill_draw(screen_background_fill, (Rectangle){ 0, 0, config.render_width, config.render_height }, 1.0f);
+	}
+
+	if( advance ) {
+		double now = GetTime();
+		double frame_dt = 0;
+		if( !control_is_paused() ) {
+			frame_dt = now - screen_anim_last;
+			screen_anim_clock += frame_dt;
+		}
+		screen_anim_last = now;
+		if( !control_is_paused() ) {
+			PROFILE_ZONE("animations");
+			for( uint_fast32_t i = 0; i < list->count; i++ ) {
+				if( list->elements[i].anim != NULL ) {
+					anim_apply(list->elements[i].anim, &list->elements[i], screen_anim_clock);
+				}
+			}
+		}
+		if( !control_is_paused() ) {
+			PROFILE_ZONE("scripts");
+			screen_run_scripts(list, frame_dt);
+		}
+	}
+	screen_build_grid(list);
+
+	PROFILE_ZONE("elements");
+	screen_culled = (screen_cull_stats){ 0 };
+	for( uint_fast32_t i = 0; i < list->count; i++ ) {
+		screen_element *element = &list->elements[i];
+		// hidden and culled elements keep their flags, so changes are picked up once they're drawn
+		if( !element->visible || screen_is_culled(list, i) ) {
+			continue;
+		}
+		draw_element(element);
+		screen_culled.drawn++;
+	}
+}
+
+/*******************************************************************************
+ * Returns how many elements were drawn and culled in the last frame
+ ******************************************************************************/
+screen_cull_stats screen_get_cull_stats() {
+	return screen_culled;
+}
+
+/*******************************************************************************
+ * Swaps in a scheduled layout once it's due, the last frame of the layout shown
+ * before is kept in fade to blend it out
+ * @return true if the layout was swapped and fade holds the old frame
+ ******************************************************************************/
+static bool swap_layout(RenderTexture2D fade) {
+	layout *next = schedule_poll();
+	if( next == NULL ) {
+		return false;
+	}
+	pthread_mutex_lock( &mutex_look );
+	if( fade.id != 0 ) {
+		// the old layout as shown in the last frame, it must not advance a second time
+		BeginTextureMode(fade);
+		draw_scene(false);
+		EndTextureMode();
+	}
+	layout_unload(layout_swap(next));
+	pthread_mutex_unlock( &mutex_look );
+	return fade.id != 0;
 }
 
 /*******************************************************************************
@@ -416,24 +1235,89 @@ static void draw_element(screen_element *element) {
  ******************************************************************************/
 void *screen(void *_) {
 //	SetConfigFlags(FLAG_SHOW_LOGO | FLAG_WINDOW_TRANSPARENT);
+	if( do_bench ) {
+		// measure the cost of a frame, not the frame rate limit
+		SetConfigFlags(FLAG_WINDOW_HIDDEN);
+	}
 	InitWindow(config.width, config.height, "info_screen");
-	SetTargetFPS(config.fps+1);
+	SetTargetFPS(do_bench?0:config.fps+1);
 
 	LOG_DEBUG("InfoScreen window initiated");
+	startup_phase_done(STARTUP_WINDOW);
+
+	vram_upload_all();
+	startup_phase_done(STARTUP_UPLOAD);
+
+	// layouts are drawn at the internal resolution and upscaled in one pass
+	bool scaled = config.render_width != config.width || config.render_height != config.height;
+	RenderTexture2D target = { 0 };
+	if( scaled ) {
+		target = LoadRenderTexture(config.render_width, config.render_height);
+		SetTextureFilter(target.texture, config.scale_filter);
+		LOG_INFO("Rendering at %dx%d, scaled to %dx%d", config.render_width, config.render_height, config.width, config.height);
+	}
+	Rectangle target_source = { 0, 0, config.render_width, -config.render_height };  // render textures are flipped
+	Rectangle target_dest = { 0, 0, config.width, config.height };
+	mirror_init(config.render_width, config.render_height);
+	fill_init();
+	RenderTexture2D fade = { 0 };
+	if( config.schedule_fade > 0 ) {
+		fade = LoadRenderTexture(config.render_width, config.render_height);
+	}
+	double fade_start = -config.schedule_fade;
+	bool first_frame = true;
+	control_init();
+	screen_anim_last = GetTime();  // startup doesn't count as animation time
 
 	while (!WindowShouldClose() && !do_stop) {
+		PROFILE_ZONE("frame");
+		if( do_bench ) {
+			bench_frame_begin();
+		}
+		pthread_mutex_lock( &mutex_look );
+		control_poll();
+		pthread_mutex_unlock( &mutex_look );
+		// while paused reloads and scheduled layouts wait for the resume
+		if( !control_is_paused() && swap_layout(fade) ) {
+			fade_start = GetTime();
+		}
 		BeginDrawing();
 		gettimeofday(&screen_update_start, NULL);
+		vram_next_frame();
+		if( scaled ) {
+			BeginTextureMode(target);
+		}
 		pthread_mutex_lock( &mutex_look );
 
-			ClearBackground(screen_background_color);
-
-			for( uint_fast32_t i = 0; i < screen_elements_count; i++ ) {
-				draw_element(&screen_elements[i]);
-			}
+			draw_scene(true);
 
 		pthread_mutex_unlock( &mutex_look );
-		EndDrawing();
+		double fading = GetTime() - fade_start;
+		if( fading < config.schedule_fade ) {
+			DrawTexturePro(fade.texture, target_source, (Rectangle){ 0, 0, config.render_width, config.render_height },
+					(Vector2){ 0, 0 }, 0, Fade(WHITE, 1.0f - fading / config.schedule_fade));
+		}
+		if( scaled ) {
+			EndTextureMode();
+			mirror_capture(target.id);
+			PROFILE_ZONE("upscale");
+			DrawTexturePro(target.texture, target_source, target_dest, (Vector2){ 0, 0 }, 0, WHITE);
+		}
+		else {
+			mirror_capture(0);
+		}
+		{
+			PROFILE_ZONE("EndDrawing");
+			EndDrawing();
+		}
+
+		if( first_frame ) {
+			startup_phase_done(STARTUP_FIRST_FRAME);
+			first_frame = false;
+		}
+		if( do_bench && bench_frame_end() ) {
+			do_stop = true;
+		}
 
 		int fps = GetFPS();
 		if( fps < config.fps - MAX_LOST_FPS ) {
@@ -441,7 +1325,27 @@ void *screen(void *_) {
 		}
 	}
 
+	control_close();
+	vram_log_stats();
+	atlas_log_stats();
+	glyph_cache_save();
+	glyph_log_stats();
+	mirror_close();
+	fill_close();
+	if( scaled ) {
+		UnloadRenderTexture(target);
+	}
+	if( fade.id != 0 ) {
+		UnloadRenderTexture(fade);
+	}
+	schedule_deinit();
+	layout_deinit();
+	vram_unload_all();
 	CloseWindow();
+	PROFILE_FINISH();
 
+	if( do_bench ) {
+		exit(bench_report()?EXIT_SUCCESS:EXIT_FAILURE);
+	}
 	pthread_exit(NULL);
 }
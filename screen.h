@@ -6,6 +6,18 @@
 #define MAX_LOST_FPS 5
 #endif
 
+#ifndef SCREEN_MIPMAP_SCALE
+#define SCREEN_MIPMAP_SCALE 0.75  // request mipmaps for images drawn smaller than this
+#endif
+
+#ifndef SCREEN_GRID_CELL
+#define SCREEN_GRID_CELL 64  // pixels, cell size of the grid occluders are looked up in
+#endif
+
+#ifndef SCREEN_MAX_TICKS
+#define SCREEN_MAX_TICKS 4  // script ticks caught up per frame, ticks further behind are dropped
+#endif
+
 
 #include <pthread.h>
 #include <raylib.h>
@@ -21,12 +33,30 @@
 #include "log.h"
 #include "config.h"
 #include "main.h"
+#include "vram.h"
+#include "startup.h"
+#include "mirror.h"
+#include "box.h"
+#include "arena.h"
+#include "layout.h"
+#include "script.h"
+#include "bench.h"
+#include "texture.h"
+#include "atlas.h"
+#include "glyph.h"
+#include "anim.h"
+#include "fill.h"
+#include "table.h"
+#include "schedule.h"
+#include "control.h"
+#include "profile.h"
 
 
 typedef enum {
 	SCREEN_TEXT,
 	SCREEN_CLOCK,
 	SCREEN_IMG,
+	SCREEN_TABLE,
 } screen_element_type;
 
 typedef enum {
@@ -45,30 +75,76 @@ typedef enum {
 } screen_resize;
 
 
+typedef enum {
+	SCREEN_DIRTY_POSITION = 1,
+	SCREEN_DIRTY_TEXT     = 2,  // text has to be measured again
+	SCREEN_DIRTY_STYLE    = 4,  // color, visibility or opacity
+	SCREEN_DIRTY_ALL      = 7,
+} screen_dirty;
+
+
 typedef struct screen_position {
 	uint_fast16_t x, y, w, h;
 	screen_align horizontal, vertical;
 } screen_position;
 
+struct glyph_run;
+
 typedef struct screen_attrs_text {
 	uint_fast16_t font_size;
-	uint_fast16_t font_id;
+	uint_fast32_t font_id;  // glyph cache handle, UINT_FAST32_MAX for the default font
 	char *font_name;
 	char *text;
+	bool text_owned;   // text was replaced by a script and is on the heap
+	char *formatted;   // last formatted time of clocks, NULL for texts
+	Vector2 text_size; // measured size, valid unless SCREEN_DIRTY_TEXT is set
+	struct glyph_run *run;  // laid out text, valid unless SCREEN_DIRTY_TEXT is set
 	Color color;
 } screen_attrs_text;
 
 typedef struct screen_attrs_img {
-	Image image;
 	screen_resize resize_type;
 	Color background_color;
 	char *file_name;
-	Texture2D *texture;
+	uint_fast32_t texture_id;  // vRAM handle
+	uint_fast32_t atlas_slot;  // slot of small images packed into an atlas page, UINT_FAST32_MAX if none
 } screen_attrs_img;
 
+typedef struct screen_table_column {
+	char *key;       // of the value in each row
+	char *title;     // shown in the header row, NULL if none
+	float width;     // 0 to share the width left by the other columns
+	bool relative;   // width is a percentage of the element width
+} screen_table_column;
+
+typedef struct screen_attrs_table {
+	char *file_name;
+	char *rows_key;               // key of the rows array in the data file, NULL if it's the top level
+	screen_table_column *columns;
+	char **keys;                  // key of each column
+	uint_fast16_t columns_count;
+	bool header;                  // a column has a title
+	uint_fast16_t font_size;
+	char *font_name;
+	uint_fast32_t font_id;        // glyph cache handle, UINT_FAST32_MAX for the default font
+	Color color;
+	Color header_color;
+	uint_fast16_t row_height;
+	float page_interval;          // seconds each page of rows is shown
+	table_store store;            // filled by screen_prepare_table
+	uint_fast32_t first_row;      // of the page shown
+	double page_start;            // animation clock the page was shown at, negative before the first frame
+	struct glyph_run *runs;       // laid out cells of the page, the header first
+	uint_fast32_t runs_count;
+} screen_attrs_table;
+
 typedef struct screen_evals {
 	char *lua_script;
 	lua_State *lua_state;
+	int lua_ref;  // compiled script in the registry of lua_state
+	struct script_binding *lua_binding;  // userdata the script accesses as »element«
+	float from[4], to[4];  // x, y, w, h before and after the last tick
+	uint_fast8_t moved;    // bits of the components the last tick changed, interpolated until the next one
 } screen_evals;
 
 typedef struct screen_attr_slide {
@@ -76,14 +152,35 @@ typedef struct screen_attr_slide {
 	char *name;
 } screen_attr_slide;
 
+struct box;
+struct anim;
+struct fill;
+
 typedef struct screen_element {
 	uint_fast32_t id;
 	screen_element_type type;
 	screen_position position;
 	void *attrs;
 	screen_evals *evals;
+	struct box *box;  // layout box the position is resolved from, NULL if none
+	struct anim *anim;  // keyframe animation applied before each frame, NULL if none
+	struct fill *fill;  // drawn behind the content, NULL if none
+	uint_fast8_t dirty;  // screen_dirty flags, cleared after the element is drawn
+	bool visible;
+	float opacity;
 } screen_element;
 
+typedef struct screen_element_list {
+	screen_element *elements;
+	uint_fast32_t count;
+} screen_element_list;
+
+typedef struct screen_cull_stats {
+	uint_fast32_t drawn;
+	uint_fast32_t offscreen;  // outside of the render area
+	uint_fast32_t occluded;   // covered by an opaque image above
+} screen_cull_stats;
+
 typedef struct type_frame {
 	char *name;
 	uint_fast32_t element_id;  // UINT_FAST32_MAX for slides or dummy data
@@ -93,15 +190,35 @@ typedef struct type_frame {
 
 struct timeval screen_update_start;
 Color screen_background_color;
+struct fill *screen_background_fill;  // drawn over the background color, NULL if none
 Color screen_default_color;
 
 
 void *screen(void *_);
-uint_fast16_t screen_add_clock(const screen_position position, char *format, const uint_fast16_t font_size, const char *font, const Color color, char *lua_script);
-uint_fast16_t screen_add_text(const screen_position position, const char *text, const uint_fast16_t font_size, const char *font, Color color, char *lua_script);
-void screen_remove_element(uint_fast16_t element_id);
-screen_attrs_img *screen_prepare_image(screen_position *position, screen_resize resize_type, char *file, Color *background_color);
-uint_fast16_t screen_add_img(const screen_position position, const screen_attrs_img img, char *lua_script);
+uint_fast16_t screen_add_clock(arena *a, const screen_position position, const char *format, const uint_fast16_t font_size, const char *font, const Color color, char *lua_script);
+uint_fast16_t screen_add_text(arena *a, const screen_position position, const char *text, const uint_fast16_t font_size, const char *font, Color color, char *lua_script);
+void screen_remove_element(uint_fast32_t element_id);
+uint_fast16_t screen_add_img(arena *a, const screen_position position, screen_resize resize_type, const char *file, Color *background_color, char *lua_script);
+uint_fast16_t screen_add_table(arena *a, const screen_position position, const screen_attrs_table *table, char *lua_script);
+void screen_prepare_img(screen_element *element);
+void screen_prepare_text(screen_element *element);
+void screen_prepare_table(screen_element *element);
+uint_fast32_t screen_table_rows(const screen_element *element);
+void screen_compile_lua(screen_element *element);
+void screen_eval_lua(screen_element *element, double t, double dt);
+screen_element *screen_get_elements(uint_fast32_t *count);
+screen_element *screen_get_element(uint_fast32_t id);
+void screen_attach_box(uint_fast32_t id, struct box *box);
+void screen_attach_anim(uint_fast32_t id, struct anim *a);
+void screen_attach_fill(uint_fast32_t id, struct fill *f);
+void screen_set_root_box(struct box *box);
+void screen_set_text(screen_element *element, const char *text);
+void screen_set_visible(screen_element *element, bool visible);
+screen_element_list *screen_build(screen_element_list *list);
+void screen_show(screen_element_list *list);
+void screen_clear_elements();
+void screen_upload(screen_element_list *list);
+screen_cull_stats screen_get_cull_stats();
 
 
 #endif
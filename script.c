@@ -0,0 +1,342 @@
+#include "script.h"
+
+static const char *TOPIC = "script";
+
+
+#ifdef USE_LUAJIT
+static const char *script_ffi_setup =
+	"local ffi = require('ffi')\n"
+	"ffi.cdef('typedef struct script_data {" SCRIPT_XSTR(SCRIPT_DATA_FIELDS) "} script_data;')\n"
+	"element_data = ffi.cast('script_data *', ...)\n";
+#endif
+
+// the libraries opened for scripts, see script_new_state
+static const luaL_Reg script_libs[] = {
+	{ "_G", luaopen_base },
+	{ LUA_MATHLIBNAME, luaopen_math },
+	{ LUA_STRLIBNAME, luaopen_string },
+	{ LUA_TABLIBNAME, luaopen_table },
+#ifdef USE_LUAJIT
+	{ LUA_JITLIBNAME, luaopen_jit },  // turns the compiler on
+	{ LUA_LOADLIBNAME, luaopen_package },
+	{ LUA_FFILIBNAME, luaopen_ffi },
+#endif
+	{ NULL, NULL }
+};
+
+
+static screen_element *script_check_element(lua_State *L, int index) {
+	script_binding *binding = luaL_checkudata(L, index, SCRIPT_ELEMENT_META);
+	if( binding->element == NULL ) {
+		luaL_error(L, "element is not bound");
+	}
+	return binding->element;
+}
+
+static void script_set_position(lua_State *L, screen_element *element, uint_fast16_t *dest, int index) {
+	lua_Number value = luaL_checknumber(L, index);
+	uint_fast16_t old = *dest;
+	UINT_FAST16_T(*dest, value);
+	if( *dest != old ) {
+		element->dirty |= SCREEN_DIRTY_POSITION;
+	}
+}
+
+static void script_push_color(lua_State *L, Color color) {
+	lua_createtable(L, 0, 4);
+	lua_pushinteger(L, color.r);
+	lua_setfield(L, -2, "r");
+	lua_pushinteger(L, color.g);
+	lua_setfield(L, -2, "g");
+	lua_pushinteger(L, color.b);
+	lua_setfield(L, -2, "b");
+	lua_pushinteger(L, color.a);
+	lua_setfield(L, -2, "a");
+}
+
+static unsigned char script_color_field(lua_State *L, int index, const char *name, unsigned char def) {
+	lua_getfield(L, index, name);
+	lua_Number value = lua_isnumber(L, -1)?lua_tonumber(L, -1):def;
+	lua_pop(L, 1);
+	if( value < 0 ) { return 0; }
+	if( value > 255 ) { return 255; }
+	return (unsigned char)value;
+}
+
+/*******************************************************************************
+ * Reads a color from a table {r=,g=,b=,a=} or a string like "#rrggbb[aa]"
+ ******************************************************************************/
+static Color script_check_color(lua_State *L, int index) {
+	if( lua_type(L, index) == LUA_TSTRING ) {
+		return parse_color_str((char *)lua_tostring(L, index));
+	}
+	if( lua_type(L, index) != LUA_TTABLE ) {
+		luaL_error(L, "color has to be a table or a string");
+	}
+	return (Color){
+		script_color_field(L, index, "r", 0),
+		script_color_field(L, index, "g", 0),
+		script_color_field(L, index, "b", 0),
+		script_color_field(L, index, "a", 255),
+	};
+}
+
+static bool script_is_text(const screen_element *element) {
+	return element->type == SCREEN_TEXT || element->type == SCREEN_CLOCK;
+}
+
+static int script_get(lua_State *L, screen_element *element, const char *key) {
+	if( strcmp(key, "x") == 0 ) { lua_pushinteger(L, element->position.x); }
+	else if( strcmp(key, "y") == 0 ) { lua_pushinteger(L, element->position.y); }
+	else if( strcmp(key, "w") == 0 ) { lua_pushinteger(L, element->position.w); }
+	else if( strcmp(key, "h") == 0 ) { lua_pushinteger(L, element->position.h); }
+	else if( strcmp(key, "id") == 0 ) { lua_pushinteger(L, element->id); }
+	else if( strcmp(key, "visible") == 0 ) { lua_pushboolean(L, element->visible); }
+	else if( strcmp(key, "opacity") == 0 ) { lua_pushnumber(L, element->opacity); }
+	else if( strcmp(key, "color") == 0 && script_is_text(element) ) {
+		script_push_color(L, ((screen_attrs_text *)element->attrs)->color);
+	}
+	else if( strcmp(key, "text") == 0 && script_is_text(element) ) {
+		lua_pushstring(L, ((screen_attrs_text *)element->attrs)->text);
+	}
+	else {
+		lua_pushnil(L);
+	}
+	return 1;
+}
+
+static int script_set(lua_State *L, screen_element *element, const char *key, int index) {
+	if( strcmp(key, "x") == 0 ) { script_set_position(L, element, &element->position.x, index); }
+	else if( strcmp(key, "y") == 0 ) { script_set_position(L, element, &element->position.y, index); }
+	else if( strcmp(key, "w") == 0 ) { script_set_position(L, element, &element->position.w, index); }
+	else if( strcmp(key, "h") == 0 ) { script_set_position(L, element, &element->position.h, index); }
+	else if( strcmp(key, "visible") == 0 ) { screen_set_visible(element, lua_toboolean(L, index)); }
+	else if( strcmp(key, "opacity") == 0 ) {
+		float opacity = (float)luaL_checknumber(L, index);
+		opacity = ( opacity < 0 )?0:( opacity > 1 )?1:opacity;
+		if( opacity != element->opacity ) {
+			element->opacity = opacity;
+			element->dirty |= SCREEN_DIRTY_STYLE;
+		}
+	}
+	else if( strcmp(key, "color") == 0 && script_is_text(element) ) {
+		Color color = script_check_color(L, index);
+		Color *dest = &((screen_attrs_text *)element->attrs)->color;
+		if( memcmp(&color, dest, sizeof(Color)) != 0 ) {
+			*dest = color;
+			element->dirty |= SCREEN_DIRTY_STYLE;
+		}
+	}
+	else if( strcmp(key, "text") == 0 && script_is_text(element) ) {
+		screen_set_text(element, luaL_checkstring(L, index));
+	}
+	else {
+		return luaL_error(L, "element has no writable property »%s«", key);
+	}
+	return 0;
+}
+
+static int script_element_index(lua_State *L) {
+	return script_get(L, script_check_element(L, 1), luaL_checkstring(L, 2));
+}
+
+static int script_element_newindex(lua_State *L) {
+	return script_set(L, script_check_element(L, 1), luaL_checkstring(L, 2), 3);
+}
+
+static bool script_is_legacy_global(const char *key) {
+	return key != NULL && key[0] != '\0' && key[1] == '\0' && strchr("xywh", key[0]) != NULL;
+}
+
+/*******************************************************************************
+ * Keeps the old globals x, y, w and h working, they are forwarded to the
+ * element. Upvalue 1 is the element userdata.
+ ******************************************************************************/
+static int script_global_index(lua_State *L) {
+	const char *key = ( lua_type(L, 2) == LUA_TSTRING )?lua_tostring(L, 2):NULL;
+	if( !script_is_legacy_global(key) ) {
+		lua_pushnil(L);
+		return 1;
+	}
+	return script_get(L, script_check_element(L, lua_upvalueindex(1)), key);
+}
+
+static int script_global_newindex(lua_State *L) {
+	const char *key = ( lua_type(L, 2) == LUA_TSTRING )?lua_tostring(L, 2):NULL;
+	if( !script_is_legacy_global(key) ) {
+		lua_rawset(L, 1);
+		return 0;
+	}
+	return script_set(L, script_check_element(L, lua_upvalueindex(1)), key, 3);
+}
+
+/*******************************************************************************
+ * Creates a lua state for element scripts. The global »element« refers to the
+ * element the script belongs to, it has the properties x, y, w, h, visible,
+ * opacity and for texts color and text. Setting them marks the element dirty.
+ * The globals »t« and »dt« are set before each run, see screen_eval_lua.
+ * LuaJIT builds also get »element_data«, a ffi pointer to a script_data struct,
+ * which can be JIT-compiled as it doesn't call into C.
+ * Layouts can be reloaded from anywhere, so scripts only get the base, math,
+ * string and table libraries, no io, os, debug or require. LuaJIT also opens
+ * jit to enable the compiler, package and ffi to set up »element_data«, they
+ * are removed from the globals afterwards.
+ * @param **binding is set to the binding, which has to be passed to
+ * script_bind before each run
+ * @return the new lua state
+ ******************************************************************************/
+lua_State *script_new_state(script_binding **binding) {
+	lua_State *L = luaL_newstate();
+	FAIL_ON_NULL(L, "Failed to create lua state");
+	for( const luaL_Reg *lib = script_libs; lib->func != NULL; lib++ ) {
+		luaL_requiref(L, lib->name, lib->func, 1);
+		lua_pop(L, 1);
+	}
+
+	luaL_newmetatable(L, SCRIPT_ELEMENT_META);
+	lua_pushcfunction(L, script_element_index);
+	lua_setfield(L, -2, "__index");
+	lua_pushcfunction(L, script_element_newindex);
+	lua_setfield(L, -2, "__newindex");
+	lua_pop(L, 1);
+
+	// userdata memory isn't moved by the garbage collector
+	*binding = lua_newuserdata(L, sizeof(script_binding));
+	memset(*binding, 0, sizeof(script_binding));
+	luaL_setmetatable(L, SCRIPT_ELEMENT_META);
+	lua_pushvalue(L, -1);
+	lua_setglobal(L, "element");
+
+	// element userdata is still on the stack, used as upvalue of the proxies
+	lua_pushglobaltable(L);
+	lua_createtable(L, 0, 2);
+	lua_pushvalue(L, -3);
+	lua_pushcclosure(L, script_global_index, 1);
+	lua_setfield(L, -2, "__index");
+	lua_pushvalue(L, -3);
+	lua_pushcclosure(L, script_global_newindex, 1);
+	lua_setfield(L, -2, "__newindex");
+	lua_setmetatable(L, -2);
+	lua_pop(L, 2);
+
+#ifdef USE_LUAJIT
+	if( luaL_loadstring(L, script_ffi_setup) != LUA_OK ) {
+		LOG_FATAL("Failed to compile ffi setup: %s", lua_tostring(L, -1));
+	}
+	lua_pushlightuserdata(L, &(*binding)->data);
+	if( lua_pcall(L, 1, 0, 0) != LUA_OK ) {
+		LOG_ERROR("Failed to set up ffi element data: %s", lua_tostring(L, -1));
+		lua_pop(L, 1);
+	}
+	// element_data keeps working, but scripts can't reach ffi.C any more
+	static const char *script_jit_only[] = { "require", "module", LUA_JITLIBNAME, LUA_LOADLIBNAME, LUA_FFILIBNAME };
+	for( size_t i = 0; i < sizeof(script_jit_only) / sizeof(script_jit_only[0]); i++ ) {
+		lua_pushnil(L);
+		lua_setglobal(L, script_jit_only[i]);
+	}
+	luaL_findtable(L, LUA_REGISTRYINDEX, "_LOADED", 16);
+	lua_pushnil(L);
+	lua_setfield(L, -2, LUA_LOADLIBNAME);
+	lua_pushnil(L);
+	lua_setfield(L, -2, LUA_FFILIBNAME);
+	lua_pushnil(L);
+	lua_setfield(L, -2, LUA_JITLIBNAME);
+	lua_pop(L, 1);
+#endif
+
+	LOG_VERBOSE("Created %s state with element bindings", SCRIPT_BACKEND);
+	return L;
+}
+
+/*******************************************************************************
+ * Binds the element a script runs for, must be called before each run as
+ * element arrays are moved on realloc
+ ******************************************************************************/
+void script_bind(script_binding *binding, screen_element *element) {
+	binding->element = element;
+#ifdef USE_LUAJIT
+	binding->data = (script_data){
+		element->position.x, element->position.y, element->position.w, element->position.h,
+		element->opacity, element->visible,
+	};
+	binding->synced = binding->data;
+#endif
+}
+
+#ifdef USE_LUAJIT
+static void script_apply(screen_element *element, uint_fast16_t *dest, float value, float synced) {
+	if( value == synced ) {
+		return;
+	}
+	uint_fast16_t old = *dest;
+	UINT_FAST16_T(*dest, value);
+	if( *dest != old ) {
+		element->dirty |= SCREEN_DIRTY_POSITION;
+	}
+}
+#endif
+
+/*******************************************************************************
+ * Writes the changes a script made through the ffi back to the element, only
+ * fields changed by the script are written
+ ******************************************************************************/
+void script_unbind(script_binding *binding) {
+#ifdef USE_LUAJIT
+	screen_element *element = binding->element;
+	script_data *data = &binding->data;
+	script_data *synced = &binding->synced;
+	script_apply(element, &element->position.x, data->x, synced->x);
+	script_apply(element, &element->position.y, data->y, synced->y);
+	script_apply(element, &element->position.w, data->w, synced->w);
+	script_apply(element, &element->position.h, data->h, synced->h);
+	if( data->opacity != synced->opacity ) {
+		element->opacity = ( data->opacity < 0 )?0:( data->opacity > 1 )?1:data->opacity;
+		element->dirty |= SCREEN_DIRTY_STYLE;
+	}
+	if( data->visible != synced->visible ) {
+		screen_set_visible(element, data->visible != 0);
+	}
+#endif
+	binding->element = NULL;
+}
+
+static double script_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*******************************************************************************
+ * Runs the scripts of all elements of the loaded layout and logs the time per
+ * run, used to compare the lua backends
+ * @param runs number of runs per script
+ ******************************************************************************/
+void script_bench(uint_fast32_t runs) {
+	uint_fast32_t count;
+	screen_element *elements = screen_get_elements(&count);
+	double total = 0;
+	uint_fast32_t scripts = 0;
+	for( uint_fast32_t i = 0; i < count; i++ ) {
+		screen_element *element = &elements[i];
+		if( element->evals == NULL ) {
+			continue;
+		}
+		screen_compile_lua(element);
+		if( element->evals == NULL ) {
+			continue;
+		}
+		double start = script_now();
+		for( uint_fast32_t run = 0; run < runs; run++ ) {
+			screen_eval_lua(element, run / 60.0, 1 / 60.0);
+		}
+		double elapsed = script_now() - start;
+		LOG_INFO("%s: script of element %lu took %.0f ns per run", SCRIPT_BACKEND, element->id, elapsed * 1e9 / runs);
+		total += elapsed;
+		scripts++;
+	}
+	if( scripts == 0 ) {
+		LOG_WARNING("Layout »%s« has no scripts to benchmark", config.layout);
+		return;
+	}
+	printf("%s\t%lu scripts\t%lu runs\t%.0f ns per frame\n", SCRIPT_BACKEND, scripts, runs, total * 1e9 / runs);
+}
@@ -0,0 +1,86 @@
+#ifndef __SCRIPT_H__
+#define __SCRIPT_H__
+
+
+#ifndef SCRIPT_BENCH_RUNS
+#define SCRIPT_BENCH_RUNS 100000
+#endif
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <raylib.h>
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include "log.h"
+#include "helpers.h"
+#include "screen.h"
+#include "profile.h"
+
+
+#ifdef USE_LUAJIT
+	#include <luajit.h>
+	#define SCRIPT_BACKEND LUAJIT_VERSION
+#else
+	#define SCRIPT_BACKEND LUA_RELEASE
+#endif
+
+// LuaJIT only provides the lua 5.1 API
+#if LUA_VERSION_NUM < 502
+	#ifndef LUA_OK
+		#define LUA_OK 0
+	#endif
+	#define lua_pushglobaltable(L) lua_pushvalue(L, LUA_GLOBALSINDEX)
+	#define luaL_setmetatable(L, name) (luaL_getmetatable(L, name), lua_setmetatable(L, -2))
+	static inline void luaL_requiref(lua_State *L, const char *name, lua_CFunction open, int global) {
+		lua_pushcfunction(L, open);
+		lua_pushstring(L, name);
+		lua_call(L, 1, 1);
+		luaL_findtable(L, LUA_REGISTRYINDEX, "_LOADED", 16);
+		lua_pushvalue(L, -2);
+		lua_setfield(L, -2, name);
+		lua_pop(L, 1);
+		if( global ) {
+			lua_pushvalue(L, -1);
+			lua_setglobal(L, name);
+		}
+	}
+#endif
+
+
+#define SCRIPT_ELEMENT_META "info_screen.element"
+
+#define SCRIPT_STR(...) #__VA_ARGS__
+#define SCRIPT_XSTR(...) SCRIPT_STR(__VA_ARGS__)
+
+// element state scripts can access without the lua stack, see script_bind
+#define SCRIPT_DATA_FIELDS \
+	float x, y, w, h, opacity; \
+	int32_t visible;
+
+typedef struct script_data {
+	SCRIPT_DATA_FIELDS
+} script_data;
+
+struct screen_element;
+
+typedef struct script_binding {
+	struct screen_element *element;  // only set while the script runs
+#ifdef USE_LUAJIT
+	script_data data;    // accessed by scripts as »element_data« through the ffi
+	script_data synced;  // data as written by script_bind
+#endif
+} script_binding;
+
+
+lua_State *script_new_state(script_binding **binding);
+void script_bind(script_binding *binding, struct screen_element *element);
+void script_unbind(script_binding *binding);
+void script_bench(uint_fast32_t runs);
+
+
+#endif
@@ -0,0 +1,138 @@
+#include "startup.h"
+
+static const char *TOPIC = "startup";
+
+
+static struct timespec startup_times[STARTUP_PHASES];
+static uint_fast16_t startup_threads;
+static uint_fast32_t startup_tasks;
+
+
+static double startup_phase_ms(startup_phase phase) {
+	struct timespec *end = &startup_times[phase];
+	struct timespec *start = &startup_times[phase-1];
+	return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/*******************************************************************************
+ * Returns the time to first frame, only valid after the first frame was drawn
+ ******************************************************************************/
+double startup_total_ms() {
+	double total = 0;
+	for( startup_phase p = STARTUP_PARSE; p < STARTUP_PHASES; p++ ) {
+		total += startup_phase_ms(p);
+	}
+	return total;
+}
+
+/*******************************************************************************
+ * Records the end of a startup phase, logs the time to first frame after the
+ * first frame was drawn
+ * @param phase the phase which just finished
+ ******************************************************************************/
+void startup_phase_done(startup_phase phase) {
+	clock_gettime(CLOCK_MONOTONIC, &startup_times[phase]);
+	if( phase != STARTUP_FIRST_FRAME ) {
+		return;
+	}
+	double total = startup_total_ms();
+	LOG_INFO("Time to first frame %.1fms: parse %.1fms, preload %.1fms (%lu tasks on %lu threads), window %.1fms, upload %.1fms, first frame %.1fms",
+			total, startup_phase_ms(STARTUP_PARSE), startup_phase_ms(STARTUP_PRELOAD), startup_tasks, startup_threads,
+			startup_phase_ms(STARTUP_WINDOW), startup_phase_ms(STARTUP_UPLOAD), startup_phase_ms(STARTUP_FIRST_FRAME));
+}
+
+static void startup_task_img(void *element) {
+	screen_prepare_img((screen_element *)element);
+}
+
+static void startup_task_glyphs(void *element) {
+	screen_prepare_text((screen_element *)element);
+}
+
+static void startup_task_table(void *element) {
+	screen_prepare_table((screen_element *)element);
+}
+
+static void startup_task_lua(void *element) {
+	screen_compile_lua((screen_element *)element);
+}
+
+/*******************************************************************************
+ * Adds the preload tasks of all elements, the element array has to be stable
+ * until the graph has finished
+ * @param dependencies_count, *dependencies tasks to wait for, e.g. parsing
+ ******************************************************************************/
+static void startup_add_preload_tasks(task_graph *graph, screen_element *elements, uint_fast32_t count, uint_fast32_t dependencies_count, const uint_fast32_t *dependencies) {
+	for( uint_fast32_t i = 0; i < count; i++ ) {
+		screen_element *element = &elements[i];
+		if( element->evals != NULL ) {
+			tasks_add(graph, "compile lua", startup_task_lua, element, dependencies_count, dependencies);
+		}
+		if( element->type == SCREEN_IMG ) {
+			tasks_add(graph, "decode image", startup_task_img, element, dependencies_count, dependencies);
+			continue;
+		}
+		if( element->type == SCREEN_TABLE ) {
+			tasks_add(graph, "read table", startup_task_table, element, dependencies_count, dependencies);
+			continue;
+		}
+		if( ((screen_attrs_text *)element->attrs)->font_id != UINT_FAST32_MAX ) {
+			// texts sharing a font wait for each other, the later ones mostly find their glyphs cached
+			tasks_add(graph, "rasterize glyphs", startup_task_glyphs, element, dependencies_count, dependencies);
+		}
+	}
+}
+
+typedef struct startup_parse {
+	task_graph *graph;
+	uint_fast32_t task;
+	char *layout_name;
+} startup_parse;
+
+static void startup_task_parse(void *arg) {
+	startup_parse *parse = (startup_parse *)arg;
+	layout_init(parse->layout_name);
+	startup_phase_done(STARTUP_PARSE);
+	// the preload tasks depend on this task, so they start after it returned
+	uint_fast32_t count;
+	screen_element *elements = screen_get_elements(&count);
+	startup_add_preload_tasks(parse->graph, elements, count, 1, &parse->task);
+}
+
+/*******************************************************************************
+ * Parses the layout and prepares all assets in parallel on all cores. Only the
+ * upload into GPU memory is left, which is done after the window is opened.
+ * @param *layout_name the layout to load
+ ******************************************************************************/
+void startup_load(char *layout_name) {
+	startup_phase_done(STARTUP_BEGIN);
+
+	task_graph *graph = tasks_new();
+	startup_parse parse = { graph, 0, layout_name };
+	// workers aren't running yet, so the id is known before the parse task starts
+	parse.task = tasks_add(graph, "parse layout", startup_task_parse, &parse, 0, NULL);
+	startup_threads = tasks_cpu_count();
+	tasks_run(graph, startup_threads);
+	startup_tasks = graph->tasks_count;
+	tasks_free(graph);
+	// the process is usually killed instead of stopped, so the glyphs are kept right away
+	glyph_cache_save();
+
+	startup_phase_done(STARTUP_PRELOAD);
+}
+
+/*******************************************************************************
+ * Prepares the fonts, images and lua states of a layout which isn't shown yet,
+ * only the upload into GPU memory is left. Used to pre-warm scheduled layouts.
+ * @param *l the loaded layout
+ * @param threads number of worker threads
+ ******************************************************************************/
+void startup_prepare_layout(layout *l, uint_fast16_t threads) {
+	PROFILE_FUNC();
+	task_graph *graph = tasks_new();
+	startup_add_preload_tasks(graph, l->elements->elements, l->elements->count, 0, NULL);
+	tasks_run(graph, threads);
+	LOG_DEBUG("Prepared layout »%s« with %lu tasks", l->name, graph->tasks_count);
+	tasks_free(graph);
+	glyph_cache_save();
+}
@@ -0,0 +1,35 @@
+#ifndef __STARTUP_H__
+#define __STARTUP_H__
+
+
+#include <stdint.h>
+#include <time.h>
+
+#include "log.h"
+#include "helpers.h"
+#include "tasks.h"
+#include "layout.h"
+#include "screen.h"
+#include "vram.h"
+
+
+struct layout;
+
+typedef enum {
+	STARTUP_BEGIN,
+	STARTUP_PARSE,
+	STARTUP_PRELOAD,
+	STARTUP_WINDOW,
+	STARTUP_UPLOAD,
+	STARTUP_FIRST_FRAME,
+	STARTUP_PHASES,
+} startup_phase;
+
+
+void startup_load(char *layout_name);
+void startup_prepare_layout(struct layout *l, uint_fast16_t threads);
+void startup_phase_done(startup_phase phase);
+double startup_total_ms();
+
+
+#endif
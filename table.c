@@ -0,0 +1,439 @@
+#include "table.h"
+
+static const char *TOPIC = "table";
+
+
+typedef struct table_reader {
+	FILE *file;
+	int c;                 // current character, EOF at the end
+	uint_fast32_t line;
+	const table_sax *sax;
+	char buffer[TABLE_CELL_MAX + 1];
+	size_t length;
+	bool cut;              // the string is longer than TABLE_CELL_MAX
+} table_reader;
+
+typedef struct table_builder {
+	table_store *store;
+	const char *rows_key;       // key of the rows array in the top level object, NULL for a top level array
+	char **keys;                // key of each column
+	uint_fast16_t depth;        // open arrays and objects
+	uint_fast16_t rows_depth;   // depth of the rows array, 0 if outside of it
+	bool rows_found;            // later arrays are ignored
+	bool rows_next;             // the next array is the rows array
+	int_fast32_t column;        // column of the next value, -1 if it isn't shown
+	char *row;                  // cells of the current row, TABLE_CELL_MAX + 1 bytes each
+} table_builder;
+
+
+static inline void table_next(table_reader *r) {
+	r->c = getc_unlocked(r->file);
+	if( r->c == '\n' ) {
+		r->line++;
+	}
+}
+
+static void table_skip_space(table_reader *r) {
+	while( r->c == ' ' || r->c == '\t' || r->c == '\n' || r->c == '\r' ) {
+		table_next(r);
+	}
+}
+
+static void table_append(table_reader *r, const char *bytes, size_t count) {
+	if( r->cut || r->length + count > TABLE_CELL_MAX ) {
+		r->cut = true;  // the rest is skipped, so nothing is left out in between
+		return;
+	}
+	memcpy(r->buffer + r->length, bytes, count);
+	r->length += count;
+}
+
+static void table_append_codepoint(table_reader *r, uint_fast32_t codepoint) {
+	char utf8[4];
+	if( codepoint < 0x80 ) {
+		utf8[0] = codepoint;
+		table_append(r, utf8, 1);
+	}
+	else if( codepoint < 0x800 ) {
+		utf8[0] = 0xc0 | ( codepoint >> 6 );
+		utf8[1] = 0x80 | ( codepoint & 0x3f );
+		table_append(r, utf8, 2);
+	}
+	else if( codepoint < 0x10000 ) {
+		utf8[0] = 0xe0 | ( codepoint >> 12 );
+		utf8[1] = 0x80 | ( ( codepoint >> 6 ) & 0x3f );
+		utf8[2] = 0x80 | ( codepoint & 0x3f );
+		table_append(r, utf8, 3);
+	}
+	else {
+		utf8[0] = 0xf0 | ( codepoint >> 18 );
+		utf8[1] = 0x80 | ( ( codepoint >> 12 ) & 0x3f );
+		utf8[2] = 0x80 | ( ( codepoint >> 6 ) & 0x3f );
+		utf8[3] = 0x80 | ( codepoint & 0x3f );
+		table_append(r, utf8, 4);
+	}
+}
+
+static bool table_read_hex(table_reader *r, uint_fast32_t *value) {
+	*value = 0;
+	for( int i = 0; i < 4; i++ ) {
+		table_next(r);
+		int c = r->c;
+		if( c >= '0' && c <= '9' )      { *value = *value * 16 + c - '0'; }
+		else if( c >= 'a' && c <= 'f' ) { *value = *value * 16 + c - 'a' + 10; }
+		else if( c >= 'A' && c <= 'F' ) { *value = *value * 16 + c - 'A' + 10; }
+		else { return false; }
+	}
+	return true;
+}
+
+/*******************************************************************************
+ * Reads a string into the buffer, the reader is at the opening quote. Bytes
+ * over TABLE_CELL_MAX are skipped, without cutting a UTF-8 sequence in half.
+ ******************************************************************************/
+static bool table_read_string(table_reader *r) {
+	r->length = 0;
+	r->cut = false;
+	for( table_next(r); r->c != '"'; table_next(r) ) {
+		if( r->c == EOF ) {
+			return false;
+		}
+		if( r->c != '\\' ) {
+			char byte = r->c;
+			table_append(r, &byte, 1);
+			continue;
+		}
+		table_next(r);
+		uint_fast32_t codepoint;
+		switch( r->c ) {
+			case 'b': table_append(r, "\b", 1); break;
+			case 'f': table_append(r, "\f", 1); break;
+			case 'n': table_append(r, "\n", 1); break;
+			case 'r': table_append(r, "\r", 1); break;
+			case 't': table_append(r, "\t", 1); break;
+			case '"': case '\\': case '/': {
+				char byte = r->c;
+				table_append(r, &byte, 1);
+				break;
+			}
+			case 'u':
+				if( !table_read_hex(r, &codepoint) ) {
+					return false;
+				}
+				if( codepoint >= 0xd800 && codepoint <= 0xdbff ) {
+					uint_fast32_t low;
+					table_next(r);
+					if( r->c != '\\' ) {
+						return false;
+					}
+					table_next(r);
+					if( r->c != 'u' || !table_read_hex(r, &low) || low < 0xdc00 || low > 0xdfff ) {
+						return false;
+					}
+					codepoint = 0x10000 + ( ( codepoint - 0xd800 ) << 10 ) + ( low - 0xdc00 );
+				}
+				table_append_codepoint(r, codepoint);
+				break;
+			default:
+				return false;
+		}
+	}
+	// a multi byte sequence could still be incomplete if the raw bytes were cut
+	size_t lead = r->length;
+	while( lead > 0 && ( r->buffer[lead-1] & 0xc0 ) == 0x80 ) {
+		lead--;
+	}
+	if( lead > 0 && ( r->buffer[lead-1] & 0xc0 ) == 0xc0 ) {
+		unsigned char first = r->buffer[lead-1];
+		size_t expected = ( first >= 0xf0 )?4:( first >= 0xe0 )?3:2;
+		if( r->length - ( lead - 1 ) < expected ) {
+			r->length = lead - 1;
+		}
+	}
+	r->buffer[r->length] = '\0';
+	table_next(r);
+	return true;
+}
+
+/*******************************************************************************
+ * Tests if a scalar follows the JSON number syntax, unlike strtod() it rejects
+ * hex numbers, nan, inf and leading zeros or plus signs
+ ******************************************************************************/
+static bool table_is_number(const char *s) {
+	if( *s == '-' ) {
+		s++;
+	}
+	if( *s == '0' ) {
+		s++;
+	}
+	else if( *s >= '1' && *s <= '9' ) {
+		while( *s >= '0' && *s <= '9' ) {
+			s++;
+		}
+	}
+	else {
+		return false;
+	}
+	if( *s == '.' ) {
+		s++;
+		if( *s < '0' || *s > '9' ) {
+			return false;
+		}
+		while( *s >= '0' && *s <= '9' ) {
+			s++;
+		}
+	}
+	if( *s == 'e' || *s == 'E' ) {
+		s++;
+		if( *s == '-' || *s == '+' ) {
+			s++;
+		}
+		if( *s < '0' || *s > '9' ) {
+			return false;
+		}
+		while( *s >= '0' && *s <= '9' ) {
+			s++;
+		}
+	}
+	return *s == '\0';
+}
+
+/*******************************************************************************
+ * Reads a number, true, false or null as written
+ ******************************************************************************/
+static bool table_read_scalar(table_reader *r) {
+	r->length = 0;
+	while( ( r->c >= '0' && r->c <= '9' ) || ( r->c >= 'a' && r->c <= 'z' ) || r->c == '-' || r->c == '+' || r->c == '.' || r->c == 'E' ) {
+		if( r->length >= TABLE_CELL_MAX ) {
+			return false;
+		}
+		r->buffer[r->length++] = r->c;
+		table_next(r);
+	}
+	r->buffer[r->length] = '\0';
+	if( strcmp(r->buffer, "true") == 0 || strcmp(r->buffer, "false") == 0 || strcmp(r->buffer, "null") == 0 ) {
+		return true;
+	}
+	return table_is_number(r->buffer);
+}
+
+static bool table_read_value(table_reader *r, uint_fast16_t depth) {
+	table_skip_space(r);
+	if( r->c == '"' ) {
+		if( !table_read_string(r) ) {
+			return false;
+		}
+		r->sax->value(r->sax->user, r->buffer);
+		return true;
+	}
+	if( r->c != '{' && r->c != '[' ) {
+		if( !table_read_scalar(r) ) {
+			return false;
+		}
+		r->sax->value(r->sax->user, r->buffer);
+		return true;
+	}
+	if( depth >= TABLE_MAX_DEPTH ) {
+		return false;
+	}
+	bool array = r->c == '[';
+	char close = array?']':'}';
+	r->sax->begin(r->sax->user, array);
+	table_next(r);
+	table_skip_space(r);
+	if( r->c == close ) {
+		table_next(r);
+		r->sax->end(r->sax->user, array);
+		return true;
+	}
+	while( true ) {
+		if( !array ) {
+			table_skip_space(r);
+			if( r->c != '"' || !table_read_string(r) ) {
+				return false;
+			}
+			r->sax->key(r->sax->user, r->buffer);
+			table_skip_space(r);
+			if( r->c != ':' ) {
+				return false;
+			}
+			table_next(r);
+		}
+		if( !table_read_value(r, depth + 1) ) {
+			return false;
+		}
+		table_skip_space(r);
+		if( r->c == ',' ) {
+			table_next(r);
+			continue;
+		}
+		if( r->c != close ) {
+			return false;
+		}
+		table_next(r);
+		r->sax->end(r->sax->user, array);
+		return true;
+	}
+}
+
+/*******************************************************************************
+ * Parses a JSON document from a stream and reports what it contains as events,
+ * without building it in memory. Memory use doesn't depend on the document
+ * size, strings are cut at TABLE_CELL_MAX bytes.
+ * @param *file the stream to read from
+ * @param *sax the event handlers
+ * @param *line set to the line the parser stopped at
+ * @return false if the document isn't valid JSON
+ ******************************************************************************/
+bool table_parse(FILE *file, const table_sax *sax, uint_fast32_t *line) {
+	PROFILE_FUNC();
+	table_reader r = { .file = file, .line = 1, .sax = sax };
+	flockfile(file);
+	table_next(&r);
+	bool ok = table_read_value(&r, 0);
+	table_skip_space(&r);
+	ok = ok && r.c == EOF;
+	funlockfile(file);
+	*line = r.line;
+	return ok;
+}
+
+static void table_store_row(table_builder *b) {
+	table_store *store = b->store;
+	if( store->rows_count >= TABLE_MAX_ROWS ) {
+		store->dropped++;
+		return;
+	}
+	if( store->rows_count == store->rows_capacity ) {
+		store->rows_capacity = ( store->rows_capacity == 0 )?256:store->rows_capacity * 2;
+		REALLOC(new_rows, store->rows, sizeof(size_t) * store->rows_capacity);
+	}
+	store->rows[store->rows_count++] = store->cells_size;
+	for( uint_fast16_t column = 0; column < store->columns_count; column++ ) {
+		const char *cell = b->row + column * ( TABLE_CELL_MAX + 1 );
+		size_t size = strlen(cell) + 1;
+		if( store->cells_size + size > store->cells_capacity ) {
+			store->cells_capacity = ( store->cells_capacity == 0 )?4096:store->cells_capacity * 2;
+			REALLOC(new_cells, store->cells, store->cells_capacity);
+		}
+		memcpy(store->cells + store->cells_size, cell, size);
+		store->cells_size += size;
+	}
+}
+
+static void table_on_begin(void *user, bool array) {
+	table_builder *b = user;
+	b->depth++;
+	if( array && !b->rows_found && ( b->rows_next || ( b->rows_key == NULL && b->depth == 1 ) ) ) {
+		b->rows_depth = b->depth;
+		b->rows_found = true;
+	}
+	b->rows_next = false;
+	if( !array && b->rows_depth > 0 && b->depth == b->rows_depth + 1 ) {
+		for( uint_fast16_t column = 0; column < b->store->columns_count; column++ ) {
+			b->row[column * ( TABLE_CELL_MAX + 1 )] = '\0';
+		}
+		b->column = -1;
+	}
+}
+
+static void table_on_end(void *user, bool array) {
+	table_builder *b = user;
+	if( b->rows_depth > 0 ) {
+		if( !array && b->depth == b->rows_depth + 1 ) {
+			table_store_row(b);
+		}
+		else if( b->depth == b->rows_depth ) {
+			b->rows_depth = 0;
+		}
+	}
+	b->depth--;
+}
+
+static void table_on_key(void *user, const char *key) {
+	table_builder *b = user;
+	if( b->depth == 1 && b->rows_key != NULL && !b->rows_found ) {
+		b->rows_next = strcmp(key, b->rows_key) == 0;
+	}
+	if( b->rows_depth == 0 || b->depth != b->rows_depth + 1 ) {
+		return;
+	}
+	b->column = -1;
+	for( uint_fast16_t column = 0; column < b->store->columns_count; column++ ) {
+		if( strcmp(key, b->keys[column]) == 0 ) {
+			b->column = column;
+			break;
+		}
+	}
+}
+
+static void table_on_value(void *user, const char *value) {
+	table_builder *b = user;
+	b->rows_next = false;
+	if( b->rows_depth == 0 || b->depth != b->rows_depth + 1 || b->column < 0 ) {
+		return;
+	}
+	char *cell = b->row + b->column * ( TABLE_CELL_MAX + 1 );
+	if( strcmp(value, "null") != 0 ) {
+		strcpy(cell, value);
+	}
+	b->column = -1;
+}
+
+/*******************************************************************************
+ * Reads the rows of a JSON data file into a store, only the values of the
+ * given keys are kept. Rows are the objects of the top level array, or of the
+ * array under rows_key in the top level object. Could be called from any
+ * thread.
+ * @param *store the store to fill, released with table_free
+ * @param *file path of the data file
+ * @param *rows_key key of the rows array, NULL if the document is the array
+ * @param **keys key of each column, missing keys are shown empty
+ * @return false if the file can't be read or isn't valid JSON, the rows read
+ * until the error are kept
+ ******************************************************************************/
+bool table_load(table_store *store, const char *file, const char *rows_key, char **keys, uint_fast16_t keys_count) {
+	PROFILE_FUNC();
+	memset(store, 0, sizeof(table_store));
+	store->columns_count = keys_count;
+	FILE *stream = fopen(file, "r");
+	if( stream == NULL ) {
+		LOG_ERROR("Failed to open data file »%s«: %s", file, strerror(errno));
+		return false;
+	}
+	table_builder builder = { store, rows_key, keys, 0, 0, false, false, -1, NULL };
+	MALLOC(builder.row, ( keys_count + 1 ) * ( TABLE_CELL_MAX + 1 ));
+	table_sax sax = { table_on_begin, table_on_end, table_on_key, table_on_value, &builder };
+	uint_fast32_t line;
+	bool ok = table_parse(stream, &sax, &line);
+	fclose(stream);
+	free(builder.row);
+	if( !ok ) {
+		LOG_ERROR("Invalid JSON in data file »%s« in line %lu, showing the %lu rows read before", file, line, store->rows_count);
+	}
+	if( !builder.rows_found ) {
+		LOG_WARNING("Data file »%s« has no rows array%s%s", file, ( rows_key != NULL )?" under key ":"", ( rows_key != NULL )?rows_key:"");
+	}
+	if( store->dropped > 0 ) {
+		LOG_WARNING("Dropped %lu rows of data file »%s«, only %d are kept", store->dropped, file, TABLE_MAX_ROWS);
+	}
+	LOG_DEBUG("Read %lu rows with %lu bytes of cells from »%s«", store->rows_count, store->cells_size, file);
+	return ok;
+}
+
+/*******************************************************************************
+ * Returns the text of a cell, empty if the row didn't have the column's key
+ ******************************************************************************/
+const char *table_cell(const table_store *store, uint_fast32_t row, uint_fast16_t column) {
+	const char *cell = store->cells + store->rows[row];
+	while( column-- > 0 ) {
+		cell += strlen(cell) + 1;
+	}
+	return cell;
+}
+
+void table_free(table_store *store) {
+	free(store->cells);
+	free(store->rows);
+	memset(store, 0, sizeof(table_store));
+}
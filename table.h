@@ -0,0 +1,58 @@
+#ifndef __TABLE_H__
+#define __TABLE_H__
+
+
+#ifndef TABLE_CELL_MAX
+#define TABLE_CELL_MAX 128  // bytes kept of a value, longer ones are cut
+#endif
+
+#ifndef TABLE_MAX_ROWS
+#define TABLE_MAX_ROWS 65536  // rows kept of a data file, further rows are dropped
+#endif
+
+#ifndef TABLE_MAX_DEPTH
+#define TABLE_MAX_DEPTH 64  // nesting of arrays and objects, deeper documents are rejected
+#endif
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "log.h"
+#include "helpers.h"
+#include "profile.h"
+
+
+// events of the streaming parser, values are only valid during the call
+typedef struct table_sax {
+	void (*begin)(void *user, bool array);
+	void (*end)(void *user, bool array);
+	void (*key)(void *user, const char *key);
+	void (*value)(void *user, const char *value);  // strings unescaped, numbers and literals as written
+	void *user;
+} table_sax;
+
+// selected columns of the rows of a data file
+typedef struct table_store {
+	char *cells;             // zero terminated, the cells of a row follow each other
+	size_t cells_size;
+	size_t cells_capacity;
+	size_t *rows;            // offset of the first cell of each row
+	uint_fast32_t rows_count;
+	uint_fast32_t rows_capacity;
+	uint_fast16_t columns_count;
+	uint_fast32_t dropped;   // rows over TABLE_MAX_ROWS
+} table_store;
+
+
+bool table_parse(FILE *file, const table_sax *sax, uint_fast32_t *line);
+bool table_load(table_store *store, const char *file, const char *rows_key, char **keys, uint_fast16_t keys_count);
+const char *table_cell(const table_store *store, uint_fast32_t row, uint_fast16_t column);
+void table_free(table_store *store);
+
+
+#endif
@@ -0,0 +1,141 @@
+#include "tasks.h"
+
+static const char *TOPIC = "tasks";
+
+
+task_graph *tasks_new() {
+	task_graph *graph;
+	MALLOC(graph, sizeof(task_graph));
+	memset(graph, 0, sizeof(task_graph));
+	pthread_mutex_init(&graph->mutex, NULL);
+	pthread_cond_init(&graph->cond, NULL);
+	return graph;
+}
+
+/*******************************************************************************
+ * Adds a task to the graph, could be called from inside a running task
+ * @param *graph the graph to add the task to
+ * @param *name name of the task, used for logging only
+ * @param func the function to call
+ * @param *arg argument passed to func
+ * @param dependencies_count number of tasks which have to finish before
+ * @param *dependencies ids of these tasks
+ * @return the id of the new task
+ ******************************************************************************/
+uint_fast32_t tasks_add(task_graph *graph, const char *name, task_func func, void *arg, uint_fast32_t dependencies_count, const uint_fast32_t *dependencies) {
+	pthread_mutex_lock(&graph->mutex);
+
+	graph->tasks_count++;
+	REALLOC(new_tasks, graph->tasks, sizeof(task) * graph->tasks_count);
+	REALLOC(new_ready, graph->ready, sizeof(uint_fast32_t) * graph->tasks_count);
+	uint_fast32_t id = graph->tasks_count - 1;
+	task *t = &graph->tasks[id];
+	t->name = name;
+	t->func = func;
+	t->arg = arg;
+	t->state = TASK_WAITING;
+	t->pending = 0;
+	t->dependents = NULL;
+	t->dependents_count = 0;
+
+	for( uint_fast32_t i = 0; i < dependencies_count; i++ ) {
+		task *dependency = &graph->tasks[dependencies[i]];
+		if( dependency->state == TASK_DONE ) {
+			continue;
+		}
+		dependency->dependents_count++;
+		REALLOC(new_dependents, dependency->dependents, sizeof(uint_fast32_t) * dependency->dependents_count);
+		dependency->dependents[dependency->dependents_count-1] = id;
+		t->pending++;
+	}
+	if( t->pending == 0 ) {
+		graph->ready[graph->ready_first + graph->ready_count++] = id;
+		pthread_cond_signal(&graph->cond);
+	}
+
+	LOG_VERBOSE("Added task %lu »%s« with %lu pending dependencies", id, name, t->pending);
+	pthread_mutex_unlock(&graph->mutex);
+	return id;
+}
+
+static void *tasks_worker(void *arg) {
+	task_graph *graph = (task_graph *)arg;
+	PROFILE_THREAD_NAME("task worker");
+
+	pthread_mutex_lock(&graph->mutex);
+	while( graph->tasks_done < graph->tasks_count ) {
+		if( graph->ready_count == 0 ) {
+			pthread_cond_wait(&graph->cond, &graph->mutex);
+			continue;
+		}
+		uint_fast32_t id = graph->ready[graph->ready_first++];
+		graph->ready_count--;
+		graph->tasks[id].state = TASK_RUNNING;
+		task_func func = graph->tasks[id].func;
+		void *func_arg = graph->tasks[id].arg;
+		const char *name = graph->tasks[id].name;
+		pthread_mutex_unlock(&graph->mutex);
+		LOG_VERBOSE("Run task %lu »%s«", id, name);
+
+		if( func != NULL ) {
+			PROFILE_ZONE(name);
+			func(func_arg);
+		}
+
+		pthread_mutex_lock(&graph->mutex);
+		task *t = &graph->tasks[id];
+		t->state = TASK_DONE;
+		graph->tasks_done++;
+		for( uint_fast32_t i = 0; i < t->dependents_count; i++ ) {
+			if( --graph->tasks[t->dependents[i]].pending == 0 ) {
+				graph->ready[graph->ready_first + graph->ready_count++] = t->dependents[i];
+			}
+		}
+		pthread_cond_broadcast(&graph->cond);
+	}
+	pthread_mutex_unlock(&graph->mutex);
+
+	return NULL;
+}
+
+/*******************************************************************************
+ * Runs all tasks of the graph and returns after the last one has finished
+ * @param *graph the graph to run
+ * @param threads number of worker threads to use
+ ******************************************************************************/
+void tasks_run(task_graph *graph, uint_fast16_t threads) {
+	if( threads < 1 ) {
+		threads = 1;
+	}
+	pthread_t *workers;
+	MALLOC(workers, sizeof(pthread_t) * threads);
+	for( uint_fast16_t i = 0; i < threads; i++ ) {
+		if( pthread_create(&workers[i], NULL, tasks_worker, graph) ) {
+			LOG_FATAL("Failed to start task worker %lu", i);
+		}
+	}
+	LOG_DEBUG("Started %lu task workers", threads);
+	for( uint_fast16_t i = 0; i < threads; i++ ) {
+		pthread_join(workers[i], NULL);
+	}
+	free(workers);
+}
+
+void tasks_free(task_graph *graph) {
+	for( uint_fast32_t i = 0; i < graph->tasks_count; i++ ) {
+		free(graph->tasks[i].dependents);
+	}
+	free(graph->tasks);
+	free(graph->ready);
+	pthread_mutex_destroy(&graph->mutex);
+	pthread_cond_destroy(&graph->cond);
+	free(graph);
+}
+
+uint_fast16_t tasks_cpu_count() {
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	if( count < 1 ) {
+		return 1;
+	}
+	return (uint_fast16_t)count;
+}
@@ -0,0 +1,52 @@
+#ifndef __TASKS_H__
+#define __TASKS_H__
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "helpers.h"
+#include "profile.h"
+
+
+typedef void (*task_func)(void *arg);
+
+typedef enum {
+	TASK_WAITING,
+	TASK_RUNNING,
+	TASK_DONE,
+} task_state;
+
+typedef struct task {
+	const char *name;
+	task_func func;
+	void *arg;
+	task_state state;
+	uint_fast32_t pending;      // number of unfinished dependencies
+	uint_fast32_t *dependents;
+	uint_fast32_t dependents_count;
+} task;
+
+typedef struct task_graph {
+	task *tasks;
+	uint_fast32_t tasks_count;
+	uint_fast32_t tasks_done;
+	uint_fast32_t *ready;       // FIFO of tasks without pending dependencies
+	uint_fast32_t ready_first;
+	uint_fast32_t ready_count;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+} task_graph;
+
+
+task_graph *tasks_new();
+uint_fast32_t tasks_add(task_graph *graph, const char *name, task_func func, void *arg, uint_fast32_t dependencies_count, const uint_fast32_t *dependencies);
+void tasks_run(task_graph *graph, uint_fast16_t threads);
+void tasks_free(task_graph *graph);
+uint_fast16_t tasks_cpu_count();
+
+
+#endif
@@ -0,0 +1,319 @@
+#include "texture.h"
+
+static const char *TOPIC = "texture";
+
+
+// compressed siblings of an image file, in order of preference
+static const char *texture_compressed_extensions[] = { ".ktx", ".dds", ".pkm" };
+#define TEXTURE_COMPRESSED_EXTENSIONS (sizeof(texture_compressed_extensions) / sizeof(texture_compressed_extensions[0]))
+
+
+bool texture_is_compressed(Image image) {
+	return image.format >= COMPRESSED_DXT1_RGB;
+}
+
+/*******************************************************************************
+ * Returns the file name with its extension replaced
+ * @return the new file name, has to be freed
+ ******************************************************************************/
+static char *texture_sibling(const char *file, const char *extension) {
+	const char *dot = strrchr(file, '.');
+	const char *slash = strrchr(file, '/');
+	size_t base = ( dot != NULL && ( slash == NULL || dot > slash ) )?(size_t)(dot - file):strlen(file);
+	char *sibling;
+	MALLOC(sibling, base + strlen(extension) + 1);
+	memcpy(sibling, file, base);
+	strcpy(sibling + base, extension);
+	return sibling;
+}
+
+static bool texture_is_compressed_file(const char *file) {
+	for( size_t i = 0; i < TEXTURE_COMPRESSED_EXTENSIONS; i++ ) {
+		if( test_filename_extension((char *)file, (char *)texture_compressed_extensions[i]) == 0 ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*******************************************************************************
+ * Loads an image, preferring a pre-compressed sibling (e.g. image.ktx next to
+ * image.png) if texture compression is enabled
+ * @param *file the image file referenced by the layout
+ * @param **fallback_file is set to an uncompressed image to use if the GPU
+ * can't sample the compressed one, NULL if there's none. Has to be freed.
+ * @return the image, data is NULL if it couldn't be loaded
+ ******************************************************************************/
+Image texture_load(const char *file, char **fallback_file) {
+	PROFILE_FUNC();
+	*fallback_file = NULL;
+	if( texture_is_compressed_file(file) ) {
+		char *sibling = texture_sibling(file, ".png");
+		if( FileExists(sibling) ) {
+			*fallback_file = sibling;
+		}
+		else {
+			free(sibling);
+		}
+		return LoadImage(file);
+	}
+
+	if( config.texture_compression ) {
+		for( size_t i = 0; i < TEXTURE_COMPRESSED_EXTENSIONS; i++ ) {
+			char *sibling = texture_sibling(file, texture_compressed_extensions[i]);
+			if( !FileExists(sibling) ) {
+				free(sibling);
+				continue;
+			}
+			Image image = LoadImage(sibling);
+			if( image.data != NULL && texture_is_compressed(image) ) {
+				LOG_VERBOSE("Using compressed image »%s« for »%s«", sibling, file);
+				free(sibling);
+				*fallback_file = strdup(file);
+				FAIL_ON_NULL(*fallback_file, "Failed to copy file name »%s«", file);
+				return image;
+			}
+			LOG_WARNING("Ignoring »%s«, it isn't a compressed image", sibling);
+			UnloadImage(image);
+			free(sibling);
+		}
+	}
+	return LoadImage(file);
+}
+
+static inline uint16_t texture_rgb565(const uint8_t *rgb) {
+	return ((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3);
+}
+
+static inline void texture_unpack565(uint16_t color, int *rgb) {
+	rgb[0] = ((color >> 11) & 0x1f) * 255 / 31;
+	rgb[1] = ((color >> 5) & 0x3f) * 255 / 63;
+	rgb[2] = (color & 0x1f) * 255 / 31;
+}
+
+/*******************************************************************************
+ * Encodes the colors of a 4x4 block as DXT1 block, endpoints are the corners
+ * of the bounding box of the block colors
+ ******************************************************************************/
+static void texture_encode_color(uint8_t block[16][4], uint8_t *out) {
+	uint8_t min[3] = { 255, 255, 255 }, max[3] = { 0, 0, 0 };
+	for( int i = 0; i < 16; i++ ) {
+		for( int c = 0; c < 3; c++ ) {
+			if( block[i][c] < min[c] ) { min[c] = block[i][c]; }
+			if( block[i][c] > max[c] ) { max[c] = block[i][c]; }
+		}
+	}
+	// channels are quantized independently, so c0 >= c1 selects the four color mode
+	uint16_t c0 = texture_rgb565(max);
+	uint16_t c1 = texture_rgb565(min);
+	uint32_t indices = 0;
+	if( c0 != c1 ) {
+		int palette[4][3];
+		texture_unpack565(c0, palette[0]);
+		texture_unpack565(c1, palette[1]);
+		for( int c = 0; c < 3; c++ ) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		for( int i = 0; i < 16; i++ ) {
+			int best = 0, best_distance = INT32_MAX;
+			for( int p = 0; p < 4; p++ ) {
+				int distance = 0;
+				for( int c = 0; c < 3; c++ ) {
+					int d = block[i][c] - palette[p][c];
+					distance += d * d;
+				}
+				if( distance < best_distance ) {
+					best = p;
+					best_distance = distance;
+				}
+			}
+			indices |= (uint32_t)best << (2 * i);
+		}
+	}
+	out[0] = c0 & 0xff;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xff;
+	out[3] = c1 >> 8;
+	for( int i = 0; i < 4; i++ ) {
+		out[4+i] = (indices >> (8 * i)) & 0xff;
+	}
+}
+
+/*******************************************************************************
+ * Encodes the alpha values of a 4x4 block as DXT5 alpha block
+ ******************************************************************************/
+static void texture_encode_alpha(uint8_t block[16][4], uint8_t *out) {
+	uint8_t a0 = 0, a1 = 255;
+	for( int i = 0; i < 16; i++ ) {
+		if( block[i][3] > a0 ) { a0 = block[i][3]; }
+		if( block[i][3] < a1 ) { a1 = block[i][3]; }
+	}
+	uint64_t indices = 0;
+	if( a0 != a1 ) {
+		// a0 > a1 selects eight interpolated values
+		int palette[8] = { a0, a1 };
+		for( int i = 1; i < 7; i++ ) {
+			palette[i+1] = ((7 - i) * a0 + i * a1) / 7;
+		}
+		for( int i = 0; i < 16; i++ ) {
+			int best = 0, best_distance = INT32_MAX;
+			for( int p = 0; p < 8; p++ ) {
+				int distance = abs(block[i][3] - palette[p]);
+				if( distance < best_distance ) {
+					best = p;
+					best_distance = distance;
+				}
+			}
+			indices |= (uint64_t)best << (3 * i);
+		}
+	}
+	out[0] = a0;
+	out[1] = a1;
+	for( int i = 0; i < 6; i++ ) {
+		out[2+i] = (indices >> (8 * i)) & 0xff;
+	}
+}
+
+static inline size_t texture_dxt_size(int width, int height, bool alpha) {
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * (alpha?16:8);
+}
+
+/*******************************************************************************
+ * Encodes one RGBA8 mipmap level
+ * @return number of bytes written to out
+ ******************************************************************************/
+static size_t texture_encode_level(const uint8_t *pixels, int width, int height, bool alpha, uint8_t *out) {
+	uint8_t *start = out;
+	uint8_t block[16][4];
+	for( int by = 0; by < height; by += 4 ) {
+		for( int bx = 0; bx < width; bx += 4 ) {
+			for( int i = 0; i < 16; i++ ) {
+				// blocks at the border repeat the last row or column
+				int x = ( bx + i % 4 < width )?bx + i % 4:width - 1;
+				int y = ( by + i / 4 < height )?by + i / 4:height - 1;
+				memcpy(block[i], pixels + ((size_t)y * width + x) * 4, 4);
+			}
+			if( alpha ) {
+				texture_encode_alpha(block, out);
+				out += 8;
+			}
+			texture_encode_color(block, out);
+			out += 8;
+		}
+	}
+	return out - start;
+}
+
+/*******************************************************************************
+ * Converts an image into a DXT1 (opaque) or DXT5 DDS file with mipmaps next to
+ * it, e.g. image.png to image.dds. ETC2 KTX files for GLES GPUs have to be
+ * created with external tools like etcpak, they are loaded just the same.
+ * @param *file the image to convert
+ * @return true on success
+ ******************************************************************************/
+bool texture_convert(const char *file) {
+	PROFILE_FUNC();
+	if( texture_is_compressed_file(file) ) {
+		LOG_DEBUG("»%s« is compressed already", file);
+		return true;
+	}
+	Image image = LoadImage(file);
+	if( image.data == NULL ) {
+		LOG_ERROR("Failed to load »%s« for conversion", file);
+		return false;
+	}
+	ImageFormat(&image, UNCOMPRESSED_R8G8B8A8);
+	ImageMipmaps(&image);
+
+	const uint8_t *pixels = image.data;
+	bool alpha = false;
+	for( size_t i = 0; i < (size_t)image.width * image.height && !alpha; i++ ) {
+		alpha = pixels[i*4+3] != 0xff;
+	}
+
+	// raylib reads at most twice the size of the first level, drop tiny levels beyond
+	size_t top_size = texture_dxt_size(image.width, image.height, alpha);
+	size_t total_size = 0;
+	int levels = 0;
+	for( int w = image.width, h = image.height; levels < image.mipmaps; levels++ ) {
+		size_t level_size = texture_dxt_size(w, h, alpha);
+		if( levels > 0 && total_size + level_size > top_size * 2 ) {
+			break;
+		}
+		total_size += level_size;
+		w = ( w > 1 )?w/2:1;
+		h = ( h > 1 )?h/2:1;
+	}
+
+	uint8_t *data;
+	MALLOC(data, total_size);
+	uint8_t *out = data;
+	for( int level = 0, w = image.width, h = image.height; level < levels; level++ ) {
+		out += texture_encode_level(pixels, w, h, alpha, out);
+		pixels += (size_t)w * h * 4;
+		w = ( w > 1 )?w/2:1;
+		h = ( h > 1 )?h/2:1;
+	}
+
+	texture_dds_header header = { 0 };
+	header.size = sizeof(texture_dds_header);
+	header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;  // caps, height, width, pixel format, mipmap count, linear size
+	header.width = image.width;
+	header.height = image.height;
+	header.linear_size = top_size;
+	header.mipmap_count = levels;
+	header.pixel_format.size = sizeof(texture_dds_pixel_format);
+	header.pixel_format.flags = 0x4;  // fourcc
+	header.pixel_format.fourcc = alpha?TEXTURE_FOURCC_DXT5:TEXTURE_FOURCC_DXT1;
+	header.caps = 0x1000 | (( levels > 1 )?0x400008:0);  // texture, mipmap and complex
+
+	char *path = texture_sibling(file, ".dds");
+	bool ok = false;
+	FILE *dds = fopen(path, "wb");
+	if( dds == NULL ) {
+		LOG_ERROR("Failed to open »%s« for writing: %s", path, strerror(errno));
+	}
+	else {
+		uint32_t magic = TEXTURE_DDS_MAGIC;
+		ok = fwrite(&magic, sizeof(magic), 1, dds) == 1 &&
+			fwrite(&header, sizeof(header), 1, dds) == 1 &&
+			fwrite(data, total_size, 1, dds) == 1;
+		ok &= fclose(dds) == 0;
+		if( ok ) {
+			LOG_INFO("Converted »%s« to »%s« (%s, %d levels, %lu bytes instead of %lu)", file, path,
+					alpha?"DXT5":"DXT1", levels, total_size, (size_t)image.width * image.height * 4);
+		}
+		else {
+			LOG_ERROR("Failed to write »%s«: %s", path, strerror(errno));
+		}
+	}
+	free(path);
+	free(data);
+	UnloadImage(image);
+	return ok;
+}
+
+/*******************************************************************************
+ * Converts the images of all image elements of the loaded layout
+ ******************************************************************************/
+void texture_convert_layout() {
+	uint_fast32_t count, converted = 0, failed = 0;
+	screen_element *elements = screen_get_elements(&count);
+	for( uint_fast32_t i = 0; i < count; i++ ) {
+		if( elements[i].type != SCREEN_IMG ) {
+			continue;
+		}
+		const char *file = ((screen_attrs_img *)elements[i].attrs)->file_name;
+		if( file == NULL ) {
+			continue;
+		}
+		if( texture_convert(file) ) {
+			converted++;
+		}
+		else {
+			failed++;
+		}
+	}
+	LOG_INFO("Converted %lu images, %lu failed", converted, failed);
+}
@@ -0,0 +1,53 @@
+#ifndef __TEXTURE_H__
+#define __TEXTURE_H__
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <raylib.h>
+
+#include "log.h"
+#include "helpers.h"
+#include "config.h"
+#include "profile.h"
+#include "screen.h"
+
+
+#define TEXTURE_DDS_MAGIC 0x20534444  // "DDS "
+#define TEXTURE_FOURCC_DXT1 0x31545844
+#define TEXTURE_FOURCC_DXT5 0x35545844
+
+typedef struct texture_dds_pixel_format {
+	uint32_t size;
+	uint32_t flags;
+	uint32_t fourcc;
+	uint32_t rgb_bit_count;
+	uint32_t r_mask, g_mask, b_mask, a_mask;
+} texture_dds_pixel_format;
+
+typedef struct texture_dds_header {
+	uint32_t size;
+	uint32_t flags;
+	uint32_t height;
+	uint32_t width;
+	uint32_t linear_size;
+	uint32_t depth;
+	uint32_t mipmap_count;
+	uint32_t reserved1[11];
+	texture_dds_pixel_format pixel_format;
+	uint32_t caps, caps2, caps3, caps4;
+	uint32_t reserved2;
+} texture_dds_header;
+
+
+bool texture_is_compressed(Image image);
+Image texture_load(const char *file, char **fallback_file);
+bool texture_convert(const char *file);
+void texture_convert_layout();
+
+
+#endif
@@ -0,0 +1,329 @@
+#include "vram.h"
+
+static const char *TOPIC = "vram";
+
+
+static vram_entry **vram_entries;  // entries are allocated one by one to keep them at a fixed address
+static pthread_mutex_t vram_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint_fast32_t vram_entries_count;
+static uint_fast32_t vram_frame;
+static vram_stats stats;
+static bool vram_over_budget_logged;
+
+
+static inline void vram_update_budget() {
+	stats.bytes_budget = (size_t)config.vram_budget * 1024 * 1024;
+}
+
+/*******************************************************************************
+ * Returns a free entry slot, growing the entry list if required
+ * @return handle of the free entry
+ ******************************************************************************/
+static uint_fast32_t vram_new_entry() {
+	for( uint_fast32_t i = 0; i < vram_entries_count; i++ ) {
+		if( vram_entries[i]->type == VRAM_FREE ) {
+			return i;
+		}
+	}
+	vram_entries_count++;
+	REALLOC(new_vram_entries, vram_entries, sizeof(vram_entry *) * vram_entries_count);
+	MALLOC(vram_entries[vram_entries_count-1], sizeof(vram_entry));
+	memset(vram_entries[vram_entries_count-1], 0, sizeof(vram_entry));
+	return vram_entries_count-1;
+}
+
+static void vram_unload(vram_entry *entry) {
+	if( !entry->resident ) {
+		return;
+	}
+	UnloadTexture(entry->texture);
+	entry->resident = false;
+	stats.bytes_resident -= entry->bytes;
+	stats.entries_resident--;
+}
+
+/*******************************************************************************
+ * Evicts the least recently used entries until the requested amount of bytes
+ * fits into the budget. Entries drawn in the current frame are never evicted,
+ * they may still be referenced by the pending render batch.
+ * @param bytes the number of bytes which should be uploaded next
+ ******************************************************************************/
+static void vram_make_room(size_t bytes) {
+	while( stats.bytes_resident + bytes > stats.bytes_budget ) {
+		vram_entry *lru = NULL;
+		pthread_mutex_lock(&vram_mutex);
+		for( uint_fast32_t i = 0; i < vram_entries_count; i++ ) {
+			if( vram_entries[i]->resident && vram_entries[i]->last_used < vram_frame &&
+					( lru == NULL || vram_entries[i]->last_used < lru->last_used ) ) {
+				lru = vram_entries[i];
+			}
+		}
+		pthread_mutex_unlock(&vram_mutex);
+		if( lru == NULL ) {
+			if( !vram_over_budget_logged ) {
+				LOG_WARNING("Assets of a single frame exceed the vRAM budget of %lu bytes", stats.bytes_budget);
+				vram_over_budget_logged = true;
+			}
+			return;
+		}
+		LOG_DEBUG("Evict texture with %lu bytes, last used in frame %lu", lru->bytes, lru->last_used);
+		vram_unload(lru);
+		stats.evictions++;
+	}
+}
+
+/*******************************************************************************
+ * Returns the bytes of an image including all of its mipmap levels
+ ******************************************************************************/
+static size_t vram_image_bytes(Image image) {
+	size_t bytes = 0;
+	int width = image.width, height = image.height;
+	for( int level = 0; level < image.mipmaps || level == 0; level++ ) {
+		bytes += GetPixelDataSize(width, height, image.format);
+		width = ( width > 1 )?width/2:1;
+		height = ( height > 1 )?height/2:1;
+	}
+	return bytes;
+}
+
+/*******************************************************************************
+ * Replaces a compressed image the GPU can't sample by its uncompressed fallback
+ * @return true if the fallback could be loaded
+ ******************************************************************************/
+static bool vram_load_fallback(vram_entry *entry) {
+	if( entry->fallback_file == NULL ) {
+		return false;
+	}
+	Image image = LoadImage(entry->fallback_file);
+	if( image.data == NULL ) {
+		LOG_ERROR("Failed to load fallback image »%s«", entry->fallback_file);
+		return false;
+	}
+	LOG_WARNING("Compressed texture format %d not supported, using »%s«", entry->image.format, entry->fallback_file);
+	UnloadImage(entry->image);
+	entry->image = image;
+	free(entry->fallback_file);
+	entry->fallback_file = NULL;
+	return true;
+}
+
+/*******************************************************************************
+ * Uploads a texture, falls back to the uncompressed image if the compressed
+ * format isn't supported and generates mipmaps if requested
+ ******************************************************************************/
+static void vram_upload_texture(vram_entry *entry) {
+	entry->texture = LoadTextureFromImage(entry->image);
+	if( entry->texture.id == 0 && texture_is_compressed(entry->image) && vram_load_fallback(entry) ) {
+		entry->texture = LoadTextureFromImage(entry->image);
+	}
+	entry->bytes = vram_image_bytes(entry->image);
+	if( entry->mipmaps && entry->texture.mipmaps == 1 && !texture_is_compressed(entry->image) ) {
+		GenTextureMipmaps(&entry->texture);
+		if( entry->texture.mipmaps > 1 ) {
+			// the generated chain adds a third to the base level
+			entry->bytes += entry->bytes / 3;
+		}
+	}
+	if( entry->texture.mipmaps > 1 ) {
+		SetTextureFilter(entry->texture, FILTER_TRILINEAR);
+	}
+}
+
+static void vram_upload(vram_entry *entry) {
+	PROFILE_FUNC();
+	if( entry->mipmaps && entry->image.mipmaps == 1 && !texture_is_compressed(entry->image) ) {
+		// make room for the mipmaps generated on upload
+		entry->bytes = vram_image_bytes(entry->image) * 4 / 3;
+	}
+	vram_make_room(entry->bytes);
+	vram_upload_texture(entry);
+	entry->changed = false;
+	entry->resident = true;
+	stats.bytes_resident += entry->bytes;
+	stats.entries_resident++;
+	if( stats.bytes_resident > stats.bytes_peak ) {
+		stats.bytes_peak = stats.bytes_resident;
+	}
+}
+
+/*******************************************************************************
+ * Marks the entry as used in the current frame and uploads it if necessary
+ ******************************************************************************/
+static vram_entry *vram_use(uint_fast32_t handle) {
+	pthread_mutex_lock(&vram_mutex);
+	if( handle >= vram_entries_count || vram_entries[handle]->type == VRAM_FREE ) {
+		LOG_FATAL("Requested unknown vRAM handle %lu", handle);
+	}
+	vram_entry *entry = vram_entries[handle];
+	pthread_mutex_unlock(&vram_mutex);
+	if( entry->resident && entry->changed ) {
+		UpdateTexture(entry->texture, entry->image.data);
+		entry->changed = false;
+	}
+	if( entry->resident ) {
+		stats.hits++;
+	}
+	else {
+		stats.misses++;
+		vram_upload(entry);
+	}
+	entry->last_used = vram_frame;
+	return entry;
+}
+
+/*******************************************************************************
+ * Registers an image, which is uploaded on first use
+ * @param image the CPU side image, the vRAM manager takes ownership
+ * @param *fallback_file uncompressed image to load if the GPU can't sample the
+ * compressed format of image, or NULL. The vRAM manager takes ownership.
+ * @return the handle of the texture
+ ******************************************************************************/
+uint_fast32_t vram_add_image(Image image, const char *fallback_file) {
+	pthread_mutex_lock(&vram_mutex);
+	uint_fast32_t handle = vram_new_entry();
+	vram_entries[handle]->type = VRAM_TEXTURE;
+	vram_entries[handle]->image = image;
+	vram_entries[handle]->fallback_file = (char *)fallback_file;
+	vram_entries[handle]->bytes = vram_image_bytes(image);
+	vram_entries[handle]->ref_count = 1;
+	stats.entries++;
+	LOG_VERBOSE("Registered texture %lu with %lu bytes", handle, vram_entries[handle]->bytes);
+	pthread_mutex_unlock(&vram_mutex);
+	return handle;
+}
+
+/*******************************************************************************
+ * Drops a reference to an entry and frees it if it isn't used anymore
+ ******************************************************************************/
+void vram_remove(uint_fast32_t handle) {
+	pthread_mutex_lock(&vram_mutex);
+	vram_entry *entry = vram_entries[handle];
+	if( --entry->ref_count > 0 ) {
+		pthread_mutex_unlock(&vram_mutex);
+		return;
+	}
+	vram_unload(entry);
+	UnloadImage(entry->image);
+	free(entry->fallback_file);
+	memset(entry, 0, sizeof(vram_entry));
+	stats.entries--;
+	pthread_mutex_unlock(&vram_mutex);
+}
+
+/*******************************************************************************
+ * Requests mipmaps for a texture which is drawn minified, they are generated on
+ * the next upload. Compressed images only use the levels stored in their file.
+ ******************************************************************************/
+void vram_request_mipmaps(uint_fast32_t handle) {
+	pthread_mutex_lock(&vram_mutex);
+	vram_entry *entry = vram_entries[handle];
+	if( entry->mipmaps ) {
+		pthread_mutex_unlock(&vram_mutex);
+		return;
+	}
+	entry->mipmaps = true;
+	if( !entry->resident || entry->texture.mipmaps != 1 || texture_is_compressed(entry->image) ) {
+		pthread_mutex_unlock(&vram_mutex);
+		return;
+	}
+	// the texture is only used by the screen thread, only generating runs unlocked
+	Texture2D texture = entry->texture;
+	pthread_mutex_unlock(&vram_mutex);
+	GenTextureMipmaps(&texture);
+	pthread_mutex_lock(&vram_mutex);
+	entry = vram_entries[handle];
+	entry->texture.mipmaps = texture.mipmaps;
+	if( texture.mipmaps > 1 ) {
+		size_t bytes = entry->bytes;
+		entry->bytes += bytes / 3;
+		stats.bytes_resident += entry->bytes - bytes;
+		SetTextureFilter(entry->texture, FILTER_TRILINEAR);
+		LOG_VERBOSE("Generated %d mipmaps for texture %lu", texture.mipmaps, handle);
+	}
+	pthread_mutex_unlock(&vram_mutex);
+}
+
+/*******************************************************************************
+ * Returns the CPU copy of a texture, it can be modified in place as long as
+ * the size and format stay the same. Call vram_update() afterwards.
+ ******************************************************************************/
+Image *vram_get_image(uint_fast32_t handle) {
+	pthread_mutex_lock(&vram_mutex);
+	vram_entry *entry = vram_entries[handle];
+	pthread_mutex_unlock(&vram_mutex);
+	return &entry->image;
+}
+
+/*******************************************************************************
+ * Marks the CPU copy of a texture as modified, a resident texture is updated
+ * on its next use
+ ******************************************************************************/
+void vram_update(uint_fast32_t handle) {
+	pthread_mutex_lock(&vram_mutex);
+	vram_entries[handle]->changed = true;
+	pthread_mutex_unlock(&vram_mutex);
+}
+
+Texture2D *vram_get_texture(uint_fast32_t handle) {
+	return &vram_use(handle)->texture;
+}
+
+
+/*******************************************************************************
+ * Starts a new frame, has to be called before anything is drawn
+ ******************************************************************************/
+void vram_next_frame() {
+	vram_frame++;
+	vram_update_budget();
+	if( config.fps > 0 && vram_frame % ((uint_fast32_t)config.fps * VRAM_STATS_INTERVAL) == 0 ) {
+		vram_log_stats();
+	}
+}
+
+/*******************************************************************************
+ * Returns the number of the current frame, used to keep what's drawn in it
+ ******************************************************************************/
+uint_fast32_t vram_get_frame() {
+	return vram_frame;
+}
+
+/*******************************************************************************
+ * Uploads all registered entries as long as they fit into the budget, used to
+ * have everything resident before the first frame is drawn
+ ******************************************************************************/
+void vram_upload_all() {
+	vram_update_budget();
+	for( uint_fast32_t i = 0; i < vram_entries_count; i++ ) {
+		pthread_mutex_lock(&vram_mutex);
+		vram_entry *entry = vram_entries[i];
+		pthread_mutex_unlock(&vram_mutex);
+		if( entry->type == VRAM_FREE || entry->resident ) {
+			continue;
+		}
+		if( stats.bytes_resident + entry->bytes > stats.bytes_budget ) {
+			LOG_DEBUG("vRAM budget reached, %lu bytes of entry %lu are uploaded on demand", entry->bytes, i);
+			continue;
+		}
+		vram_upload(entry);
+	}
+}
+
+/*******************************************************************************
+ * Releases all GPU memory, the entries stay registered and are uploaded again
+ * on next use. Must be called before the GL context is closed.
+ ******************************************************************************/
+void vram_unload_all() {
+	for( uint_fast32_t i = 0; i < vram_entries_count; i++ ) {
+		vram_unload(vram_entries[i]);
+	}
+}
+
+vram_stats vram_get_stats() {
+	return stats;
+}
+
+void vram_log_stats() {
+	LOG_INFO("vRAM: %lu/%lu bytes (peak %lu), %lu/%lu entries resident, %lu hits, %lu misses, %lu evictions",
+			stats.bytes_resident, stats.bytes_budget, stats.bytes_peak, stats.entries_resident, stats.entries,
+			stats.hits, stats.misses, stats.evictions);
+}
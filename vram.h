@@ -0,0 +1,67 @@
+#ifndef __VRAM_H__
+#define __VRAM_H__
+
+
+#ifndef VRAM_STATS_INTERVAL
+#define VRAM_STATS_INTERVAL 300
+#endif
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <raylib.h>
+
+#include "log.h"
+#include "helpers.h"
+#include "config.h"
+#include "profile.h"
+#include "texture.h"
+
+
+typedef enum {
+	VRAM_FREE,
+	VRAM_TEXTURE,
+} vram_type;
+
+typedef struct vram_entry {
+	vram_type type;
+	bool resident;
+	size_t bytes;
+	uint_fast32_t last_used;  // frame number of the last draw
+	uint_fast16_t ref_count;
+	Image image;              // CPU copy of the texture, used to re-upload
+	char *fallback_file;      // uncompressed image used if the GPU can't sample a compressed one
+	bool mipmaps;             // generate mipmaps on upload, the image is drawn minified
+	bool changed;             // image was modified, texture has to be updated on next use
+	Texture2D texture;
+} vram_entry;
+
+typedef struct vram_stats {
+	uint_fast64_t hits;
+	uint_fast64_t misses;
+	uint_fast64_t evictions;
+	size_t bytes_resident;
+	size_t bytes_peak;
+	size_t bytes_budget;
+	uint_fast32_t entries;
+	uint_fast32_t entries_resident;
+} vram_stats;
+
+
+uint_fast32_t vram_add_image(Image image, const char *fallback_file);
+void vram_request_mipmaps(uint_fast32_t handle);
+Image *vram_get_image(uint_fast32_t handle);
+void vram_update(uint_fast32_t handle);
+void vram_remove(uint_fast32_t handle);
+void vram_upload_all();
+Texture2D *vram_get_texture(uint_fast32_t handle);
+void vram_next_frame();
+uint_fast32_t vram_get_frame();
+void vram_unload_all();
+vram_stats vram_get_stats();
+void vram_log_stats();
+
+
+#endif